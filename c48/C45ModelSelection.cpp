@@ -1,116 +1,292 @@
 #include "C45ModelSelection.h"
 #include "C45Split.h"
 #include "core/Instances.h"
+#include "core/InstancesView.h"
 #include "ClassifierSplitModel.h"
 #include "NoSplit.h"
 #include "Distribution.h"
+#include "SortedInstances.h"
 #include "core/Attribute.h"
 #include "core/Utils.h"
+#include "core/ThreadPool.h"
+#include "core/Instance.h"
+#include "core/ColumnStore.h"
 #include <iostream>
+#include <algorithm>
 
 
-C45ModelSelection::C45ModelSelection(int minNoObj, Instances &allData, bool useMDLcorrection, bool doNotMakeSplitPointActualValue) :
+C45ModelSelection::C45ModelSelection(int minNoObj, Instances &allData, bool useMDLcorrection, bool doNotMakeSplitPointActualValue, ThreadPool *threadPool) :
   mMinNoObj(minNoObj),
     mUseMDLcorrection(useMDLcorrection),
-    mDoNotMakeSplitPointActualValue(doNotMakeSplitPointActualValue)
+    mDoNotMakeSplitPointActualValue(doNotMakeSplitPointActualValue),
+    mThreadPool(threadPool)
 {
     mAllData = &allData;
+    mNumInstances = allData.numInstances();
 }
 
-void C45ModelSelection::cleanup() const
+C45ModelSelection::~C45ModelSelection()
 {
-    delete mAllData;
+    cleanup();
 }
 
-ClassifierSplitModel *C45ModelSelection::selectModel(Instances &data ) const
+void C45ModelSelection::cleanup()
+{
+    mAllData = nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mValuesMutex);
+        mSortedValues.clear();
+        mIsValuesSorted.clear();
+    }
+    std::lock_guard<std::mutex> lock(mColumnsMutex);
+    for (C45Split::NumericColumns *columns : mColumns)
+    {
+        delete columns;
+    }
+    mColumns.clear();
+}
+
+const double_array &C45ModelSelection::sortedValues(const int attIndex) const
+{
+    std::lock_guard<std::mutex> lock(mValuesMutex);
+    if (mSortedValues.empty())
+    {
+        mSortedValues.resize(mAllData->numAttributes());
+        mIsValuesSorted.assign(mAllData->numAttributes(), false);
+    }
+    double_array &values = mSortedValues[attIndex];
+    if (!mIsValuesSorted[attIndex])
+    {
+        // Read the values straight from the column of the store holding
+        // them; instances that are not held in a column of doubles fall
+        // back to value().
+        const ColumnStore *lastStore = nullptr;
+        const double *column = nullptr;
+        int totalInst = mAllData->numInstances();
+        values.reserve(totalInst);
+        for (int i = 0; i < totalInst; i++)
+        {
+            Instance &instance = mAllData->instance(i);
+            const ColumnStore *store = instance.store();
+            if (store != lastStore && store != nullptr)
+            {
+                column = store->column(attIndex);
+                lastStore = store;
+            }
+            double value = (store != nullptr && column != nullptr) ? column[instance.row()] : instance.value(attIndex);
+            if (!Utils::isMissingValue(value))
+            {
+                values.push_back(value);
+            }
+        }
+        std::sort(values.begin(), values.end());
+        values.erase(std::unique(values.begin(), values.end()), values.end());
+        values.shrink_to_fit();
+        mIsValuesSorted[attIndex] = true;
+    }
+    return values;
+}
+
+C45Split::NumericColumns *C45ModelSelection::takeColumns() const
+{
+    std::lock_guard<std::mutex> lock(mColumnsMutex);
+    if (mColumns.empty())
+    {
+        return new C45Split::NumericColumns();
+    }
+    C45Split::NumericColumns *columns = mColumns.back();
+    mColumns.pop_back();
+    return columns;
+}
+
+void C45ModelSelection::giveBackColumns(C45Split::NumericColumns *columns) const
+{
+    std::lock_guard<std::mutex> lock(mColumnsMutex);
+    mColumns.push_back(columns);
+}
+
+ClassifierSplitModel *C45ModelSelection::selectModel(Instances &data) const
+{
+    return selectModel(InstancesView(data), nullptr);
+}
+
+ClassifierSplitModel *C45ModelSelection::selectModel(const InstancesView &data, const SortedInstances *sorted) const
 {
-    double minResult;
-    std::vector<C45Split*> currentModel;
     C45Split *bestModel = nullptr;
     NoSplit *noSplitModel = nullptr;
-    double averageInfoGain = 0;
-    int validModels = 0;
-    bool multiVal = true;
     Distribution *checkDistribution;
-    Attribute *attribute;
-    double sumOfWeights;
-    int i;
 
     try
     {
 
         // Check if all Instances belong to one class or if not
         // enough Instances to split.
-        checkDistribution = new Distribution(data);
+        if (sorted != nullptr && sorted->distribution() != nullptr)
+        {
+            checkDistribution = new Distribution(*sorted->distribution());
+        }
+        else
+        {
+            checkDistribution = new Distribution(data);
+        }
         noSplitModel = new NoSplit(checkDistribution);
-        if (Utils::sm(checkDistribution->total(), 2 *mMinNoObj) || Utils::eq(checkDistribution->total(), checkDistribution->perClass(checkDistribution->maxClass())))
+        bool leaf = isLeaf(*checkDistribution);
+        delete checkDistribution;
+        if (leaf)
+        {
+            return noSplitModel;
+        }
+
+        bestModel = bestSplit(data, sorted, data.sumOfWeights(), mThreadPool != nullptr && data.numInstances() >= MIN_INSTANCES_FOR_THREADS);
+        if (bestModel == nullptr)
         {
             return noSplitModel;
         }
+        delete noSplitModel;
 
-        // Check if all attributes are nominal and have a
-        // lot of values.
-        if (mAllData != nullptr)
+        // Add all Instances with unknown values for the corresponding
+        // attribute to the distribution for the model, so that
+        // the complete distribution is stored with the model.
+        bestModel->getDistribution()->addInstWithUnknown(data, bestModel->attIndex());
+
+        // Set the split point analogue to C45 if attribute numeric.
+        if ((mAllData != nullptr) && (!mDoNotMakeSplitPointActualValue) && data.attribute(bestModel->attIndex()).isNumeric())
         {
-            int totalattribute = data.numAttributes();
-            for (int i = 0; i < totalattribute; i++)
+            bestModel->setSplitPoint(sortedValues(bestModel->attIndex()));
+        }
+        return bestModel;
+    }
+    catch (std::exception &e)
+    {
+        std::cout << e.what();
+    }
+    return nullptr;
+}
+
+ClassifierSplitModel *C45ModelSelection::selectModelFromCounts(const InstancesView &header, const SortedInstances &counts) const
+{
+    Distribution checkDistribution(*counts.distribution());
+    NoSplit *noSplitModel = new NoSplit(&checkDistribution);
+    if (isLeaf(checkDistribution))
+    {
+        return noSplitModel;
+    }
+    C45Split *bestModel = bestSplit(header, &counts, checkDistribution.total(), false);
+    if (bestModel == nullptr)
+    {
+        return noSplitModel;
+    }
+    delete noSplitModel;
+    return bestModel;
+}
+
+bool C45ModelSelection::isLeaf(const Distribution &distribution) const
+{
+    return Utils::sm(distribution.total(), 2 *mMinNoObj) || Utils::eq(distribution.total(), distribution.perClass(distribution.maxClass()));
+}
+
+C45Split *C45ModelSelection::bestSplit(const InstancesView &data, const SortedInstances *sorted, double sumOfWeights, bool concurrently) const
+{
+    double minResult;
+    std::vector<C45Split*> currentModel;
+    C45Split *bestModel = nullptr;
+    double averageInfoGain = 0;
+    int validModels = 0;
+    bool multiVal = true;
+    Attribute *attribute;
+    int i;
+
+    // Check if all attributes are nominal and have a
+    // lot of values.
+    if (mAllData != nullptr)
+    {
+        int totalattribute = data.numAttributes();
+        for (int i = 0; i < totalattribute; i++)
+        {
+            attribute = &data.attribute(i);
+            if ((attribute->isNumeric()) || (Utils::sm(attribute->numValues(), (0.3 * mNumInstances))))
             {
-                attribute = &data.attribute(i);
-                if ((attribute->isNumeric()) || (Utils::sm(attribute->numValues(), (0.3 * mAllData->numInstances()))))
-                {
-                    multiVal = false;
-                    break;
-                }
+                multiVal = false;
+                break;
             }
         }
+    }
 
-        currentModel = std::vector<C45Split*>(data.numAttributes());
-        sumOfWeights = data.sumOfWeights();
+    currentModel = std::vector<C45Split*>(data.numAttributes());
 
-        // For each attribute.
+    // Get models for all attributes apart from the class attribute.
+    // The models only read the data, so they are built concurrently if
+    // a pool is available; everything that combines them below runs in
+    // attribute order, so the result does not depend on the threads.
+    for (i = 0; i < data.numAttributes(); i++)
+    {
+        if (i != data.classIndex())
+        {
+            currentModel[i] = new C45Split(i, mMinNoObj, sumOfWeights, mUseMDLcorrection);
+        }
+    }
+    std::function<void(int)> buildModel = [&](int att)
+    {
+        if (currentModel[att] != nullptr)
+        {
+            C45Split::NumericColumns *columns = takeColumns();
+            try
+            {
+                currentModel[att]->buildClassifier(data, sorted, columns);
+            }
+            catch (...)
+            {
+                giveBackColumns(columns);
+                throw;
+            }
+            giveBackColumns(columns);
+        }
+    };
+    if (concurrently)
+    {
+        mThreadPool->parallelFor(data.numAttributes(), buildModel);
+    }
+    else
+    {
         for (i = 0; i < data.numAttributes(); i++)
         {
+            buildModel(i);
+        }
+    }
+
+    // For each attribute.
+    for (i = 0; i < data.numAttributes(); i++)
+    {
 
-            // Apart from class attribute.
-            if (i != data.classIndex())
+        // Apart from class attribute.
+        if (i != data.classIndex())
+        {
+            // Check if useful split for current attribute
+            // exists and check for enumerated attributes with
+            // a lot of values.
+            if (currentModel[i]->checkModel())
             {
-                // Get models for current attribute.
-                currentModel[i] = new C45Split(i,mMinNoObj, sumOfWeights, mUseMDLcorrection);
-                // Check for Dataset assignment
-                currentModel[i]->buildClassifier(data);
-
-                // Check if useful split for current attribute
-                // exists and check for enumerated attributes with
-                // a lot of values.
-                if (currentModel[i]->checkModel())
+                if (mAllData != nullptr)
                 {
-                    if (mAllData != nullptr)
-                    {
-                        if ((data.attribute(i).isNumeric()) || (multiVal ||
-                            Utils::sm(data.attribute(i).numValues(), (0.3 * mAllData->numInstances()))))
-                        {
-                            averageInfoGain = averageInfoGain + currentModel[i]->infoGain();
-                            validModels++;
-                        }
-                    }
-                    else
+                    if ((data.attribute(i).isNumeric()) || (multiVal ||
+                        Utils::sm(data.attribute(i).numValues(), (0.3 * mNumInstances))))
                     {
                         averageInfoGain = averageInfoGain + currentModel[i]->infoGain();
                         validModels++;
                     }
                 }
-            }
-            else
-            {
-                currentModel[i]= nullptr;
+                else
+                {
+                    averageInfoGain = averageInfoGain + currentModel[i]->infoGain();
+                    validModels++;
+                }
             }
         }
+    }
 
-        // Check if any useful split was found.
-        if (validModels == 0)
-        {
-            return noSplitModel;
-        }
+    // Check if any useful split was found.
+    if (validModels > 0)
+    {
         averageInfoGain = averageInfoGain / validModels;
 
         // Find "best" attribute to split on.
@@ -132,34 +308,37 @@ ClassifierSplitModel *C45ModelSelection::selectModel(Instances &data ) const
         // Check if useful split was found.
         if (Utils::eq(minResult, 0))
         {
-            return noSplitModel;
+            bestModel = nullptr;
         }
+    }
 
-        // Add all Instances with unknown values for the corresponding
-        // attribute to the distribution for the model, so that
-        // the complete distribution is stored with the model.
-        bestModel->getDistribution()->addInstWithUnknown(data, bestModel->attIndex());
-
-        // Set the split point analogue to C45 if attribute numeric.
-        if ((mAllData != nullptr) && (!mDoNotMakeSplitPointActualValue))
+    // Only the chosen model is returned; the others are deleted.
+    for (i = 0; i < data.numAttributes(); i++)
+    {
+        if (currentModel[i] != bestModel)
         {
-            bestModel->setSplitPoint(*mAllData);
+            delete currentModel[i];
         }
-        return bestModel;
-    }
-    catch (std::exception &e)
-    {
-        std::cout << e.what();
     }
-    return nullptr;
+    return bestModel;
 }
 
-ClassifierSplitModel *C45ModelSelection::selectModel(Instances &train, Instances &test) const
+ClassifierSplitModel *C45ModelSelection::selectModel(Instances &train, Instances & /* test */) const
 {
     return selectModel(train);
 }
 
-void C45ModelSelection::serialize(std::ostream &os)
+ThreadPool *C45ModelSelection::threadPool() const
+{
+    return mThreadPool;
+}
+
+bool C45ModelSelection::relocatesSplitPoints() const
 {
-	os << mUseMDLcorrection << '\0' << mDoNotMakeSplitPointActualValue << '\0' << mMinNoObj << '\0';
-}
\ No newline at end of file
+    return !mDoNotMakeSplitPointActualValue;
+}
+
+void C45ModelSelection::setNumInstances(int numInstances)
+{
+    mNumInstances = numInstances;
+}
@@ -2,8 +2,10 @@
 #define _C45MODELSELECTION_
 
 #include "ModelSelection.h"
+#include "C45Split.h"
 #include <string>
 #include <vector>
+#include <mutex>
 #include <stdexcept>
 
 // Forward class declarations:
@@ -13,6 +15,9 @@ class ClassifierSplitModel;
 class NoSplit;
 class Distribution;
 class Attribute;
+class SortedInstances;
+class InstancesView;
+class ThreadPool;
 
 /**
  * Class for selecting a C4.5-type split for a given dataset.
@@ -29,9 +34,82 @@ protected:
     /** All the training data */
     Instances *mAllData;
 
+    /** The number of rows of all the training data. */
+    int mNumInstances;
+
     /** Do not relocate split point to actual data value */
     const bool mDoNotMakeSplitPointActualValue;
 
+    /** The pool the attributes are evaluated on, null to evaluate them in turn */
+    ThreadPool *mThreadPool;
+
+    /**
+     * Minimum number of instances at a node for its attributes to be
+     * evaluated concurrently. Smaller nodes are left to subtree parallelism.
+     */
+    static const int MIN_INSTANCES_FOR_THREADS = 1000;
+
+    /** Guards mColumns. */
+    mutable std::mutex mColumnsMutex;
+
+    /**
+     * Scratch columns for splits on numeric attributes that no split is
+     * using at the moment. There are at most as many as splits have been
+     * built at once, and they are kept until cleanup().
+     */
+    mutable std::vector<C45Split::NumericColumns*> mColumns;
+
+    /** Guards mSortedValues. */
+    mutable std::mutex mValuesMutex;
+
+    /**
+     * The distinct known values of each numeric attribute in the full
+     * training data in ascending order, for relocating split points. An
+     * attribute's values are sorted when a split on it is first selected,
+     * and kept until cleanup().
+     */
+    mutable std::vector<double_array> mSortedValues;
+
+    /** Whether the values of an attribute have been sorted. */
+    mutable bool_array mIsValuesSorted;
+
+    /**
+     * Returns the distinct known values of a numeric attribute in the full
+     * training data in ascending order, sorting them on first use.
+     *
+     * @param attIndex the attribute's index
+     * @return the sorted values
+     */
+    const double_array &sortedValues(const int attIndex) const;
+
+    /**
+     * Takes scratch columns for building a split, reusing free ones.
+     *
+     * @return the columns, to be handed back with giveBackColumns()
+     */
+    C45Split::NumericColumns *takeColumns() const;
+
+    /**
+     * Hands back columns taken with takeColumns() for reuse.
+     *
+     * @param columns the columns
+     */
+    void giveBackColumns(C45Split::NumericColumns *columns) const;
+
+    /**
+     * Builds a split on every attribute apart from the class attribute and
+     * returns the one with the best gain ratio among those with at least
+     * average information gain.
+     *
+     * @param data the rows of the node, or just the header if sorted holds
+     *          their counts
+     * @param sorted the orders or counts of the rows, may be null
+     * @param sumOfWeights the total weight of the rows
+     * @param concurrently whether to build the splits on the thread pool
+     * @return the best split, null if there is no useful one
+     */
+    C45Split *bestSplit(const InstancesView &data, const SortedInstances *sorted, double sumOfWeights, bool concurrently) const;
+
 public:
     /**
      * Initializes the split selection method with the given parameters.
@@ -44,25 +122,76 @@ public:
      *          on numeric attributes
      * @param doNotMakeSplitPointActualValue if true, split point is not relocated
      *          by scanning the entire dataset for the closest data value
+     * @param threadPool the pool to evaluate the attributes on, may be null.
+     *          Not owned by the model selection.
+     */
+    C45ModelSelection(int minNoObj, Instances &allData, bool useMDLcorrection, bool doNotMakeSplitPointActualValue, ThreadPool *threadPool);
+
+    /**
+     * Deletes the scratch columns.
      */
-    C45ModelSelection(int minNoObj, Instances &allData, bool useMDLcorrection, bool doNotMakeSplitPointActualValue);
+    virtual ~C45ModelSelection();
 
     /**
-     * Sets reference to training data to null.
+     * Sets reference to training data to null and releases the scratch
+     * space kept for building further splits.
      */
-    virtual void cleanup() const;
+    virtual void cleanup();
 
     /**
      * Selects C4.5-type split for the given dataset.
      */
     ClassifierSplitModel *selectModel(Instances &data) const;
 
+    /**
+     * Selects C4.5-type split for the rows of the given view, scanning the
+     * presorted orders of the numeric attributes instead of sorting them at
+     * this node.
+     */
+    virtual ClassifierSplitModel *selectModel(const InstancesView &data, const SortedInstances *sorted) const override;
+
     /**
      * Selects C4.5-type split for the given dataset.
      */
     virtual ClassifierSplitModel *selectModel(Instances &train, Instances &test) const override;
 
-	virtual void serialize(std::ostream &os);
+    /**
+     * Selects C4.5-type split for a node from the counts of its rows alone:
+     * their class distribution and their class weights per bin of each
+     * numeric attribute and per value of each nominal one. Rows with
+     * unknown values are not added to the distribution of the split, nor is
+     * the split point relocated; both are left to the caller, who holds
+     * the rows.
+     *
+     * @param header the header of the training data
+     * @param counts the counts of the rows of the node
+     * @return the split, or a leaf
+     */
+    ClassifierSplitModel *selectModelFromCounts(const InstancesView &header, const SortedInstances &counts) const;
+
+    /**
+     * Tests whether a node with the given class distribution becomes a leaf
+     * whatever its attributes, as it is too small or holds a single class.
+     */
+    bool isLeaf(const Distribution &distribution) const;
+
+    /**
+     * Returns whether split points are relocated to values of the data.
+     */
+    bool relocatesSplitPoints() const;
+
+    /**
+     * Sets the number of rows of all the training data, for training data
+     * that is not at hand as instances.
+     *
+     * @param numInstances the number of rows
+     */
+    void setNumInstances(int numInstances);
+
+    /**
+     * Returns the pool the attributes are evaluated on.
+     */
+    virtual ThreadPool *threadPool() const override;
 };
 
 #endif    //#ifndef _C45MODELSELECTION_
@@ -1,29 +1,81 @@
 #include "C45PruneableClassifierTree.h"
 #include "ModelSelection.h"
 #include "core/Instances.h"
+#include "core/InstancesView.h"
 #include "Distribution.h"
 #include "core/Utils.h"
 #include "NoSplit.h"
-#include "Stats.h"
-    
-C45PruneableClassifierTree::C45PruneableClassifierTree(ModelSelection *toSelectLocModel, bool pruneTree, float cf, bool raiseTree, bool cleanup, bool collapseTree) : ClassifierTree(toSelectLocModel)
+#include "ErrorEstimator.h"
+#include "SortedInstances.h"
+#include "LevelWiseBuilder.h"
+#include "core/Arena.h"
+#include "core/Instance.h"
+
+#include <algorithm>
+
+C45PruneableClassifierTree::C45PruneableClassifierTree(ModelSelection *toSelectLocModel, bool pruneTree, float cf, bool raiseTree, bool cleanup, bool collapseTree, bool presort, int numBins, bool countTables) : ClassifierTree(toSelectLocModel)
 {
     mPruneTheTree = pruneTree;
     mCF = cf;
     mSubtreeRaising = raiseTree;
     mCleanup = cleanup;
     mCollapseTheTree = collapseTree;
+    mPresort = presort;
+    mNumBins = numBins;
+    mCountTables = countTables;
 }
 
+C45PruneableClassifierTree::~C45PruneableClassifierTree()
+{
+    delete mRows;
+    deletePartition();
+    delete mRaisedChanges;
+    delete mRaisedDistribution;
+    delete mRaisedKnownDistribution;
+    delete mRaisedUnknownRows;
+    if (mIsRoot)
+    {
+        delete mErrorEstimator;
+    }
+}
 
 void C45PruneableClassifierTree::buildClassifier(Instances &data)
 {
 
-    // remove instances with missing class
-    Instances dataMissed(&data);
-    dataMissed.deleteWithMissingClass();
+    // leave out instances with missing class, without copying the others
+    if (data.classIndex() < 0)
+    {
+        throw "Class index is negative (not set)!";
+    }
+    InstancesView view(data, data.numInstances());
+    view.addKnown(data.classIndex());
+    buildClassifier(view, SortedInstances::forTree(view, mPresort, mNumBins, mCountTables));
+}
+
+void C45PruneableClassifierTree::buildClassifier(const InstancesView &data, SortedInstances *sorted)
+{
+
+    // drop what a previous build kept
+    if (mArena != nullptr)
+    {
+        mArena->release();
+    }
 
-    buildTree(dataMissed, mSubtreeRaising || !mCleanup);
+    // the z-score and the low-end estimates are shared by all nodes
+    if (mErrorEstimator == nullptr)
+    {
+        mErrorEstimator = new ErrorEstimator(mCF);
+    }
+
+    // subtree raising routes the rows of a node through its largest branch
+    delete mRows;
+    mRows = nullptr;
+    if (mPruneTheTree && mSubtreeRaising)
+    {
+        mRows = new InstancesView(data);
+    }
+
+    buildTree(data, sorted, !mCleanup);
     if (mCollapseTheTree)
     {
         collapse();
@@ -32,12 +84,46 @@ void C45PruneableClassifierTree::buildClassifier(Instances &data)
     {
         prune();
     }
+    deleteRows();
     if (mCleanup)
     {
-        ;// cleanup(new Instances(dataMissed, 0));
+        // the kept training data is no longer needed
+        dropTrainingData(data.dataset());
     }
 }
 
+void C45PruneableClassifierTree::buildClassifier(LevelWiseBuilder &builder, Instances &header)
+{
+
+    if (mPruneTheTree && mSubtreeRaising)
+    {
+        throw "Subtree raising needs the training data in memory!";
+    }
+
+    // drop what a previous build kept
+    if (mArena != nullptr)
+    {
+        mArena->release();
+    }
+
+    // the z-score and the low-end estimates are shared by all nodes
+    if (mErrorEstimator == nullptr)
+    {
+        mErrorEstimator = new ErrorEstimator(mCF);
+    }
+
+    builder.grow(*this);
+    if (mCollapseTheTree)
+    {
+        collapse();
+    }
+    if (mPruneTheTree)
+    {
+        prune();
+    }
+    dropTrainingData(header);
+}
+
 void C45PruneableClassifierTree::collapse()
 {
 
@@ -53,11 +139,11 @@ void C45PruneableClassifierTree::collapse()
         {
 
             // Free adjacent trees
-            //mSons = ;
+            deleteSons();
             mIsLeaf = true;
 
             // Get NoSplit Model for tree.
-            mLocalModel = new NoSplit(localModel()->getDistribution());
+            replaceByNoSplit();
         }
         else
         {
@@ -92,7 +178,35 @@ void C45PruneableClassifierTree::prune()
         indexOfLargestBranch = localModel()->getDistribution()->maxBag();
         if (mSubtreeRaising)
         {
-            errorsLargestBranch = son(indexOfLargestBranch)->getEstimatedErrorsForBranch(*mTrain);
+
+            // the largest branch keeps the rows it has; the rows of the
+            // other branches arrive, and the rows missing the split value
+            // get their full weight instead of their share
+            partitionRows();
+            Distribution *distribution = localModel()->getDistribution();
+            double share = distribution->perBag(indexOfLargestBranch) / distribution->total();
+            std::vector<RowChange> *changes = new std::vector<RowChange>();
+            for (i = 0; i < mUnknownRows->numInstances(); i++)
+            {
+                double weight = mUnknownRows->weight(i);
+                changes->push_back({ mUnknownRows->index(i), Utils::gr(share, 0) ? share * weight : -1, weight });
+            }
+            for (i = 0; i < (int)mSons.size(); i++)
+            {
+                if (i != indexOfLargestBranch)
+                {
+                    InstancesView &rows = *son(i)->mRows;
+                    for (int j = 0; j < rows.numInstances(); j++)
+                    {
+                        if (mUnknownRows->find(rows.index(j)) < 0)
+                        {
+                            changes->push_back({ rows.index(j), -1, rows.weight(j) });
+                        }
+                    }
+                }
+            }
+            std::sort(changes->begin(), changes->end(), [](const RowChange &a, const RowChange &b) { return a.index < b.index; });
+            errorsLargestBranch = son(indexOfLargestBranch)->getEstimatedErrorsForBranch(changes);
         }
         else
         {
@@ -110,11 +224,12 @@ void C45PruneableClassifierTree::prune()
         {
 
             // Free son Trees
-            mSons.clear();
+            deleteSons();
             mIsLeaf = true;
 
             // Get NoSplit Model for node.
-            mLocalModel = new NoSplit(localModel()->getDistribution());
+            replaceByNoSplit();
+            deletePartition();
             return;
         }
 
@@ -123,81 +238,329 @@ void C45PruneableClassifierTree::prune()
         if (Utils::smOrEq(errorsLargestBranch, errorsTree + 0.1))
         {
             largestBranch = son(indexOfLargestBranch);
+            bool changed = !largestBranch->mRaisedChanges->empty();
+            mSons[indexOfLargestBranch] = nullptr;
+            deleteSons();
+            delete mLocalModel;
             mSons = largestBranch->mSons;
             mLocalModel = largestBranch->localModel();
             mIsLeaf = largestBranch->mIsLeaf;
-            newDistribution(*mTrain);
+
+            // the distributions computed for the branch become those of
+            // this node, whose rows stay the same, and of the raised nodes
+            deletePartition();
+            mRaisedDistribution = largestBranch->mRaisedDistribution;
+            mRaisedKnownDistribution = largestBranch->mRaisedKnownDistribution;
+            mRaisedUnknownRows = largestBranch->mRaisedUnknownRows;
+
+            // the branch has been taken over, so only its node is deleted
+            largestBranch->mSons.clear();
+            largestBranch->mLocalModel = nullptr;
+            largestBranch->mRaisedDistribution = nullptr;
+            largestBranch->mRaisedKnownDistribution = nullptr;
+            largestBranch->mRaisedUnknownRows = nullptr;
+            delete largestBranch;
+            installRaised();
+            if (changed && !mIsLeaf)
+            {
+                for (i = 0; i < (int)mSons.size(); i++)
+                {
+                    son(i)->raise();
+                }
+            }
             prune();
         }
+        else if (mSubtreeRaising)
+        {
+            son(indexOfLargestBranch)->discardRaised();
+        }
     }
 }
 
-ClassifierTree *C45PruneableClassifierTree::getNewTree(Instances &data) const
+std::vector<C45PruneableClassifierTree::PruningResult> C45PruneableClassifierTree::sweepConfidenceFactors(const std::vector<float> &cfs) const
 {
 
-    C45PruneableClassifierTree *newTree = new C45PruneableClassifierTree(mToSelectModel, mPruneTheTree, mCF, mSubtreeRaising, mCleanup, mCollapseTheTree);
-    newTree->buildTree(data, mSubtreeRaising || !mCleanup);
+    std::vector<ErrorEstimator> estimators;
+    std::vector<PruningResult> results;
+
+    estimators.reserve(cfs.size());
+    for (float cf : cfs)
+    {
+        estimators.emplace_back(cf);
+    }
+    sweep(estimators, results);
+    return results;
+}
+
+void C45PruneableClassifierTree::sweep(const std::vector<ErrorEstimator> &estimators, std::vector<PruningResult> &results) const
+{
+
+    Distribution *distribution = localModel()->getDistribution();
+    std::vector<PruningResult> sonResults;
+    int k;
+
+    results.resize(estimators.size());
+    for (k = 0; k < (int)estimators.size(); k++)
+    {
+        results[k] = PruningResult{ estimators[k].confidence(), 1, 0, 0, 0 };
+    }
+    if (!mIsLeaf)
+    {
+
+        // Add up the pruned subtrees, as prune() does for each of them
+        for (int i = 0; i < (int)mSons.size(); i++)
+        {
+            son(i)->sweep(estimators, sonResults);
+            for (k = 0; k < (int)estimators.size(); k++)
+            {
+                results[k].numNodes += sonResults[k].numNodes;
+                results[k].numLeaves += sonResults[k].numLeaves;
+                results[k].estimatedErrors = results[k].estimatedErrors + sonResults[k].estimatedErrors;
+                results[k].trainingErrors = results[k].trainingErrors + sonResults[k].trainingErrors;
+            }
+        }
+    }
+    for (k = 0; k < (int)estimators.size(); k++)
+    {
+        double errorsLeaf = estimators[k].estimatedErrors(distribution->total(), distribution->numIncorrect());
+
+        // Decide if leaf is best choice.
+        if (mIsLeaf || Utils::smOrEq(errorsLeaf, results[k].estimatedErrors + 0.1))
+        {
+            results[k] = PruningResult{ estimators[k].confidence(), 1, 1, errorsLeaf, distribution->numIncorrect() };
+        }
+    }
+}
+
+ClassifierTree *C45PruneableClassifierTree::getNewTree(const InstancesView &data, SortedInstances *sorted) const
+{
+
+    C45PruneableClassifierTree *newTree = new C45PruneableClassifierTree(mToSelectModel, mPruneTheTree, mCF, mSubtreeRaising, mCleanup, mCollapseTheTree, mPresort, mNumBins, mCountTables);
+    attachSubtree(*newTree);
+    newTree->mErrorEstimator = mErrorEstimator;
+    if (mPruneTheTree && mSubtreeRaising)
+    {
+        newTree->mRows = new InstancesView(data);
+    }
+    newTree->buildTree(data, sorted, !mCleanup);
 
     return newTree;
 }
 
+ClassifierTree *C45PruneableClassifierTree::getEmptyTree() const
+{
+    C45PruneableClassifierTree *newTree = new C45PruneableClassifierTree(mToSelectModel, mPruneTheTree, mCF, mSubtreeRaising, mCleanup, mCollapseTheTree, mPresort, mNumBins, mCountTables);
+    attachSubtree(*newTree);
+    newTree->mErrorEstimator = mErrorEstimator;
+    return newTree;
+}
+
 double C45PruneableClassifierTree::getEstimatedErrors() const
 {
 
-    double errors = 0;
-    int i;
+    // the leaves are estimated in one call, then added up as the tree
+    // nests them
+    double_array totals;
+    double_array incorrect;
+    getLeafErrors(totals, incorrect);
+    double_array estimates(totals.size());
+    mErrorEstimator->estimatedErrors(totals.data(), incorrect.data(), estimates.data(), (int)totals.size());
+    int next = 0;
+    return sumEstimatedErrors(estimates, next);
+}
+
+void C45PruneableClassifierTree::getLeafErrors(double_array &totals, double_array &incorrect) const
+{
 
     if (mIsLeaf)
     {
-        return getEstimatedErrorsForDistribution(localModel()->getDistribution());
+        totals.push_back(localModel()->getDistribution()->total());
+        incorrect.push_back(localModel()->getDistribution()->numIncorrect());
     }
     else
     {
-        for (i = 0; i < (int)mSons.size(); i++)
+        for (int i = 0; i < (int)mSons.size(); i++)
         {
-            errors = errors + son(i)->getEstimatedErrors();
+            son(i)->getLeafErrors(totals, incorrect);
         }
-        return errors;
     }
 }
 
-double C45PruneableClassifierTree::getEstimatedErrorsForBranch(Instances &data) const
+double C45PruneableClassifierTree::sumEstimatedErrors(const double_array &estimates, int &next) const
 {
 
-    std::vector<Instances*> localInstances;
     double errors = 0;
-    int i;
 
     if (mIsLeaf)
     {
-        return getEstimatedErrorsForDistribution(new Distribution(data));
+        return estimates[next++];
     }
     else
     {
-        Distribution *savedDist = localModel()->getDistribution();
-        localModel()->resetDistribution(data);
-
-        localInstances = static_cast<std::vector<Instances*>>(localModel()->split(data));
-        localModel()->setDistribution(savedDist);
-        for (i = 0; i < (int)mSons.size(); i++)
+        for (int i = 0; i < (int)mSons.size(); i++)
         {
-            errors = errors + son(i)->getEstimatedErrorsForBranch(*localInstances[i]);
+            errors = errors + son(i)->sumEstimatedErrors(estimates, next);
         }
         return errors;
     }
 }
 
-double C45PruneableClassifierTree::getEstimatedErrorsForDistribution(Distribution *theDistribution) const
+void C45PruneableClassifierTree::partitionRows()
 {
 
-    if (Utils::eq(theDistribution->total(), 0))
+    if (mKnownDistribution != nullptr)
     {
-        return 0;
+        return;
     }
-    else
+    mKnownDistribution = new Distribution(localModel()->numSubsets(), mRows->numClasses());
+    mUnknownRows = new InstancesView(*mRows, 0);
+    for (int i = 0; i < mRows->numInstances(); i++)
+    {
+        int subset = localModel()->whichSubset(mRows->instance(i));
+        if (subset > -1)
+        {
+            mKnownDistribution->add(subset, static_cast<int>(mRows->classValue(i)), mRows->weight(i));
+        }
+        else
+        {
+            mUnknownRows->add(mRows->index(i), mRows->weight(i));
+        }
+    }
+}
+
+void C45PruneableClassifierTree::deletePartition()
+{
+
+    delete mKnownDistribution;
+    mKnownDistribution = nullptr;
+    delete mUnknownRows;
+    mUnknownRows = nullptr;
+}
+
+double C45PruneableClassifierTree::getEstimatedErrorsForBranch(std::vector<RowChange> *changes)
+{
+
+    std::vector<std::vector<RowChange>*> sonChanges;
+    std::vector<RowChange> unknownChanges;
+    std::vector<RowChange> unknownRows;
+    double errors = 0;
+    int i, j;
+
+    // the subtree stays as it is if no row changes
+    mRaisedChanges = changes;
+    if (changes->empty())
     {
-        return theDistribution->numIncorrect() + Stats::addErrs(theDistribution->total(), theDistribution->numIncorrect(), mCF);
+        return getEstimatedErrors();
     }
+    partitionRows();
+    for (j = 0; j < (mIsLeaf ? 0 : (int)mSons.size()); j++)
+    {
+        sonChanges.push_back(new std::vector<RowChange>());
+    }
+
+    // the changes of the known rows are made to the known distribution and
+    // passed on to the sons the rows go to
+    mRaisedKnownDistribution = new Distribution(*mKnownDistribution);
+    for (const RowChange &change : *changes)
+    {
+        Instance &instance = mRows->dataset().instance(change.index);
+        int subset = localModel()->whichSubset(instance);
+        if (subset > -1)
+        {
+            int classIndex = static_cast<int>(instance.classValue());
+            if (change.oldWeight >= 0)
+            {
+                mRaisedKnownDistribution->add(subset, classIndex, -change.oldWeight);
+            }
+            if (change.newWeight >= 0)
+            {
+                mRaisedKnownDistribution->add(subset, classIndex, change.newWeight);
+            }
+            if (!mIsLeaf)
+            {
+                sonChanges[subset]->push_back(change);
+            }
+        }
+        else
+        {
+            unknownChanges.push_back(change);
+        }
+    }
+
+    // the unknown rows before and after, both in order
+    i = 0;
+    for (const RowChange &change : unknownChanges)
+    {
+        for (; i < mUnknownRows->numInstances() && mUnknownRows->index(i) < change.index; i++)
+        {
+            unknownRows.push_back({ mUnknownRows->index(i), mUnknownRows->weight(i), mUnknownRows->weight(i) });
+        }
+        if (i < mUnknownRows->numInstances() && mUnknownRows->index(i) == change.index)
+        {
+            i++;
+        }
+        unknownRows.push_back(change);
+    }
+    for (; i < mUnknownRows->numInstances(); i++)
+    {
+        unknownRows.push_back({ mUnknownRows->index(i), mUnknownRows->weight(i), mUnknownRows->weight(i) });
+    }
+    mRaisedUnknownRows = new InstancesView(*mRows, (int)unknownRows.size());
+    for (const RowChange &row : unknownRows)
+    {
+        if (row.newWeight >= 0)
+        {
+            mRaisedUnknownRows->add(row.index, row.newWeight);
+        }
+    }
+    mRaisedDistribution = new Distribution(*mRaisedKnownDistribution);
+    mRaisedDistribution->addUnknown(*mRaisedUnknownRows);
+    if (mIsLeaf)
+    {
+        return getEstimatedErrorsForDistribution(mRaisedDistribution);
+    }
+
+    // the unknown rows are sent to the sons again, weighted with the new
+    // distribution, as far as their weights there change
+    if (!unknownRows.empty())
+    {
+        Distribution *distribution = localModel()->getDistribution();
+        for (j = 0; j < (int)mSons.size(); j++)
+        {
+            double oldShare = distribution->perBag(j) / distribution->total();
+            double newShare = mRaisedDistribution->perBag(j) / mRaisedDistribution->total();
+            std::vector<RowChange> &sonChange = *sonChanges[j];
+            int known = (int)sonChange.size();
+            for (const RowChange &row : unknownRows)
+            {
+                RowChange change = { row.index, -1, -1 };
+                if (row.oldWeight >= 0 && Utils::gr(oldShare, 0))
+                {
+                    change.oldWeight = oldShare * row.oldWeight;
+                }
+                if (row.newWeight >= 0 && Utils::gr(newShare, 0))
+                {
+                    change.newWeight = newShare * row.newWeight;
+                }
+                if (change.oldWeight != change.newWeight)
+                {
+                    sonChange.push_back(change);
+                }
+            }
+            std::inplace_merge(sonChange.begin(), sonChange.begin() + known, sonChange.end(), [](const RowChange &a, const RowChange &b) { return a.index < b.index; });
+        }
+    }
+    for (j = 0; j < (int)mSons.size(); j++)
+    {
+        errors = errors + son(j)->getEstimatedErrorsForBranch(sonChanges[j]);
+    }
+    return errors;
+}
+
+double C45PruneableClassifierTree::getEstimatedErrorsForDistribution(Distribution *theDistribution) const
+{
+
+    return mErrorEstimator->estimatedErrors(theDistribution->total(), theDistribution->numIncorrect());
 }
 
 double C45PruneableClassifierTree::getTrainingErrors() const
@@ -226,40 +589,123 @@ ClassifierSplitModel *C45PruneableClassifierTree::localModel() const
     return static_cast<ClassifierSplitModel*>(mLocalModel);
 }
 
-void C45PruneableClassifierTree::newDistribution(Instances &data)
+void C45PruneableClassifierTree::installRaised()
 {
 
-    std::vector<Instances*> localInstances;
+    if (mRaisedDistribution == nullptr)
+    {
+        return;
+    }
+    delete localModel()->getDistribution();
+    localModel()->setDistribution(mRaisedDistribution);
+    mRaisedDistribution = nullptr;
+    deletePartition();
+    mKnownDistribution = mRaisedKnownDistribution;
+    mRaisedKnownDistribution = nullptr;
+    mUnknownRows = mRaisedUnknownRows;
+    mRaisedUnknownRows = nullptr;
+}
+
+void C45PruneableClassifierTree::raise()
+{
+
+    // nothing changes below a node no row changes at
+    if (mRaisedChanges->empty())
+    {
+        delete mRaisedChanges;
+        mRaisedChanges = nullptr;
+        return;
+    }
 
-    localModel()->resetDistribution(data);
-    mTrain = &data;
+    // the rows of the node with the changes made, both in order
+    InstancesView *raisedRows = new InstancesView(*mRows, mRows->numInstances());
+    int i = 0;
+    for (const RowChange &change : *mRaisedChanges)
+    {
+        for (; i < mRows->numInstances() && mRows->index(i) < change.index; i++)
+        {
+            raisedRows->add(mRows->index(i), mRows->weight(i));
+        }
+        if (i < mRows->numInstances() && mRows->index(i) == change.index)
+        {
+            i++;
+        }
+        if (change.newWeight >= 0)
+        {
+            raisedRows->add(change.index, change.newWeight);
+        }
+    }
+    for (; i < mRows->numInstances(); i++)
+    {
+        raisedRows->add(mRows->index(i), mRows->weight(i));
+    }
+    delete mRows;
+    mRows = raisedRows;
+    delete mRaisedChanges;
+    mRaisedChanges = nullptr;
+    installRaised();
+    if (!mCleanup)
+    {
+        mTrain = keepInArena(mRows->toInstances());
+    }
     if (!mIsLeaf)
     {
-        localInstances = static_cast<std::vector<Instances*>>(localModel()->split(data));
-        for (int i = 0; i < (int)mSons.size(); i++)
+        for (i = 0; i < (int)mSons.size(); i++)
         {
-            son(i)->newDistribution(*localInstances[i]);
+            son(i)->raise();
         }
     }
     else
     {
 
         // Check whether there are some instances at the leaf now!
-        if (!Utils::eq(data.sumOfWeights(), 0))
+        if (!Utils::eq(mRows->sumOfWeights(), 0))
         {
             mIsEmpty = false;
         }
     }
 }
 
-C45PruneableClassifierTree *C45PruneableClassifierTree::son(int index) const
+void C45PruneableClassifierTree::discardRaised()
 {
-    return static_cast<C45PruneableClassifierTree*>(mSons[index]);
+
+    if (mRaisedChanges == nullptr)
+    {
+        return;
+    }
+    delete mRaisedChanges;
+    mRaisedChanges = nullptr;
+    delete mRaisedDistribution;
+    mRaisedDistribution = nullptr;
+    delete mRaisedKnownDistribution;
+    mRaisedKnownDistribution = nullptr;
+    delete mRaisedUnknownRows;
+    mRaisedUnknownRows = nullptr;
+    if (!mIsLeaf)
+    {
+        for (int i = 0; i < (int)mSons.size(); i++)
+        {
+            son(i)->discardRaised();
+        }
+    }
 }
 
-void C45PruneableClassifierTree::serialize(std::ostream &os)
+void C45PruneableClassifierTree::deleteRows()
 {
-	ClassifierTree::serialize(os);
-	os << mPruneTheTree << '\0' << mCollapseTheTree << '\0' << mSubtreeRaising
-		<< '\0' << mCleanup << '\0' << mCF << '\0';
-}
\ No newline at end of file
+
+    delete mRows;
+    mRows = nullptr;
+    deletePartition();
+    if (!mIsLeaf)
+    {
+        for (int i = 0; i < (int)mSons.size(); i++)
+        {
+            son(i)->deleteRows();
+        }
+    }
+}
+
+C45PruneableClassifierTree *C45PruneableClassifierTree::son(int index) const
+{
+    return static_cast<C45PruneableClassifierTree*>(mSons[index]);
+}
@@ -11,6 +11,10 @@
 class ModelSelection;
 class Instances;
 class Distribution;
+class SortedInstances;
+class InstancesView;
+class ErrorEstimator;
+class LevelWiseBuilder;
 
 /**
  * Class for handling a tree structure that can
@@ -34,16 +38,103 @@ protected:
     /** Cleanup after the tree has been built. */
     bool mCleanup = true;
 
+    /** Sort numeric attributes once instead of at every node? */
+    bool mPresort = true;
+
+    /** The number of bins numeric attributes are cut into, 0 for exact splits. */
+    int mNumBins = 0;
+
+    /** Derive the counts of the largest son from its parent's? */
+    bool mCountTables = false;
+
+    /** The error estimates for the confidence factor, owned by the root. */
+    ErrorEstimator *mErrorEstimator = nullptr;
+
+    /**
+     * A row whose weight at a node changes if a branch is raised. A weight
+     * of -1 means that the row is not at the node, before or after.
+     */
+    struct RowChange
+    {
+        /** The index of the instance in the base dataset. */
+        int index;
+
+        /** The weight of the row at the node. */
+        double oldWeight;
+
+        /** The weight of the row at the node once the branch is raised. */
+        double newWeight;
+    };
+
+    /** The training rows reaching this node, kept for subtree raising. */
+    InstancesView *mRows = nullptr;
+
+    /**
+     * The distribution of the rows of this node over the subsets of the
+     * local model, leaving out the rows missing the value the model splits
+     * on. Computed when pruning first needs it.
+     */
+    Distribution *mKnownDistribution = nullptr;
+
+    /** The rows of this node missing the value the local model splits on. */
+    InstancesView *mUnknownRows = nullptr;
+
+    /**
+     * The rows whose weight at this node would change if its branch were
+     * raised, in ascending order of their indices.
+     */
+    std::vector<RowChange> *mRaisedChanges = nullptr;
+
+    /** The distribution of the local model for the raised rows. */
+    Distribution *mRaisedDistribution = nullptr;
+
+    /** The known distribution for the raised rows. */
+    Distribution *mRaisedKnownDistribution = nullptr;
+
+    /** The rows missing the split value among the raised rows. */
+    InstancesView *mRaisedUnknownRows = nullptr;
+
     /**
        * Returns a newly created tree.
        *
-       * @param data the data to work with
+       * @param data the rows to work with
+       * @param sorted the presorted orders of the rows, may be null
        * @return the new tree
        * @throws Exception if something goes wrong
        */
-    virtual ClassifierTree *getNewTree(Instances &data) const override;
+    virtual ClassifierTree *getNewTree(const InstancesView &data, SortedInstances *sorted) const override;
+
+    /**
+     * Returns a new pruneable tree with the same settings that has not been
+     * built.
+     *
+     * @return the new tree
+     */
+    virtual ClassifierTree *getEmptyTree() const override;
 
 public:
+    /**
+     * The size and the estimated errors of the tree pruned with one
+     * confidence factor.
+     */
+    struct PruningResult
+    {
+        /** The confidence factor. */
+        float confidence;
+
+        /** The number of nodes of the pruned tree. */
+        int numNodes;
+
+        /** The number of leaves of the pruned tree. */
+        int numLeaves;
+
+        /** The estimated errors of the pruned tree. */
+        double estimatedErrors;
+
+        /** The errors of the pruned tree on the training data. */
+        double trainingErrors;
+    };
+
     /**
      * Constructor for pruneable tree structure. Stores reference
      * to associated training data at each node.
@@ -53,9 +144,21 @@ public:
      * @param cf the confidence factor for pruning
      * @param raiseTree
      * @param cleanup
+     * @param collapseTree
+     * @param presort true if numeric attributes are to be sorted only once
+     * @param numBins the number of quantile bins numeric attributes are cut
+     *          into for approximate splits, 0 for exact splits
+     * @param countTables true if every node is to keep its class counts per
+     *          nominal value, deriving those of its largest son by subtraction
      * @throws Exception if something goes wrong
      */
-    C45PruneableClassifierTree(ModelSelection *toSelectLocModel, bool pruneTree, float cf, bool raiseTree, bool cleanup, bool collapseTree);
+    C45PruneableClassifierTree(ModelSelection *toSelectLocModel, bool pruneTree, float cf, bool raiseTree, bool cleanup, bool collapseTree, bool presort, int numBins, bool countTables);
+
+    /**
+     * Deletes the rows kept for subtree raising, and the error estimates if
+     * this is the root.
+     */
+    virtual ~C45PruneableClassifierTree();
 
     /**
      * Method for building a pruneable classifier tree.
@@ -65,6 +168,28 @@ public:
      */
     virtual void buildClassifier(Instances &data) override;
 
+    /**
+     * Method for building a pruneable classifier tree from rows of a
+     * dataset, all of which have a class value.
+     *
+     * @param data the rows for building the tree
+     * @param sorted the presorted orders of the rows, taken over by the
+     *          tree, may be null
+     * @throws Exception if something goes wrong
+     */
+    void buildClassifier(const InstancesView &data, SortedInstances *sorted);
+
+    /**
+     * Method for building a pruneable classifier tree level by level from
+     * training data that is not held in memory. Subtree raising needs the
+     * rows of every node, so the tree must be built without it.
+     *
+     * @param builder the builder reading the training data
+     * @param header the header of the training data
+     * @throws Exception if something goes wrong
+     */
+    void buildClassifier(LevelWiseBuilder &builder, Instances &header);
+
     /**
      * Collapses a tree to a node if training error doesn't increase.
      */
@@ -77,7 +202,18 @@ public:
      */
     virtual void prune();
 
-	void serialize(std::ostream &os) override;
+    /**
+     * Computes what pruning the tree would give for each of a number of
+     * confidence factors, in one bottom-up pass that shares the
+     * distributions of the nodes. The tree is meant to have been grown
+     * without pruning and is left unchanged. The results are those of
+     * pruning without subtree raising, as raising routes the training data
+     * anew for every confidence factor.
+     *
+     * @param cfs the confidence factors
+     * @return the results, in the order of the confidence factors
+     */
+    std::vector<PruningResult> sweepConfidenceFactors(const std::vector<float> &cfs) const;
 
 private:
     /**
@@ -88,13 +224,81 @@ private:
     double getEstimatedErrors() const;
 
     /**
-     * Computes estimated errors for one branch.
+     * Collects the number of instances and the training errors of the
+     * leaves of the tree, from left to right.
      *
-     * @param data the data to work with
+     * @param totals receives the number of instances of each leaf
+     * @param incorrect receives the training errors of each leaf
+     */
+    void getLeafErrors(double_array &totals, double_array &incorrect) const;
+
+    /**
+     * Adds up the estimated errors of the leaves of the tree node by node.
+     *
+     * @param estimates the estimated errors of the leaves, from left to right
+     * @param next the index of the first estimate of the tree, advanced past
+     *          its last one
+     * @return the estimated errors
+     */
+    double sumEstimatedErrors(const double_array &estimates, int &next) const;
+
+    /**
+     * Computes the results of sweepConfidenceFactors() for the subtree.
+     *
+     * @param estimators the error estimates for each confidence factor
+     * @param results receives the result for each confidence factor
+     */
+    void sweep(const std::vector<ErrorEstimator> &estimators, std::vector<PruningResult> &results) const;
+
+    /**
+     * Computes the known distribution and the unknown rows of the node, if
+     * that has not been done yet.
+     */
+    void partitionRows();
+
+    /**
+     * Drops the known distribution and the unknown rows of the node, e.g.
+     * when its local model is replaced.
+     */
+    void deletePartition();
+
+    /**
+     * Computes estimated errors for one branch as if it were raised to take
+     * the place of its parent. Only the rows that raising changes are routed
+     * through the branch, updating the distributions of its nodes, and the
+     * rows missing a split value are reweighted only at the nodes that have
+     * any. A subtree no row changes in keeps its distributions. The changes
+     * and the resulting distributions are kept, so that raising the branch
+     * does not have to route the rows again.
+     *
+     * @param changes the rows whose weight at the node changes, owned by
+     *          the branch from now on
      * @return the estimated errors
      * @throws Exception if something goes wrong
      */
-    double getEstimatedErrorsForBranch(Instances &data) const;
+    double getEstimatedErrorsForBranch(std::vector<RowChange> *changes);
+
+    /**
+     * Makes the distributions kept by getEstimatedErrorsForBranch() those of
+     * the node, without changing its rows.
+     */
+    void installRaised();
+
+    /**
+     * Makes the rows and distributions kept by getEstimatedErrorsForBranch()
+     * those of the nodes of the branch.
+     */
+    void raise();
+
+    /**
+     * Drops the rows and distributions kept by getEstimatedErrorsForBranch().
+     */
+    void discardRaised();
+
+    /**
+     * Drops the rows kept for subtree raising in all nodes of the tree.
+     */
+    void deleteRows();
 
     /**
      * Computes estimated errors for leaf.
@@ -118,15 +322,6 @@ private:
      */
     ClassifierSplitModel *localModel() const;
 
-    /**
-     * Computes new distributions of instances for nodes
-     * in tree.
-     *
-     * @param data the data to compute the distributions for
-     * @throws Exception if something goes wrong
-     */
-    void newDistribution(Instances &data);
-
     /**
      * Method just exists to make program easier to read.
      */
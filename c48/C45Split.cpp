@@ -1,14 +1,19 @@
 #include "C45Split.h"
 #include "core/Instances.h"
+#include "core/InstancesView.h"
 #include "InfoGainSplitCrit.h"
 #include "GainRatioSplitCrit.h"
 #include "core/Instance.h"
 #include "Distribution.h"
 #include "core/Utils.h"
+#include "SortedInstances.h"
+#include "core/BinaryWriter.h"
+#include "core/BinaryReader.h"
+#include <algorithm>
 
 
-InfoGainSplitCrit *C45Split::infoGainCrit = new InfoGainSplitCrit();
-GainRatioSplitCrit *C45Split::gainRatioCrit = new GainRatioSplitCrit();
+const InfoGainSplitCrit *const C45Split::infoGainCrit = new InfoGainSplitCrit();
+const GainRatioSplitCrit *const C45Split::gainRatioCrit = new GainRatioSplitCrit();
 
 C45Split::C45Split(int attIndex, int minNoObj, double sumOfWeights, bool useMDLcorrection) :
     mAttIndex(attIndex), // Get index of attribute to split on.
@@ -20,6 +25,11 @@ C45Split::C45Split(int attIndex, int minNoObj, double sumOfWeights, bool useMDLc
 }
 
 void C45Split::buildClassifier(Instances trainInstances)
+{
+    buildClassifier(InstancesView(trainInstances), nullptr);
+}
+
+void C45Split::buildClassifier(const InstancesView &trainInstances, const SortedInstances *sorted, NumericColumns *columns)
 {
     // Initialize the remaining instance variables.
     mNumSubsets = 0;
@@ -33,14 +43,29 @@ void C45Split::buildClassifier(Instances trainInstances)
     {
         mComplexityIndex = trainInstances.attribute(mAttIndex).numValues();
         mIndex = mComplexityIndex;
-        handleEnumeratedAttribute(trainInstances);
+        handleEnumeratedAttribute(trainInstances, sorted);
     }
     else
     {
         mComplexityIndex = 2;
         mIndex = 0;
-        trainInstances.Sort(trainInstances.attribute(mAttIndex));
-        handleNumericAttribute(trainInstances);
+        NumericColumns ownColumns;
+        if (columns == nullptr)
+        {
+            columns = &ownColumns;
+        }
+        if (sorted != nullptr && sorted->isBinned(mAttIndex))
+        {
+            handleBinnedAttribute(trainInstances, *sorted);
+        }
+        else if (sorted != nullptr && sorted->isSorted(mAttIndex))
+        {
+            handleNumericAttribute(trainInstances, sorted->order(mAttIndex), *columns);
+        }
+        else
+        {
+            handleNumericAttribute(trainInstances, trainInstances.sortedOrder(mAttIndex), *columns);
+        }
     }
 }
 
@@ -97,19 +122,38 @@ double C45Split::gainRatio() const
     return mGainRatio;
 }
 
-void C45Split::handleEnumeratedAttribute(Instances &trainInstances)
+void C45Split::handleEnumeratedAttribute(const InstancesView &trainInstances, const SortedInstances *sorted)
 {
 
-    mDistribution = new Distribution(mComplexityIndex, trainInstances.numClasses());
+    int numClasses = trainInstances.numClasses();
+    delete mDistribution;
+    mDistribution = new Distribution(mComplexityIndex, numClasses);
 
-    // Only Instances with known values are relevant.
-    int totalInst = trainInstances.numInstances();
-    for (int i = 0; i < totalInst; i++)
+    // Only Instances with known values are relevant. Take their counts
+    // from the node if it keeps them.
+    if (sorted != nullptr && sorted->hasCounts(mAttIndex))
+    {
+        const double_array &counts = sorted->histogram(mAttIndex);
+        for (int value = 0; value < mComplexityIndex; value++)
+        {
+            for (int j = 0; j < numClasses; j++)
+            {
+                if (counts[value * numClasses + j] > 0)
+                {
+                    mDistribution->add(value, j, counts[value * numClasses + j]);
+                }
+            }
+        }
+    }
+    else
     {
-        Instance &instance = trainInstances.instance(i);
-        if (!instance.isMissing(mAttIndex))
+        int totalInst = trainInstances.numInstances();
+        for (int i = 0; i < totalInst; i++)
         {
-            mDistribution->add(static_cast<int>(instance.value(mAttIndex)), instance);
+            if (!trainInstances.isMissing(i, mAttIndex))
+            {
+                mDistribution->add(static_cast<int>(trainInstances.value(i, mAttIndex)), static_cast<int>(trainInstances.classValue(i)), trainInstances.weight(i));
+            }
         }
     }
 
@@ -123,7 +167,7 @@ void C45Split::handleEnumeratedAttribute(Instances &trainInstances)
     }
 }
 
-void C45Split::handleNumericAttribute(Instances &trainInstances)
+void C45Split::handleNumericAttribute(const InstancesView &trainInstances, const int_array &order, NumericColumns &columns)
 {
 
     int firstMiss;
@@ -136,19 +180,30 @@ void C45Split::handleNumericAttribute(Instances &trainInstances)
     int i;
 
     // Current attribute is a numeric attribute.
+    delete mDistribution;
     mDistribution = new Distribution(2, trainInstances.numClasses());
 
-    // Only Instances with known values are relevant.
-    int totalInst = trainInstances.numInstances();
+    // Only Instances with known values are relevant. Their values, classes
+    // and weights are gathered into contiguous columns once, so that the
+    // sweep below does not go back to the Instances for every candidate.
+    double_array &values = columns.values;
+    int_array &classes = columns.classes;
+    double_array &classWeights = columns.weights;
+    int totalInst = (int)order.size();
+    values.clear();
+    classes.clear();
+    classWeights.clear();
     i = 0;
     for (int j = 0; j < totalInst; j++)
     {
-        Instance &instance = trainInstances.instance(j);
-        if (instance.isMissing(mAttIndex))
+        if (trainInstances.isMissing(order[j], mAttIndex))
         {
             break;
         }
-        mDistribution->add(1, instance);
+        values.push_back(trainInstances.value(order[j], mAttIndex));
+        classes.push_back(static_cast<int>(trainInstances.classValue(order[j])));
+        classWeights.push_back(trainInstances.weight(order[j]));
+        mDistribution->add(1, classes[i], classWeights[i]);
         i++;
     }
     firstMiss = i;
@@ -177,12 +232,12 @@ void C45Split::handleNumericAttribute(Instances &trainInstances)
     defaultEnt = infoGainCrit->oldEnt(*mDistribution);
     while (next < firstMiss)
     {
-        if ( trainInstances.instance(next - 1).value(mAttIndex)+ 1e-5 < trainInstances.instance(next).value(mAttIndex))
+        if (values[next - 1] + 1e-5 < values[next])
         {
 
             // Move class values for all Instances up to next
             // possible split point.
-            mDistribution->shiftRange(1, 0, trainInstances, last, next);
+            mDistribution->shiftRange(1, 0, classes, classWeights, last, next);
 
             // Check if enough Instances in each subset and compute
             // values for criteria.
@@ -220,19 +275,148 @@ void C45Split::handleNumericAttribute(Instances &trainInstances)
     // Set instance variables' values to values for
     // best split.
     mNumSubsets = 2;
-    mSplitPoint = (trainInstances.instance(splitIndex + 1).value(mAttIndex) + trainInstances.instance(splitIndex).value(mAttIndex)) / 2;
+    mSplitPoint = (values[splitIndex + 1] + values[splitIndex]) / 2;
 
     // In case we have a numerical precision problem we need to choose the
     // smaller value
-    if (mSplitPoint == trainInstances.instance(splitIndex + 1).value(mAttIndex))
+    if (mSplitPoint == values[splitIndex + 1])
     {
-        mSplitPoint = trainInstances.instance(splitIndex).value(mAttIndex);
+        mSplitPoint = values[splitIndex];
     }
 
     // Restore distributioN for best split.
-    mDistribution = new Distribution(2, trainInstances.numClasses());
-    mDistribution->addRange(0, trainInstances, 0, splitIndex + 1);
-    mDistribution->addRange(1, trainInstances, splitIndex + 1, firstMiss);
+    mDistribution->initialize();
+    mDistribution->addRange(0, classes, classWeights, 0, splitIndex + 1);
+    mDistribution->addRange(1, classes, classWeights, splitIndex + 1, firstMiss);
+
+    // Compute modified gain ratio for best split.
+    mGainRatio = gainRatioCrit->splitCritValue(*mDistribution, mSumOfWeights, mInfoGain);
+}
+
+void C45Split::handleBinnedAttribute(const InstancesView &trainInstances, const SortedInstances &binned)
+{
+
+    int numClasses = trainInstances.numClasses();
+    int numBins = binned.numBins(mAttIndex);
+    const double_array &histogram = binned.histogram(mAttIndex);
+    int splitBin = -1;
+    int lastBin = -1;
+    double currentInfoGain;
+    double defaultEnt;
+    double minSplit;
+
+    // Only Instances with known values are relevant; the histogram holds
+    // nothing else.
+    delete mDistribution;
+    mDistribution = new Distribution(2, numClasses);
+    double_array binWeights(numBins, 0);
+    for (int bin = 0; bin < numBins; bin++)
+    {
+        for (int j = 0; j < numClasses; j++)
+        {
+            if (histogram[bin * numClasses + j] > 0)
+            {
+                mDistribution->add(1, j, histogram[bin * numClasses + j]);
+                binWeights[bin] += histogram[bin * numClasses + j];
+            }
+        }
+    }
+
+    // Compute minimum number of Instances required in each
+    // subset.
+    minSplit = 0.1 * (mDistribution->total()) / numClasses;
+    if (Utils::smOrEq(minSplit, mMinNoObj))
+    {
+        minSplit = mMinNoObj;
+    }
+    else
+    {
+        if (Utils::gr(minSplit, 25))
+            minSplit = 25;
+    }
+
+    // Enough Instances with known values?
+    if (Utils::sm(mDistribution->total(), 2 * minSplit))
+    {
+        return;
+    }
+
+    // Compute values of criteria for the split points between all
+    // non-empty bins.
+    defaultEnt = infoGainCrit->oldEnt(*mDistribution);
+    for (int bin = 0; bin < numBins; bin++)
+    {
+        if (!Utils::gr(binWeights[bin], 0))
+        {
+            continue;
+        }
+        if (lastBin >= 0 && binned.upperValue(mAttIndex, lastBin) + 1e-5 < binned.lowerValue(mAttIndex, bin))
+        {
+
+            // Check if enough Instances in each subset and compute
+            // values for criteria.
+            if (Utils::grOrEq(mDistribution->perBag(0), minSplit) && Utils::grOrEq(mDistribution->perBag(1), minSplit))
+            {
+                currentInfoGain = infoGainCrit->splitCritValue(*mDistribution, mSumOfWeights, defaultEnt);
+                if (Utils::gr(currentInfoGain, mInfoGain))
+                {
+                    mInfoGain = currentInfoGain;
+                    splitBin = lastBin;
+                }
+                mIndex++;
+            }
+        }
+
+        // Move the bin to the left subset.
+        mDistribution->shiftCounts(1, 0, histogram.data() + bin * numClasses);
+        lastBin = bin;
+    }
+
+    // Was there any useful split?
+    if (mIndex == 0)
+    {
+        return;
+    }
+
+    // Compute modified information gain for best split.
+    if (mUseMDLcorrection)
+    {
+        mInfoGain = mInfoGain - (Utils::getLog2(mIndex) / mSumOfWeights);
+    }
+    if (Utils::smOrEq(mInfoGain, 0))
+    {
+        return;
+    }
+
+    // Set instance variables' values to values for
+    // best split, between the bin and the next non-empty one.
+    int nextBin = splitBin + 1;
+    while (!Utils::gr(binWeights[nextBin], 0))
+    {
+        nextBin++;
+    }
+    mNumSubsets = 2;
+    mSplitPoint = (binned.lowerValue(mAttIndex, nextBin) + binned.upperValue(mAttIndex, splitBin)) / 2;
+
+    // In case we have a numerical precision problem we need to choose the
+    // smaller value
+    if (mSplitPoint == binned.lowerValue(mAttIndex, nextBin))
+    {
+        mSplitPoint = binned.upperValue(mAttIndex, splitBin);
+    }
+
+    // Restore distributioN for best split.
+    mDistribution->initialize();
+    for (int bin = 0; bin < numBins; bin++)
+    {
+        for (int j = 0; j < numClasses; j++)
+        {
+            if (histogram[bin * numClasses + j] > 0)
+            {
+                mDistribution->add((bin <= splitBin) ? 0 : 1, j, histogram[bin * numClasses + j]);
+            }
+        }
+    }
 
     // Compute modified gain ratio for best split.
     mGainRatio = gainRatioCrit->splitCritValue(*mDistribution, mSumOfWeights, mInfoGain);
@@ -270,28 +454,19 @@ string C45Split::rightSide(const int index, Instances &data) const
     return text;
 }
 
-void C45Split::setSplitPoint(Instances &allInstances)
+void C45Split::setSplitPoint(const double_array &sortedValues)
 {
 
-    double newSplitPoint = -std::numeric_limits<double>::max();
-    double tempValue;
-
-    if ((allInstances.attribute(mAttIndex).isNumeric()) && (mNumSubsets > 1))
+    if (mNumSubsets > 1)
     {
-        int totalInst = allInstances.numInstances();
-        for (int i = 0; i < totalInst; i++)
+        // The values up to the split point come first, so the greatest one
+        // is found by a binary search rather than a scan of the data.
+        double splitPoint = mSplitPoint;
+        auto next = std::partition_point(sortedValues.begin(), sortedValues.end(), [splitPoint](double value)
         {
-            Instance &instance = allInstances.instance(i);
-            if (!instance.isMissing(mAttIndex))
-            {
-                tempValue = instance.value(mAttIndex);
-                if (Utils::gr(tempValue, newSplitPoint) && Utils::smOrEq(tempValue, mSplitPoint))
-                {
-                    newSplitPoint = tempValue;
-                }
-            }
-        }
-        mSplitPoint = newSplitPoint;
+            return Utils::smOrEq(value, splitPoint);
+        });
+        mSplitPoint = (next != sortedValues.begin()) ? *(next - 1) : -std::numeric_limits<double>::max();
     }
 }
 
@@ -323,33 +498,47 @@ double_2D_array C45Split::minsAndMaxs(Instances &data, const double_2D_array &mi
 void C45Split::resetDistribution(Instances &data)
 {
 
-    Instances *insts = new Instances(&data, 0);
+    // the known instances are gathered without making them refer to the
+    // temporary set
+    std::vector<Instance*> known;
     for (int i = 0; i < data.numInstances(); i++)
     {
         if (whichSubset(data.instance(i)) > -1)
         {
-            insts->add(data.instance(i));
+            known.push_back(&data.instance(i));
         }
     }
-    Distribution *newD = new Distribution(*insts, *this);
+    Instances insts(&data, known);
+    Distribution *newD = new Distribution(insts, *this);
     newD->addInstWithUnknown(data, mAttIndex);
+    delete mDistribution;
     mDistribution = newD;
 }
 
-double_array C45Split::weights(Instance &instance) const
+void C45Split::resetDistribution(const InstancesView &data)
 {
 
-    double_array weights;
-    int i;
-
-    if (instance.isMissing(mAttIndex))
+    // the known rows in order, then the unknown ones spread over the bags
+    Distribution *newD = new Distribution(mNumSubsets, data.numClasses());
+    for (int i = 0; i < data.numInstances(); i++)
     {
-        weights = double_array(mNumSubsets);
-        for (i = 0; i < mNumSubsets; i++)
+        int subset = whichSubset(data.instance(i));
+        if (subset > -1)
         {
-            weights[i] = mDistribution->perBag(i) / mDistribution->total();
+            newD->add(subset, static_cast<int>(data.classValue(i)), data.weight(i));
         }
-        return weights;
+    }
+    newD->addInstWithUnknown(data, mAttIndex);
+    delete mDistribution;
+    mDistribution = newD;
+}
+
+double_array C45Split::weights(Instance &instance) const
+{
+
+    if (instance.isMissing(mAttIndex))
+    {
+        return missingWeights();
     }
     else
     {
@@ -357,6 +546,17 @@ double_array C45Split::weights(Instance &instance) const
     }
 }
 
+double_array C45Split::missingWeights() const
+{
+
+    double_array weights(mNumSubsets);
+    for (int i = 0; i < mNumSubsets; i++)
+    {
+        weights[i] = mDistribution->perBag(i) / mDistribution->total();
+    }
+    return weights;
+}
+
 const int C45Split::whichSubset(Instance &instance) const
 {
 
@@ -380,3 +580,58 @@ const int C45Split::whichSubset(Instance &instance) const
         }
     }
 }
+
+void C45Split::serialize(BinaryWriter &writer) const
+{
+    writer.writeInt(C45_SPLIT);
+    writer.writeInt(mAttIndex);
+    writer.writeInt(mMinNoObj);
+    writer.writeBool(mUseMDLcorrection);
+    writer.writeDouble(mSumOfWeights);
+    writer.writeInt(mNumSubsets);
+    writer.writeInt(mComplexityIndex);
+    writer.writeDouble(mSplitPoint);
+    writer.writeDouble(mInfoGain);
+    writer.writeDouble(mGainRatio);
+    writer.writeInt(mIndex);
+    mDistribution->serialize(writer);
+}
+
+C45Split *C45Split::deserialize(BinaryReader &reader, const Instances &header)
+{
+    int attIndex = reader.readInt();
+    if (attIndex < 0 || attIndex >= header.numAttributes() || attIndex == header.classIndex())
+    {
+        throw string("Invalid split attribute: ") + std::to_string(attIndex);
+    }
+    int minNoObj = reader.readInt();
+    bool useMDLcorrection = reader.readBool();
+    double sumOfWeights = reader.readDouble();
+
+    C45Split *result = new C45Split(attIndex, minNoObj, sumOfWeights, useMDLcorrection);
+    try
+    {
+        result->mNumSubsets = reader.readInt();
+        result->mComplexityIndex = reader.readInt();
+        result->mSplitPoint = reader.readDouble();
+        result->mInfoGain = reader.readDouble();
+        result->mGainRatio = reader.readDouble();
+        result->mIndex = reader.readInt();
+        result->mDistribution = Distribution::deserialize(reader, header);
+    }
+    catch (...)
+    {
+        delete result;
+        throw;
+    }
+
+    // Nominal attributes split into one subset per value, numeric ones in two.
+    const Attribute &attribute = header.attribute(attIndex);
+    int numSubsets = attribute.isNominal() ? attribute.numValues() : 2;
+    if (result->mNumSubsets != numSubsets || result->mDistribution->numBags() != numSubsets)
+    {
+        delete result;
+        throw string("Invalid split on attribute ") + std::to_string(attIndex);
+    }
+    return result;
+}
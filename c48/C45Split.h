@@ -13,6 +13,8 @@ class InfoGainSplitCrit;
 class GainRatioSplitCrit;
 class Instance;
 class Distribution;
+class SortedInstances;
+class InstancesView;
 
 
 /**
@@ -49,14 +51,37 @@ protected:
     /** Number of split points. */
     int mIndex = 0;
 
-    /** Static reference to splitting criterion. */
-    static InfoGainSplitCrit *infoGainCrit;
+    /**
+     * Static reference to splitting criterion. The criteria are stateless
+     * and only used through const methods, so splits on different attributes
+     * may be built concurrently.
+     */
+    static const InfoGainSplitCrit *const infoGainCrit;
 
     /** Static reference to splitting criterion. */
-    static GainRatioSplitCrit *gainRatioCrit;
+    static const GainRatioSplitCrit *const gainRatioCrit;
 
 public:
 
+    /**
+     * The values, classes and weights of the rows with a known value of a
+     * numeric attribute, gathered into contiguous columns for the sweep over
+     * the split points. The columns are handed in by the caller, so that
+     * they can be reused for the attributes of many nodes and released once
+     * the tree is built.
+     */
+    struct NumericColumns
+    {
+        /** The known values in ascending order. */
+        double_array values;
+
+        /** The class of each value. */
+        int_array classes;
+
+        /** The weight of each value. */
+        double_array weights;
+    };
+
     /** Constructor that initializes the split model. */
 
     C45Split(int attIndex, int minNoObj, double sumOfWeights, bool useMDLcorrection);
@@ -69,6 +94,19 @@ public:
      */
     virtual void buildClassifier(Instances trainInstances);
 
+    /**
+     * Creates a C4.5-type split on the given rows. Numeric attributes are
+     * scanned in the presorted order if one is given for the attribute.
+     * Assumes that none of the class values is missing.
+     *
+     * @param trainInstances the rows to split
+     * @param sorted the presorted orders of the rows, may be null
+     * @param columns the scratch columns for a numeric attribute, may be
+     *          null to allocate them for this split only
+     * @exception Exception if something goes wrong
+     */
+    void buildClassifier(const InstancesView &trainInstances, const SortedInstances *sorted, NumericColumns *columns = nullptr);
+
     /**
      * Returns index of attribute for which split was generated.
      */
@@ -122,9 +160,10 @@ public:
      * Sets split point to greatest value in given data smaller or equal to old
      * split point. (C4.5 does this for some strange reason).
      *
-     * @param data training set.
+     * @param sortedValues the distinct known values of the attribute in the
+     *          training set, in ascending order
      */
-    void setSplitPoint(Instances &allInstances);
+    void setSplitPoint(const double_array &sortedValues);
 
     /**
      * Returns the minsAndMaxs of the index.th subset.
@@ -140,12 +179,23 @@ public:
      */
     virtual void resetDistribution(Instances &data);
 
+    /**
+     * Sets distribution associated with model from the given rows.
+     */
+    virtual void resetDistribution(const InstancesView &data);
+
     /**
      * Returns weights if instance is assigned to more than one subset. Returns
      * null if instance is only assigned to one subset.
      */
     double_array weights(Instance &instance) const;
 
+    /**
+     * Returns the weights with which a row missing the value of the
+     * attribute is assigned to each subset.
+     */
+    double_array missingWeights() const;
+
     /**
      * Returns index of subset instance is assigned to. Returns -1 if instance is
      * assigned to more than one subset.
@@ -154,20 +204,54 @@ public:
      */
     const int whichSubset(Instance &instance) const;
 
+    /**
+     * Writes the model.
+     *
+     * @param writer the writer
+     */
+    void serialize(BinaryWriter &writer) const override;
+
+    /**
+     * Reads a model written by serialize(), after its tag.
+     *
+     * @param reader the reader
+     * @param header the header of the training data
+     * @return the model
+     * @exception Exception if the data is invalid
+     */
+    static C45Split *deserialize(BinaryReader &reader, const Instances &header);
+
 private:
     /**
      * Creates split on enumerated attribute.
      *
+     * @param trainInstances the rows to split
+     * @param sorted the presorted orders of the rows, may be null; its
+     *          counts for the attribute are used if it keeps them
      * @exception Exception if something goes wrong
      */
-    void handleEnumeratedAttribute(Instances &trainInstances);
+    void handleEnumeratedAttribute(const InstancesView &trainInstances, const SortedInstances *sorted);
 
     /**
-     * Creates split on numeric attribute.
+     * Creates split on numeric attribute, scanning the rows in the given
+     * ascending order of the attribute.
      *
+     * @param trainInstances the rows to split
+     * @param order the rows in ascending order of the attribute
+     * @param columns the scratch columns to gather the known values in
      * @exception Exception if something goes wrong
      */
-    void handleNumericAttribute(Instances &trainInstances);
+    void handleNumericAttribute(const InstancesView &trainInstances, const int_array &order, NumericColumns &columns);
+
+    /**
+     * Creates an approximate split on numeric attribute, considering only
+     * split points between the bins of the attribute. The bins are scanned
+     * instead of the rows.
+     *
+     * @param trainInstances the rows to split
+     * @param binned the class histograms of the rows
+     */
+    void handleBinnedAttribute(const InstancesView &trainInstances, const SortedInstances &binned);
 
 };
 
@@ -1,7 +1,16 @@
 #include "C48.h"
 #include "ModelSelection.h"
 #include "C45PruneableClassifierTree.h"
+#include "PruneableClassifierTree.h"
 #include "C45ModelSelection.h"
+#include "CompiledTree.h"
+#include "SortedInstances.h"
+#include "LevelWiseBuilder.h"
+#include "core/ColumnStore.h"
+#include "core/ThreadPool.h"
+#include "core/InstancesView.h"
+#include "core/BinaryWriter.h"
+#include "core/BinaryReader.h"
 #include <string.h>
 #include <exception>
 
@@ -19,28 +28,200 @@ C48::C48()
     mSubtreeRaising = true;
     mNoCleanup= false;
     mDoNotMakeSplitPointActualValue= false;
+    mPresort = true;
+    mNumBins = 0;
+    mCountTables = false;
+    mNumThreads = 1;
+    mThreadPool = nullptr;
+    mCompiledTree = nullptr;
+    mHeader = nullptr;
+    mFoldOrders = nullptr;
 }
 
 C48::~C48()
 {
     if(mRoot != nullptr)
         delete mRoot;
+    if (mThreadPool != nullptr)
+        delete mThreadPool;
+    if (mCompiledTree != nullptr)
+        delete mCompiledTree;
+    if (mHeader != nullptr)
+        delete mHeader;
+    if (mFoldOrders != nullptr)
+        delete mFoldOrders;
 }
 
 void C48::buildClassifier(Instances &instances)
 {
 
-    ModelSelection *modSelection = nullptr;
-    
-    modSelection = new C45ModelSelection(mMinNumObj, instances, mUseMDLcorrection, mDoNotMakeSplitPointActualValue);
+    C45ModelSelection *modSelection = newModelSelection(instances);
+    mRoot = newTree(modSelection);
+    mRoot->buildClassifier(instances);
+    modSelection->cleanup();
+    compile(instances);
+}
+
+void C48::buildClassifier(const InstancesView &train, SortedInstances *sorted)
+{
+
+    // the instances of the rows, shared rather than copied, stand in for
+    // the training data where a set of instances is needed
+    std::vector<Instance*> rows;
+    rows.reserve(train.numInstances());
+    for (int i = 0; i < train.numInstances(); i++)
+    {
+        rows.push_back(&train.instance(i));
+    }
+    Instances allData(&train.dataset(), rows);
+
+    C45ModelSelection *modSelection = newModelSelection(allData);
+    mRoot = newTree(modSelection);
+    C45PruneableClassifierTree *root = dynamic_cast<C45PruneableClassifierTree*>(mRoot);
+    if (root == nullptr)
+    {
+        // reduced-error pruning stratifies and copies its folds anyway
+        delete sorted;
+        mRoot->buildClassifier(allData);
+    }
+    else
+    {
+        // given orders are only those of exact splits
+        if (sorted != nullptr && (mNumBins > 0 || !mPresort))
+        {
+            delete sorted;
+            sorted = nullptr;
+        }
+        if (sorted == nullptr)
+        {
+            sorted = SortedInstances::forTree(train, mPresort, mNumBins, mCountTables);
+        }
+        else if (mCountTables)
+        {
+            sorted->addCounts(train);
+        }
+        root->buildClassifier(train, sorted);
+    }
+    modSelection->cleanup();
+    compile(train.dataset());
+}
+
+void C48::buildClassifier(const ColumnStore &columns, Instances &header)
+{
+
+    // reduced-error pruning stratifies and copies its folds
+    if (mReducedErrorPruning)
+    {
+        throw "Reduced-error pruning needs the training data in memory!";
+    }
+    C45ModelSelection *modSelection = newModelSelection(header);
+    modSelection->setNumInstances(columns.numRows());
+    int numBins = (mNumBins > 0) ? mNumBins : OUT_OF_CORE_BINS;
+    C45PruneableClassifierTree *root = new C45PruneableClassifierTree(modSelection, !mUnpruned, mCF, false, true, mCollapseTree, false, numBins, false);
+    mRoot = root;
+    LevelWiseBuilder builder(columns, header, *modSelection, numBins, mThreadPool);
+    root->buildClassifier(builder, header);
+    modSelection->cleanup();
+    compile(header);
+}
+
+C45ModelSelection *C48::newModelSelection(Instances &allData)
+{
+
+    int numThreads = (mNumThreads < 1) ? ThreadPool::hardwareThreads() : mNumThreads;
+    if (mThreadPool != nullptr && mThreadPool->numThreads() != numThreads)
+    {
+        delete mThreadPool;
+        mThreadPool = nullptr;
+    }
+    if (mThreadPool == nullptr && numThreads > 1)
+    {
+        mThreadPool = new ThreadPool(numThreads);
+    }
+
+    // the previous tree goes with all it kept
+    if (mRoot != nullptr)
+        delete mRoot;
+    mRoot = nullptr;
+
+    return new C45ModelSelection(mMinNumObj, allData, mUseMDLcorrection, mDoNotMakeSplitPointActualValue, mThreadPool);
+}
+
+ClassifierTree *C48::newTree(C45ModelSelection *modSelection)
+{
 
     if (!mReducedErrorPruning) 
     {
 		//mRoot = std::make_unique<C45PruneableClassifierTree>(modSelection, !mUnpruned, mCF, mSubtreeRaising, !mNoCleanup, mCollapseTree);
-		mRoot = new C45PruneableClassifierTree(modSelection, !mUnpruned, mCF, mSubtreeRaising, !mNoCleanup, mCollapseTree);
+		return new C45PruneableClassifierTree(modSelection, !mUnpruned, mCF, mSubtreeRaising, !mNoCleanup, mCollapseTree, mPresort, mNumBins, mCountTables);
+    }
+    else
+    {
+        return new PruneableClassifierTree(modSelection, true, mNumFolds, !mNoCleanup, mPresort, mNumBins, mCountTables);
     }
+}
 
-    mRoot->buildClassifier(instances);
+void C48::compile(Instances &header)
+{
+    if (mHeader != nullptr)
+        delete mHeader;
+    mHeader = new Instances(&header, 0);
+    if (mCompiledTree != nullptr)
+        delete mCompiledTree;
+    mCompiledTree = new CompiledTree(*mRoot, *mHeader);
+}
+
+C48 *C48::makeCopy() const
+{
+    C48 *copy = new C48();
+    copy->mUnpruned = mUnpruned;
+    copy->mCollapseTree = mCollapseTree;
+    copy->mCF = mCF;
+    copy->mMinNumObj = mMinNumObj;
+    copy->mUseMDLcorrection = mUseMDLcorrection;
+    copy->mUseLaplace = mUseLaplace;
+    copy->mReducedErrorPruning = mReducedErrorPruning;
+    copy->mNumFolds = mNumFolds;
+    copy->mSubtreeRaising = mSubtreeRaising;
+    copy->mNoCleanup = mNoCleanup;
+    copy->mDoNotMakeSplitPointActualValue = mDoNotMakeSplitPointActualValue;
+    copy->mPresort = mPresort;
+    copy->mNumBins = mNumBins;
+    copy->mCountTables = mCountTables;
+    copy->mNumThreads = mNumThreads;
+    return copy;
+}
+
+void C48::prepareFolds(const InstancesView &data)
+{
+    finishFolds();
+    if (mPresort && mNumBins == 0)
+    {
+        mFoldOrders = new SortedInstances(data);
+    }
+}
+
+Classifier *C48::buildFold(const InstancesView &train, const int_array &rows) const
+{
+    C48 *foldClassifier = makeCopy();
+    try
+    {
+        foldClassifier->setNumThreads(1);
+        foldClassifier->buildClassifier(train, (mFoldOrders != nullptr) ? mFoldOrders->subset(rows) : nullptr);
+    }
+    catch (...)
+    {
+        delete foldClassifier;
+        throw;
+    }
+    return foldClassifier;
+}
+
+void C48::finishFolds()
+{
+    if (mFoldOrders != nullptr)
+        delete mFoldOrders;
+    mFoldOrders = nullptr;
 }
 
 bool C48::setParameters(const int argc, char **inParameters)
@@ -57,6 +238,10 @@ bool C48::setParameters(const int argc, char **inParameters)
                 i++;
                 continue;
             }
+            else if (strcmp(inParameters[i], "-x") == 0) {
+                i++;
+                continue;
+            }
             else if (strcmp(inParameters[i], "-C") == 0) {
                 if (i + 1 < argc && inParameters[i + 1][0] != '-')
                     mCF = (float) atof(inParameters[++i]);
@@ -65,7 +250,37 @@ bool C48::setParameters(const int argc, char **inParameters)
             }
             else if (strcmp(inParameters[i], "-N") == 0) {
                 if (i + 1 < argc && inParameters[i + 1][0] != '-')
-                    mNumFolds = atoi(inParameters[++i]);
+                {
+                    int numFolds = atoi(inParameters[++i]);
+                    if (numFolds < 2)
+                        isOkay = false;
+                    else
+                        mNumFolds = numFolds;
+                }
+                else
+                    isOkay = false;
+            }
+            else if (strcmp(inParameters[i], "-threads") == 0) {
+                if (i + 1 < argc && inParameters[i + 1][0] != '-')
+                    mNumThreads = atoi(inParameters[++i]);
+                else
+                    isOkay = false;
+            }
+            else if (strcmp(inParameters[i], "-counts") == 0) {
+                mCountTables = true;
+            }
+            else if (strcmp(inParameters[i], "-float") == 0 || strcmp(inParameters[i], "-compare") == 0) {
+                ;
+            }
+            else if (strcmp(inParameters[i], "-B") == 0) {
+                if (i + 1 < argc && inParameters[i + 1][0] != '-')
+                {
+                    int numBins = atoi(inParameters[++i]);
+                    if (numBins < 0 || numBins == 1 || numBins > SortedInstances::MAX_BINS)
+                        isOkay = false;
+                    else
+                        mNumBins = numBins;
+                }
                 else
                     isOkay = false;
             }
@@ -94,7 +309,7 @@ bool C48::setParameters(const int argc, char **inParameters)
                     else if (inParameters[i][j] == 'U') {
                         mUnpruned = true;
                     }
-                    else if (inParameters[i][j] == 'D') {
+                    else if (inParameters[i][j] == 'D' || inParameters[i][j] == 'O') {
                        ;
                     }
                     else
@@ -113,12 +328,194 @@ bool C48::setParameters(const int argc, char **inParameters)
 
 double C48::classifyInstance(Instance &instance) const
 {
-    return mRoot->classifyInstance(instance);
+    return mCompiledTree->classifyInstance(instance);
 }
 
 double_array C48::distributionForInstance(Instance &instance) const
 {
-	return mRoot->distributionForInstance(instance, mUseLaplace);
+	return mCompiledTree->distributionForInstance(instance, mUseLaplace);
+}
+
+bool C48::implementsMoreEfficientBatchPrediction() const
+{
+    return true;
+}
+
+double_2D_array C48::distributionsForInstances(Instances &batch) const
+{
+    int numClasses = mCompiledTree->numClasses();
+    double_array matrix((size_t)batch.numInstances() * numClasses);
+    distributionsForInstances(batch, matrix.data());
+
+    double_2D_array batchPreds(batch.numInstances());
+    for (int i = 0; i < batch.numInstances(); i++) {
+        batchPreds[i].assign(matrix.begin() + (size_t)i * numClasses, matrix.begin() + (size_t)(i + 1) * numClasses);
+    }
+    return batchPreds;
+}
+
+void C48::distributionsForInstances(Instances &batch, double *dist) const
+{
+    mCompiledTree->distributionsForInstances(batch, mUseLaplace, dist);
+}
+
+void C48::save(std::ostream &os) const
+{
+    if (mRoot == nullptr)
+    {
+        throw "No classifier built";
+    }
+
+    BinaryWriter writer;
+    writer.writeInt(MODEL_MAGIC);
+    writer.writeInt(MODEL_VERSION);
+
+    writer.writeBool(mUnpruned);
+    writer.writeBool(mCollapseTree);
+    writer.writeFloat(mCF);
+    writer.writeInt(mMinNumObj);
+    writer.writeBool(mUseMDLcorrection);
+    writer.writeBool(mUseLaplace);
+    writer.writeBool(mReducedErrorPruning);
+    writer.writeInt(mNumFolds);
+    writer.writeBool(mSubtreeRaising);
+    writer.writeBool(mNoCleanup);
+    writer.writeBool(mDoNotMakeSplitPointActualValue);
+    writer.writeBool(mPresort);
+    writer.writeInt(dynamic_cast<C45PruneableClassifierTree*>(mRoot) != nullptr ? C45_TREE : REDUCED_ERROR_TREE);
+
+    mHeader->serializeHeader(writer);
+    mRoot->serialize(writer);
+    writer.writeTo(os);
+}
+
+void C48::load(std::istream &is)
+{
+    BinaryReader reader(is);
+    if (reader.readInt() != MODEL_MAGIC)
+    {
+        throw string("Not a C48 model");
+    }
+    int version = reader.readInt();
+    if (version != MODEL_VERSION)
+    {
+        throw string("Unsupported C48 model version: ") + std::to_string(version);
+    }
+
+    mUnpruned = reader.readBool();
+    mCollapseTree = reader.readBool();
+    mCF = reader.readFloat();
+    mMinNumObj = reader.readInt();
+    mUseMDLcorrection = reader.readBool();
+    mUseLaplace = reader.readBool();
+    mReducedErrorPruning = reader.readBool();
+    mNumFolds = reader.readInt();
+    mSubtreeRaising = reader.readBool();
+    mNoCleanup = reader.readBool();
+    mDoNotMakeSplitPointActualValue = reader.readBool();
+    mPresort = reader.readBool();
+    int treeType = reader.readInt();
+    if (treeType != C45_TREE && treeType != REDUCED_ERROR_TREE)
+    {
+        throw string("Unknown tree type: ") + std::to_string(treeType);
+    }
+
+    Instances *header = Instances::deserializeHeader(reader);
+    if (header->classIndex() < 0 || !header->classAttribute().isNominal())
+    {
+        delete header;
+        throw string("Invalid class attribute in C48 model");
+    }
+    ModelSelection *modSelection = new C45ModelSelection(mMinNumObj, *header, mUseMDLcorrection, mDoNotMakeSplitPointActualValue, nullptr);
+    ClassifierTree *root;
+    if (treeType == C45_TREE)
+    {
+        root = new C45PruneableClassifierTree(modSelection, !mUnpruned, mCF, mSubtreeRaising, !mNoCleanup, mCollapseTree, mPresort, mNumBins, mCountTables);
+    }
+    else
+    {
+        root = new PruneableClassifierTree(modSelection, true, mNumFolds, !mNoCleanup, mPresort, mNumBins, mCountTables);
+    }
+    try
+    {
+        root->deserialize(reader, *header);
+    }
+    catch (...)
+    {
+        delete root;
+        delete header;
+        throw;
+    }
+    root->cleanup(*header);
+
+    if (mRoot != nullptr)
+        delete mRoot;
+    mRoot = root;
+    if (mHeader != nullptr)
+        delete mHeader;
+    mHeader = header;
+    if (mCompiledTree != nullptr)
+        delete mCompiledTree;
+    mCompiledTree = new CompiledTree(*mRoot, *mHeader);
+}
+
+void C48::saveCompiled(std::ostream &os) const
+{
+    if (mCompiledTree == nullptr)
+    {
+        throw "No classifier built";
+    }
+
+    BinaryWriter writer;
+    writer.writeBool(mUseLaplace);
+    mHeader->serializeHeader(writer);
+    mCompiledTree->save(os, writer.buffer());
+}
+
+void C48::mapCompiled(const string &path)
+{
+    CompiledTree *compiledTree = CompiledTree::map(path);
+    Instances *header = nullptr;
+    bool useLaplace;
+    try
+    {
+        BinaryReader reader(compiledTree->metadata(), compiledTree->metadataSize());
+        useLaplace = reader.readBool();
+        header = Instances::deserializeHeader(reader);
+        if (header->numAttributes() != compiledTree->numAttributes() || header->classIndex() != compiledTree->classIndex()
+            || header->numClasses() != compiledTree->numClasses())
+        {
+            throw string("The header does not match the compiled tree");
+        }
+    }
+    catch (...)
+    {
+        if (header != nullptr)
+            delete header;
+        delete compiledTree;
+        throw;
+    }
+
+    mUseLaplace = useLaplace;
+    if (mRoot != nullptr)
+        delete mRoot;
+    mRoot = nullptr;
+    if (mHeader != nullptr)
+        delete mHeader;
+    mHeader = header;
+    if (mCompiledTree != nullptr)
+        delete mCompiledTree;
+    mCompiledTree = compiledTree;
+}
+
+const Instances *C48::header() const
+{
+    return mHeader;
+}
+
+const CompiledTree *C48::compiledTree() const
+{
+    return mCompiledTree;
 }
 
 bool C48::getUseLaplace() const
@@ -167,6 +564,11 @@ double C48::measureTreeSize() const
 	return mRoot->numNodes();
 }
 
+size_t C48::arenaSize() const
+{
+	return (mRoot == nullptr) ? 0 : mRoot->arenaSize();
+}
+
 double C48::measureNumLeaves() const
 {
 	return mRoot->numLeaves();
@@ -177,6 +579,16 @@ double C48::measureNumRules() const
 	return mRoot->numLeaves();
 }
 
+std::vector<C45PruneableClassifierTree::PruningResult> C48::sweepConfidenceFactors(const std::vector<float> &cfs) const
+{
+    C45PruneableClassifierTree *root = dynamic_cast<C45PruneableClassifierTree*>(mRoot);
+    if (root == nullptr)
+    {
+        throw "No C4.5 tree built";
+    }
+    return root->sweepConfidenceFactors(cfs);
+}
+
 bool C48::getUnpruned() const
 {
     return mUnpruned;
@@ -242,6 +654,10 @@ int C48::getNumFolds() const
 
 void C48::setNumFolds(int v)
 {
+    if (v < 2)
+    {
+        throw string("Number of folds must be greater than 1: ") + std::to_string(v);
+    }
     mNumFolds = v;
 }
 
@@ -275,6 +691,50 @@ void C48::setDoNotMakeSplitPointActualValue(bool mDoNotMakeSplitPointActualValue
     this->mDoNotMakeSplitPointActualValue = mDoNotMakeSplitPointActualValue;
 }
 
+bool C48::getPresort() const
+{
+    return mPresort;
+}
+
+void C48::setPresort(bool v)
+{
+    mPresort = v;
+}
+
+int C48::getNumBins() const
+{
+    return mNumBins;
+}
+
+void C48::setNumBins(int v)
+{
+    if (v < 0 || v == 1 || v > SortedInstances::MAX_BINS)
+    {
+        throw string("Invalid number of bins: ") + std::to_string(v);
+    }
+    mNumBins = v;
+}
+
+bool C48::getCountTables() const
+{
+    return mCountTables;
+}
+
+void C48::setCountTables(bool v)
+{
+    mCountTables = v;
+}
+
+int C48::getNumThreads() const
+{
+    return mNumThreads;
+}
+
+void C48::setNumThreads(int v)
+{
+    mNumThreads = v;
+}
+
 void C48::generatePartition(Instances &data)
 {
     buildClassifier(data);
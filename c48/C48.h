@@ -2,6 +2,7 @@
 #define _C48_
 
 #include "AbstractClassifier.h"
+#include "evaluation/FoldLearner.h"
 #include "C45PruneableClassifierTree.h"
 #include "ClassifierTree.h"
 #include "core/Instance.h"
@@ -14,6 +15,11 @@
 class ClassifierTree;
 class ModelSelection;
 class C45ModelSelection;
+class ThreadPool;
+class CompiledTree;
+class InstancesView;
+class SortedInstances;
+class ColumnStore;
 
 /**
  * Class for generating a pruned or unpruned C4.5 decision tree. For more information, see
@@ -21,7 +27,7 @@ class C45ModelSelection;
  * Ross Quinlan (1993). C4.5: Programs for Machine Learning. Morgan Kaufmann Publishers, San Mateo, CA.
  *
  */
-class C48 : public AbstractClassifier
+class C48 : public AbstractClassifier, public FoldLearner
 {
 
 protected:
@@ -63,6 +69,70 @@ protected:
     /** Do not relocate split point to actual data value */
     bool mDoNotMakeSplitPointActualValue;
 
+    /** Sort numeric attributes once instead of at every node */
+    bool mPresort;
+
+    /** The number of quantile bins for approximate numeric splits, 0 for exact splits */
+    int mNumBins;
+
+    /** Keep class counts per nominal value at every node */
+    bool mCountTables;
+
+    /** The number of threads to build the tree with */
+    int mNumThreads;
+
+    /** The pool the tree is built on, null when building on one thread */
+    ThreadPool *mThreadPool;
+
+    /** The flattened copy of the tree that predictions are made with */
+    CompiledTree *mCompiledTree;
+
+    /** The header information of the training data */
+    Instances *mHeader;
+
+    /** The sorted orders of the rows of all folds of a cross-validation, null if not presorted */
+    SortedInstances *mFoldOrders;
+
+    /** Identifies a saved model; also tells apart files of the other byte order */
+    static const int MODEL_MAGIC = 0x4D383443;
+
+    /** The number of quantile bins of a tree grown out of core if none is set */
+    static const int OUT_OF_CORE_BINS = 256;
+
+    /** The version of the saved model format */
+    static const int MODEL_VERSION = 1;
+
+    /** Tags identifying the type of a saved tree. */
+    enum TreeType {
+        C45_TREE = 0,
+        REDUCED_ERROR_TREE
+    };
+
+    /**
+     * Drops the tree and creates the model selection method for the next
+     * one, with the thread pool it is to be built on.
+     *
+     * @param allData the training data
+     * @return the model selection method
+     */
+    C45ModelSelection *newModelSelection(Instances &allData);
+
+    /**
+     * Creates a new tree that has not been built.
+     *
+     * @param modSelection the model selection method, owned by the tree
+     * @return the new tree
+     */
+    ClassifierTree *newTree(C45ModelSelection *modSelection);
+
+    /**
+     * Compiles the built tree for prediction, keeping the header of the
+     * training data.
+     *
+     * @param header the training data
+     */
+    void compile(Instances &header);
+
 public:
 
     /**
@@ -73,7 +143,7 @@ public:
     /**
     * Destructor
     */
-    ~C48();
+    virtual ~C48();
 
     /**
      * Generates the classifier.
@@ -83,6 +153,65 @@ public:
      */
     virtual void buildClassifier(Instances &instances);
 
+    /**
+     * Generates the classifier from rows of a dataset, without copying
+     * them. Unlike buildClassifier(Instances&), the rows must all have a
+     * class value.
+     *
+     * @param train the rows to train the classifier with
+     * @param sorted the sorted orders of the numeric attributes of the rows,
+     *          taken over by the classifier, or null to sort them here; they
+     *          are only used for exact splits with presorting
+     * @throws Exception if classifier can't be built successfully
+     */
+    void buildClassifier(const InstancesView &train, SortedInstances *sorted);
+
+    /**
+     * Generates the classifier level by level from training data held out
+     * of core, e.g. in a column store mapped from the cache file, without
+     * creating an instance per row. Numeric attributes are split between
+     * quantile bins, OUT_OF_CORE_BINS of them unless a number is set, and
+     * the tree is built without subtree raising.
+     *
+     * @param columns the columns of the training data
+     * @param header the header of the training data
+     * @throws Exception if classifier can't be built successfully, or if
+     *          reduced-error pruning is set
+     */
+    void buildClassifier(const ColumnStore &columns, Instances &header);
+
+    /**
+     * Creates a classifier with the same options that has not been built.
+     *
+     * @return the new classifier
+     */
+    C48 *makeCopy() const;
+
+    /**
+     * Sorts the numeric attributes of the rows of all folds once, if the
+     * folds are to be built with exact splits on presorted orders.
+     *
+     * @param data the rows of all folds
+     */
+    virtual void prepareFolds(const InstancesView &data);
+
+    /**
+     * Builds a copy of the classifier with the same options on a single
+     * thread, on the training rows of a fold. The sorted orders of the rows
+     * are filtered out of those prepareFolds() computed.
+     *
+     * @param train the training rows of the fold
+     * @param rows the row each row given to prepareFolds() has in train, -1
+     *          for the rows left out
+     * @return the built classifier, owned by the caller
+     */
+    virtual Classifier *buildFold(const InstancesView &train, const int_array &rows) const;
+
+    /**
+     * Drops the sorted orders prepareFolds() computed.
+     */
+    virtual void finishFolds();
+
     /**
      * Classifies an instance.
      *
@@ -101,6 +230,40 @@ public:
      */
     double_array distributionForInstance(Instance &instance) const;
 
+    /**
+     * Returns true, as the instances of a batch are routed through the tree
+     * together.
+     *
+     * @return true
+     */
+    virtual bool implementsMoreEfficientBatchPrediction() const;
+
+    /**
+     * Returns class probabilities for all instances of a batch.
+     *
+     * @param batch the instances to get predictions for
+     * @return an array of probability distributions, one for each instance in the
+     *         batch
+     */
+    virtual double_2D_array distributionsForInstances(Instances &batch) const;
+
+    /**
+     * Writes the class probabilities for all instances of a batch into a
+     * matrix, avoiding an array per instance.
+     *
+     * @param batch the instances to get predictions for
+     * @param dist the row-major matrix of batch.numInstances() x
+     *          batch.numClasses() values the distributions are written to
+     */
+    virtual void distributionsForInstances(Instances &batch, double *dist) const;
+
+    /**
+     * Returns the flattened copy of the tree that predictions are made with.
+     *
+     * @return the compiled tree, null if the classifier has not been built
+     */
+    virtual const CompiledTree *compiledTree() const;
+
     /**
      * Get the value of useLaplace.
      *
@@ -165,6 +328,25 @@ public:
      */
     virtual double measureNumRules() const;
 
+    /**
+     * Returns the number of objects the arena of the tree holds
+     *
+     * @return the number of objects, 0 once the tree has been cleaned up
+     */
+    size_t arenaSize() const;
+
+    /**
+     * Returns the size and the estimated errors of the tree pruned with each
+     * of the given confidence factors, without building it again. The tree
+     * should have been built unpruned; pruning follows
+     * C45PruneableClassifierTree::sweepConfidenceFactors().
+     *
+     * @param cfs the confidence factors
+     * @return the results, in the order of the confidence factors
+     * @throws Exception if no C4.5 tree has been built
+     */
+    std::vector<C45PruneableClassifierTree::PruningResult> sweepConfidenceFactors(const std::vector<float> &cfs) const;
+
     /**
      * Get the value of unpruned.
      *
@@ -243,9 +425,10 @@ public:
     virtual int getNumFolds() const;
 
     /**
-     * Set the value of numFolds.
+     * Set the value of numFolds, the number of folds for reduced-error
+     * pruning.
      *
-     * @param v Value to assign to numFolds.
+     * @param v Value to assign to numFolds, at least 2.
      */
     virtual void setNumFolds(int v);
 
@@ -291,6 +474,76 @@ public:
      */
     virtual void setDoNotMakeSplitPointActualValue(bool mdoNotMakeSplitPointActualValue);
 
+    /**
+     * Gets whether numeric attributes are sorted only once for the whole tree.
+     *
+     * @return true if the numeric attributes are presorted
+     */
+    virtual bool getPresort() const;
+
+    /**
+     * Sets whether numeric attributes are sorted only once for the whole
+     * tree. The presorted orders are partitioned down the tree instead of
+     * sorting the data at every node; the resulting tree is the same.
+     *
+     * @param v true if the numeric attributes are to be presorted
+     */
+    virtual void setPresort(bool v);
+
+    /**
+     * Gets the number of bins numeric attributes are cut into.
+     *
+     * @return the number of bins, 0 if splits are exact
+     */
+    virtual int getNumBins() const;
+
+    /**
+     * Sets the number of bins numeric attributes are cut into. With bins,
+     * the values of each numeric attribute are cut once into quantile bins
+     * and split points are only sought between bins, which scans the bins
+     * instead of the instances at every node. The tree is an approximation
+     * of the exact one, and equal to it if no attribute has more distinct
+     * values than bins.
+     *
+     * @param v the number of bins, at least 2 and at most
+     *          SortedInstances::MAX_BINS; 0 for exact splits (the default)
+     */
+    virtual void setNumBins(int v);
+
+    /**
+     * Gets whether every node keeps its class counts per nominal value.
+     *
+     * @return true if the counts are kept
+     */
+    virtual bool getCountTables() const;
+
+    /**
+     * Sets whether every node keeps its class counts per nominal value and
+     * its class distribution. A node then counts only the rows of its
+     * smaller sons; the counts of the largest son are the parent's minus
+     * those of its siblings. The tree is the one built without the tables,
+     * up to the rounding of the subtracted weights.
+     *
+     * @param v true if the counts are to be kept
+     */
+    virtual void setCountTables(bool v);
+
+    /**
+     * Gets the number of threads the tree is built with.
+     *
+     * @return the number of threads
+     */
+    virtual int getNumThreads() const;
+
+    /**
+     * Sets the number of threads the tree is built with. The attributes at a
+     * node are evaluated concurrently; the resulting tree is the same as the
+     * one built on a single thread.
+     *
+     * @param v the number of threads, 0 for the number of hardware threads
+     */
+    virtual void setNumThreads(int v);
+
     /**
      * Builds the classifier to generate a partition.
      */
@@ -307,12 +560,66 @@ public:
     virtual int numElements() const;
 
     bool setParameters(const int, char **inParameters);
+
+    /**
+     * Saves the built classifier in a versioned binary format: the options,
+     * the type of the tree, the header information of the training data and
+     * the tree with all its split models and distributions.
+     *
+     * @param os the stream to write to
+     * @throws Exception if no classifier has been built
+     */
+    virtual void save(std::ostream &os) const;
+
+    /**
+     * Loads a classifier saved by save(), replacing the current one. The
+     * loaded classifier makes the same predictions without the training data.
+     *
+     * @param is the stream to read from
+     * @throws Exception if the data is not a valid model
+     */
+    virtual void load(std::istream &is);
+
+    /**
+     * Saves the compiled tree of the built classifier in a layout that
+     * mapCompiled() uses in place, together with the header information of
+     * the training data and the Laplace option.
+     *
+     * @param os the stream to write to, opened in binary mode
+     * @throws Exception if no classifier has been built
+     */
+    virtual void saveCompiled(std::ostream &os) const;
+
+    /**
+     * Maps a file written by saveCompiled() read-only, replacing the current
+     * classifier. Predictions are made directly on the mapping, whose pages
+     * are shared with all other processes mapping the same file. Only the
+     * compiled tree is available: the classifier cannot describe the tree
+     * or be saved with save().
+     *
+     * @param path the file to map
+     * @throws Exception if the file cannot be mapped or is not a valid
+     *           compiled tree
+     */
+    virtual void mapCompiled(const string &path);
+
+    /**
+     * Returns the header information of the data the classifier was built from.
+     *
+     * @return the header, null if no classifier has been built
+     */
+    virtual const Instances *header() const;
+
 	friend std::ostream & operator << (std::ostream &os, const C48 &c48)
 	{
-		c48.mRoot->serialize(os);
-		return os << '\0' << c48.mUnpruned << '\0' << c48.mCollapseTree << '\0' << c48.mCF << '\0' << c48.mMinNumObj << '\0'
-			<< c48.mUseMDLcorrection << '\0' << c48.mUseLaplace << '\0' << c48.mReducedErrorPruning << '\0'
-			<< c48.mNumFolds << '\0' << c48.mSubtreeRaising << '\0' << c48.mNoCleanup << '\0' << c48.mDoNotMakeSplitPointActualValue << '\0';
+		c48.save(os);
+		return os;
+	}
+
+	friend std::istream & operator >> (std::istream &is, C48 &c48)
+	{
+		c48.load(is);
+		return is;
 	}
 };
 
@@ -14,6 +14,11 @@
 class Classifier {
 
 public:
+    /**
+     * Destructor
+     */
+    virtual ~Classifier() {}
+
     /**
      * Generates a classifier. Must initialize all fields of the classifier
      * that are not being set via options (i.e. multiple calls of buildClassifier
@@ -1,8 +1,13 @@
 #include "ClassifierSplitModel.h"
 #include "Distribution.h"
+#include "NoSplit.h"
+#include "C45Split.h"
+#include "core/BinaryReader.h"
 #include "core/Instances.h"
+#include "core/InstancesView.h"
 #include "core/Instance.h"
 #include "core/Utils.h"
+#include "core/Arena.h"
 
 
 /*void *ClassifierSplitModel::clone()
@@ -11,6 +16,33 @@
 return new ClassifierSplitModel();
 }*/
 
+std::atomic<long> ClassifierSplitModel::NUM_LIVE(0);
+
+void *ClassifierSplitModel::operator new(size_t size) {
+
+    void *p = ::operator new(size);
+    NUM_LIVE++;
+    return p;
+}
+
+void ClassifierSplitModel::operator delete(void *p) {
+
+    if (p == nullptr)
+        return;
+    NUM_LIVE--;
+    ::operator delete(p);
+}
+
+long ClassifierSplitModel::numLive() {
+
+    return NUM_LIVE;
+}
+
+ClassifierSplitModel::~ClassifierSplitModel()
+{
+    delete mDistribution;
+}
+
 bool ClassifierSplitModel::checkModel() const
 {
 
@@ -133,25 +165,81 @@ int ClassifierSplitModel::numSubsets() const
 
 void ClassifierSplitModel::resetDistribution(Instances &data)
 {
-    mDistribution = new Distribution(data, *this);
+    Distribution *newDistribution = new Distribution(data, *this);
+    delete mDistribution;
+    mDistribution = newDistribution;
 }
 
-std::vector<Instances*> ClassifierSplitModel::split(Instances &data) const
+void ClassifierSplitModel::resetDistribution(const InstancesView &data)
 {
+    Distribution *newDistribution = new Distribution(data, *this);
+    delete mDistribution;
+    mDistribution = newDistribution;
+}
+
+std::vector<Instances*> ClassifierSplitModel::split(Instances &data, Arena &arena) const
+{
+    // Collect the instances of the subsets. The instances are not added to
+    // the subsets one by one, as that would make them refer to the subset
+    // instead of to the given set, which may live longer.
+    std::vector<std::vector<Instance*>> subsets(mNumSubsets);
+    std::vector<std::vector<Instance*>> copies(mNumSubsets);
+    auto totalInst = data.numInstances();
+    for (auto i = 0; i < totalInst; i++)
+    {
+        Instance &instance = data.instance(i);
+        int subset = whichSubset(instance);
+        if (subset > -1)
+        {
+            subsets[subset].push_back(&instance);
+        }
+        else
+        {
+            double_array _weights = weights(instance);
+            for (int j = 0; j < mNumSubsets; j++)
+            {
+                if (Utils::gr(_weights[j], 0))
+                {
+                    // the instance is shared with the other subsets, so
+                    // each one gets its own copy with its own weight
+                    Instance *copy = arena.add(new Instance(&instance));
+                    copy->setWeight(_weights[j] * instance.weight());
+                    subsets[j].push_back(copy);
+                    copies[j].push_back(copy);
+                }
+            }
+        }
+    }
+
     // Create subsets
     std::vector<Instances*> instances(mNumSubsets);
     for (int j = 0; j < mNumSubsets; j++)
     {
-        instances[j] = new Instances(&data, 0);
+        instances[j] = arena.add(new Instances(&data, subsets[j]));
+        for (Instance *copy : copies[j])
+        {
+            copy->setDataset(instances[j]);
+        }
     }
-    auto totalInst = data.numInstances();
-    for (auto i = 0; i < totalInst; i++)
+    return instances;
+}
+
+std::vector<InstancesView*> ClassifierSplitModel::split(const InstancesView &data) const
+{
+    // Create subsets
+    std::vector<InstancesView*> views(mNumSubsets);
+    for (int j = 0; j < mNumSubsets; j++)
+    {
+        views[j] = new InstancesView(data, 0);
+    }
+    int totalInst = data.numInstances();
+    for (int i = 0; i < totalInst; i++)
     {
         Instance &instance = data.instance(i);
         int subset = whichSubset(instance);
         if (subset > -1)
         {
-            instances[subset]->add(instance);
+            views[subset]->add(data.index(i), data.weight(i));
         }
         else
         {
@@ -160,13 +248,12 @@ std::vector<Instances*> ClassifierSplitModel::split(Instances &data) const
             {
                 if (Utils::gr(_weights[j], 0))
                 {
-                    instances[j]->add(instance);
-                    instances[j]->lastInstance().setWeight(_weights[j] * instance.weight());
+                    views[j]->add(data.index(i), _weights[j] * data.weight(i));
                 }
             }
         }
     }
-    return instances;
+    return views;
 }
 
 Distribution* ClassifierSplitModel::getDistribution() const
@@ -178,3 +265,17 @@ void ClassifierSplitModel::setDistribution(Distribution* dist)
 {
     mDistribution = dist;
 }
+
+ClassifierSplitModel *ClassifierSplitModel::deserialize(BinaryReader &reader, const Instances &header)
+{
+    int type = reader.readInt();
+    switch (type)
+    {
+    case NO_SPLIT:
+        return NoSplit::deserialize(reader, header);
+    case C45_SPLIT:
+        return C45Split::deserialize(reader, header);
+    default:
+        throw string("Unknown split model type: ") + std::to_string(type);
+    }
+}
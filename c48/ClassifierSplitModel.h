@@ -6,8 +6,14 @@
 #include <string>
 #include <vector>
 #include <stdexcept>
+#include <atomic>
+#include <cstddef>
 
 class Distribution;
+class InstancesView;
+class Arena;
+class BinaryWriter;
+class BinaryReader;
 
 /**
  * Abstract class for classification models that can be used recursively to split the data.
@@ -17,14 +23,43 @@ class ClassifierSplitModel
 
 protected:
 
-    /** Distribution of class values. */
-    Distribution *mDistribution;
+    /** Distribution of class values, owned by the model. */
+    Distribution *mDistribution = nullptr;
 
     /** Number of created subsets. */
     int mNumSubsets = 0;
 
+    /** Tags identifying the type of a written split model. */
+    enum ModelType {
+        NO_SPLIT = 0,
+        C45_SPLIT
+    };
+
+    /** The number of split models currently allocated on the heap. */
+    static std::atomic<long> NUM_LIVE;
+
 public:
 
+    /**
+     * Allocates a split model on the heap, counting it as live.
+     */
+    static void *operator new(size_t size);
+
+    /**
+     * Frees a split model allocated on the heap.
+     */
+    static void operator delete(void *p);
+
+    /**
+     * Returns the number of split models currently allocated on the heap.
+     */
+    static long numLive();
+
+    /**
+     * Deletes the model and its distribution.
+     */
+    virtual ~ClassifierSplitModel();
+
     /**
      * Builds the classifier split model for the given set of instances.
      *
@@ -96,16 +131,37 @@ public:
     int numSubsets() const;
 
     /**
-     * Returns the number of created subsets for the split.
+     * Replaces the distribution by the one of the given data, deleting the
+     * current one.
      */
     virtual void resetDistribution(Instances &data);
 
     /**
-     * Splits the given set of instances into subsets.
+     * Replaces the distribution by the one of the given rows, deleting the
+     * current one.
      *
+     * @param data the rows
+     */
+    virtual void resetDistribution(const InstancesView &data);
+
+    /**
+     * Splits the given set of instances into subsets. The subsets share the
+     * instances of the given set, except for the copies made of instances
+     * assigned to more than one subset; the subsets and the copies are owned
+     * by the arena.
+     *
+     * @param data the set to split
+     * @param arena the arena taking the new objects
      * @exception Exception if something goes wrong
      */
-    std::vector<Instances*> split(Instances &data) const;
+    std::vector<Instances*> split(Instances &data, Arena &arena) const;
+
+    /**
+     * Splits the given view into views on the same dataset. Rows assigned
+     * to more than one subset get the fraction of their weight given by
+     * weights(); the base instances are left untouched.
+     */
+    std::vector<InstancesView*> split(const InstancesView &data) const;
 
     /**
      * Returns weights if instance is assigned to more than one subset.
@@ -127,9 +183,28 @@ public:
     Distribution* getDistribution() const;
 
     /**
-    * Set the distribution object
+    * Set the distribution object. The model takes ownership of the new
+    * distribution; the current one is not deleted.
     */
     void setDistribution(Distribution* dist);
+
+    /**
+     * Writes the model, starting with a tag identifying its type.
+     *
+     * @param writer the writer
+     */
+    virtual void serialize(BinaryWriter &writer) const = 0;
+
+    /**
+     * Reads a model written by serialize(), of the type given by its tag,
+     * and checks it against the header of the data it was built on.
+     *
+     * @param reader the reader
+     * @param header the header of the training data
+     * @return the model
+     * @exception Exception if the data is invalid
+     */
+    static ClassifierSplitModel *deserialize(BinaryReader &reader, const Instances &header);
 };
 
 #endif    // _CLASSIFIERSPLITMODEL_
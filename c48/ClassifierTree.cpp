@@ -2,9 +2,16 @@
 #include "ModelSelection.h"
 #include "ClassifierSplitModel.h"
 #include "core/Instances.h"
+#include "core/InstancesView.h"
 #include "Distribution.h"
 #include "core/Instance.h"
 #include "core/Utils.h"
+#include "SortedInstances.h"
+#include "core/ThreadPool.h"
+#include "core/BinaryWriter.h"
+#include "core/BinaryReader.h"
+#include "core/Arena.h"
+#include "NoSplit.h"
 
 long long ClassifierTree::PRINTED_NODES = 0;
 
@@ -21,49 +28,135 @@ void ClassifierTree::resetID() {
 ClassifierTree::ClassifierTree(ModelSelection *toSelectLocModel) {
 
     mToSelectModel = toSelectLocModel;
+    mLocalModel = nullptr;
+    mTrain = nullptr;
+    mTest = nullptr;
+    mArena = nullptr;
+    mHeader = nullptr;
+    mIsRoot = true;
+    mIsLeaf = false;
+    mIsEmpty = false;
 
 }
 
 ClassifierTree::~ClassifierTree()
 {
-    if (mToSelectModel != nullptr)
-        delete mToSelectModel;
+    deleteSons();
     if (mLocalModel != nullptr)
         delete mLocalModel;
+    if (mTest != nullptr)
+        delete mTest;
+    if (mIsRoot) {
+        if (mToSelectModel != nullptr)
+            delete mToSelectModel;
+        if (mArena != nullptr)
+            delete mArena;
+        if (mHeader != nullptr)
+            delete mHeader;
+    }
+}
+
+void ClassifierTree::attachSubtree(ClassifierTree &subtree) const {
+
+    subtree.mArena = mArena;
+    subtree.mIsRoot = false;
+}
+
+Arena &ClassifierTree::arena() {
+
+    if (mArena == nullptr) {
+        mArena = new Arena();
+    }
+    return *mArena;
+}
+
+Instances *ClassifierTree::keepInArena(Instances *data) {
+
+    Arena &owner = arena();
+    owner.add(data);
+    for (int i = 0; i < data->numInstances(); i++) {
+        owner.add(&data->instance(i));
+    }
+    return data;
+}
+
+void ClassifierTree::dropTrainingData(Instances &data) {
+
+    arena().release();
+    if (mHeader != nullptr)
+        delete mHeader;
+    mHeader = new Instances(&data, 0);
+    cleanup(*mHeader);
+}
+
+void ClassifierTree::replaceByNoSplit() {
+
+    ClassifierSplitModel *oldModel = mLocalModel;
+    mLocalModel = new NoSplit(oldModel->getDistribution());
+    delete oldModel;
+}
+
+void ClassifierTree::deleteSons() {
+
+    for (auto mSon : mSons) {
+        delete mSon;
+    }
+    mSons.clear();
 }
 
 void ClassifierTree::buildClassifier(Instances &data){
 
-    // remove instances with missing class
-    data = new Instances(data);
-    data.deleteWithMissingClass();
+    // leave out instances with missing class, without copying the others
+    if (data.classIndex() < 0) {
+        throw "Class index is negative (not set)!";
+    }
+    InstancesView view(data, data.numInstances());
+    view.addKnown(data.classIndex());
 
-    buildTree(data, false);
+    buildTree(view, nullptr, false);
 }
 
 void ClassifierTree::buildTree(Instances &data, bool keepData) {
 
-    std::vector<Instances*> localInstances;
+    buildTree(InstancesView(data), nullptr, keepData);
+}
+
+void ClassifierTree::buildTree(const InstancesView &data, SortedInstances *sorted, bool keepData) {
+
+    std::vector<InstancesView*> localInstances;
+    std::vector<SortedInstances*> localSorted;
 
+    // the arena is created before any son can be built on another thread
+    arena();
     if (keepData) {
-        mTrain = new Instances(&data);
+        mTrain = keepInArena(data.toInstances());
     }
-    mTest = nullptr;;
+    if (mTest != nullptr) {
+        delete mTest;
+    }
+    mTest = nullptr;
     mIsLeaf = false;
     mIsEmpty = false;
-    mSons.clear();
-    mLocalModel = mToSelectModel->selectModel(data);
+    deleteSons();
+    if (mLocalModel != nullptr) {
+        delete mLocalModel;
+    }
+    mLocalModel = mToSelectModel->selectModel(data, sorted);
     if (mLocalModel->numSubsets() > 1) {
         localInstances = mLocalModel->split(data);
-        
-        mSons = std::vector<ClassifierTree*>(mLocalModel->numSubsets());
-        int totalSons = (int)mSons.size();
-        for (int i = 0; i < totalSons; i++) {
-            mSons[i] = getNewTree(*localInstances[i]);
-            //delete (localInstances[i]);
+        localSorted = std::vector<SortedInstances*>(mLocalModel->numSubsets());
+        if (sorted != nullptr) {
+            localSorted = sorted->split(*mLocalModel, data, localInstances);
+            delete sorted;
         }
+
+        buildSons(data.numInstances(), [this, &localInstances, &localSorted](int i) {
+            mSons[i] = getNewTree(*localInstances[i], localSorted[i]);
+            delete localInstances[i];
+        });
     }
     else {
+        delete sorted;
         mIsLeaf = true;
         if (Utils::eq(data.sumOfWeights(), 0)) {
             mIsEmpty = true;
@@ -71,6 +164,70 @@ void ClassifierTree::buildTree(Instances &data, bool keepData) {
     }
 }
 
+void ClassifierTree::buildTree(const InstancesView &train, const InstancesView &test, SortedInstances *sorted, bool keepData) {
+
+    std::vector<InstancesView*> localTrain, localTest;
+    std::vector<SortedInstances*> localSorted;
+
+    // the arena is created before any son can be built on another thread
+    arena();
+    if (keepData) {
+        mTrain = keepInArena(train.toInstances());
+    }
+    mIsLeaf = false;
+    mIsEmpty = false;
+    deleteSons();
+    if (mLocalModel != nullptr) {
+        delete mLocalModel;
+    }
+    mLocalModel = mToSelectModel->selectModel(train, sorted);
+    if (mTest != nullptr) {
+        delete mTest;
+    }
+    mTest = new Distribution(test, *mLocalModel);
+    if (mLocalModel->numSubsets() > 1) {
+        localTrain = mLocalModel->split(train);
+        localTest = mLocalModel->split(test);
+        localSorted = std::vector<SortedInstances*>(mLocalModel->numSubsets());
+        if (sorted != nullptr) {
+            localSorted = sorted->split(*mLocalModel, train, localTrain);
+            delete sorted;
+        }
+        buildSons(train.numInstances(), [this, &localTrain, &localTest, &localSorted](int i) {
+            mSons[i] = getNewTree(*localTrain[i], *localTest[i], localSorted[i]);
+            delete localTrain[i];
+            delete localTest[i];
+        });
+    }
+    else {
+        delete sorted;
+        mIsLeaf = true;
+        if (Utils::eq(train.sumOfWeights(), 0)) {
+            mIsEmpty = true;
+        }
+    }
+}
+
+void ClassifierTree::buildSons(int numInstances, const std::function<void(int)> &buildSon) {
+
+    mSons = std::vector<ClassifierTree*>(mLocalModel->numSubsets());
+    int totalSons = (int)mSons.size();
+    ThreadPool *pool = mToSelectModel->threadPool();
+    if (pool != nullptr && numInstances >= MIN_INSTANCES_FOR_TASKS) {
+        // the sons are independent; each task only writes its own slot
+        ThreadPool::TaskGroup sons;
+        for (int i = 0; i < totalSons; i++) {
+            pool->spawn(sons, [&buildSon, i]() { buildSon(i); });
+        }
+        pool->wait(sons);
+    }
+    else {
+        for (int i = 0; i < totalSons; i++) {
+            buildSon(i);
+        }
+    }
+}
+
 void ClassifierTree::buildTree(Instances &train, Instances &test, bool keepData) {
 
     std::vector<Instances*> localTrain, localTest;
@@ -81,19 +238,22 @@ void ClassifierTree::buildTree(Instances &train, Instances &test, bool keepData)
     }
     mIsLeaf = false;
     mIsEmpty = false;
-    mSons.clear();
+    deleteSons();
+    if (mLocalModel != nullptr) {
+        delete mLocalModel;
+    }
     mLocalModel = mToSelectModel->selectModel(train, test);
+    if (mTest != nullptr) {
+        delete mTest;
+    }
     mTest = new Distribution(test, *mLocalModel);
     if (mLocalModel->numSubsets() > 1) {
-        localTrain = mLocalModel->split(train);
-        localTest = mLocalModel->split(test);
-        //delete train;
-        //delete test;
+        // the subsets are kept by the arena, as the sons may keep them
+        localTrain = mLocalModel->split(train, arena());
+        localTest = mLocalModel->split(test, arena());
         mSons = std::vector<ClassifierTree*>(mLocalModel->numSubsets());
         for (i = 0; i < mSons.size(); i++) {
             mSons[i] = getNewTree(*localTrain[i], *localTest[i]);
-            //delete localTrain[i];
-            //delete localTest[i];
         }
     }
     else {
@@ -132,6 +292,11 @@ void ClassifierTree::cleanup(Instances &justHeaderInfo) {
     }
 }
 
+size_t ClassifierTree::arenaSize() const {
+
+    return (mArena == nullptr) ? 0 : mArena->size();
+}
+
 double_array ClassifierTree::distributionForInstance(Instance &instance, bool useLaplace) {
 
     double_array doubles(instance.numClasses());
@@ -216,10 +381,20 @@ string ClassifierTree::toString(bool isDumpTree) const {
     }
 }
 
-ClassifierTree *ClassifierTree::getNewTree(Instances &data) const{
+ClassifierTree *ClassifierTree::getNewTree(const InstancesView &data, SortedInstances *sorted) const{
 
     ClassifierTree *newTree = new ClassifierTree(mToSelectModel);
-    newTree->buildTree(data, false);
+    attachSubtree(*newTree);
+    newTree->buildTree(data, sorted, false);
+
+    return newTree;
+}
+
+ClassifierTree *ClassifierTree::getNewTree(const InstancesView &train, const InstancesView &test, SortedInstances *sorted) const{
+
+    ClassifierTree *newTree = new ClassifierTree(mToSelectModel);
+    attachSubtree(*newTree);
+    newTree->buildTree(train, test, sorted, false);
 
     return newTree;
 }
@@ -227,6 +402,7 @@ ClassifierTree *ClassifierTree::getNewTree(Instances &data) const{
 ClassifierTree *ClassifierTree::getNewTree(Instances &train, Instances &test) const{
 
     ClassifierTree *newTree = new ClassifierTree(mToSelectModel);
+    attachSubtree(*newTree);
     newTree->buildTree(train, test, false);
 
     return newTree;
@@ -368,7 +544,47 @@ double_array ClassifierTree::getMembershipValues(Instance &instance) {
     return a;
 }
 
-void ClassifierTree::serialize(std::ostream &os)
+ClassifierTree *ClassifierTree::getEmptyTree() const
+{
+    ClassifierTree *newTree = new ClassifierTree(mToSelectModel);
+    attachSubtree(*newTree);
+    return newTree;
+}
+
+void ClassifierTree::serialize(BinaryWriter &writer) const
 {
-	os << mIsLeaf << '\0' << mIsEmpty << '\0' << mID << '\0';
+    writer.writeBool(mIsLeaf);
+    writer.writeBool(mIsEmpty);
+    writer.writeInt(mID);
+    mLocalModel->serialize(writer);
+    if (!mIsLeaf)
+    {
+        writer.writeInt((int)mSons.size());
+        for (auto son : mSons)
+        {
+            son->serialize(writer);
+        }
+    }
+}
+
+void ClassifierTree::deserialize(BinaryReader &reader, const Instances &header)
+{
+    mIsLeaf = reader.readBool();
+    mIsEmpty = reader.readBool();
+    mID = reader.readInt();
+    mLocalModel = ClassifierSplitModel::deserialize(reader, header);
+    mSons.clear();
+    if (!mIsLeaf)
+    {
+        int numSons = reader.readInt();
+        if (numSons != mLocalModel->numSubsets())
+        {
+            throw string("Invalid number of sons: ") + std::to_string(numSons);
+        }
+        for (int i = 0; i < numSons; i++)
+        {
+            mSons.push_back(getEmptyTree());
+            mSons[i]->deserialize(reader, header);
+        }
+    }
 }
\ No newline at end of file
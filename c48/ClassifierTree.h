@@ -4,6 +4,7 @@
 #include <string>
 #include <vector>
 #include <list>
+#include <functional>
 #include <stdexcept>
 #include "core/Typedefs.h"
 
@@ -13,10 +14,20 @@ class ClassifierSplitModel;
 class Instances;
 class Distribution;
 class Instance;
+class SortedInstances;
+class InstancesView;
+class BinaryWriter;
+class BinaryReader;
+class Arena;
 
 
 /**
  * Class for handling a tree structure used for classification.
+ *
+ * A node owns its sons, its local model and its pruning distribution. The
+ * root also owns the model selection method and the arena shared by all
+ * nodes, which holds the training subsets the nodes keep and the instances
+ * copied into them.
  */
 class ClassifierTree {
 
@@ -36,15 +47,33 @@ protected:
     /** True if node is empty. */
     bool mIsEmpty;
 
-    /** The training instances. */
+    /** The training instances, owned by the arena. */
     Instances *mTrain;
 
     /** The pruning instances. */
     Distribution *mTest;
 
+    /** The arena holding the kept training data, shared with the subtrees. */
+    Arena *mArena;
+
+    /**
+     * The header information the nodes refer to once the training data has
+     * been dropped, owned by the root.
+     */
+    Instances *mHeader;
+
+    /** True if the node is the root, owning the model selection and the arena. */
+    bool mIsRoot;
+
     /** The id for the node. */
     int mID = 0;
 
+    /**
+     * Minimum number of instances at a node for its sons to be built as
+     * separate tasks. Below it the recursion stays on the calling thread.
+     */
+    static const int MIN_INSTANCES_FOR_TASKS = 1000;
+
     /**
      * Gets the next unique node ID.
      *
@@ -61,11 +90,13 @@ protected:
     /**
      * Returns a newly created tree.
      *
-     * @param data the training data
+     * @param data the rows of the training data
+     * @param sorted the presorted orders of the training data, may be null.
+     *          Ownership is passed to the new tree.
      * @return the generated tree
      * @throws Exception if something goes wrong
      */
-    virtual ClassifierTree *getNewTree(Instances &data) const;
+    virtual ClassifierTree *getNewTree(const InstancesView &data, SortedInstances *sorted) const;
 
     /**
      * Returns a newly created tree.
@@ -77,6 +108,78 @@ protected:
      */
     virtual ClassifierTree *getNewTree(Instances &train, Instances &test) const;
 
+    /**
+     * Returns a newly created tree built with a hold out set.
+     *
+     * @param train the rows of the training data
+     * @param test the rows of the pruning data, of the same dataset or another
+     * @param sorted the presorted orders of the training data, may be null.
+     *          Ownership is passed to the new tree.
+     * @return the generated tree
+     * @throws Exception if something goes wrong
+     */
+    virtual ClassifierTree *getNewTree(const InstancesView &train, const InstancesView &test, SortedInstances *sorted) const;
+
+    /**
+     * Returns a new tree with the same settings that has not been built, e.g.
+     * to be read by deserialize().
+     *
+     * @return the new tree
+     */
+    virtual ClassifierTree *getEmptyTree() const;
+
+    /**
+     * Makes a new tree a subtree of this one, sharing the model selection
+     * method and the arena owned by the root.
+     *
+     * @param subtree the new tree
+     */
+    void attachSubtree(ClassifierTree &subtree) const;
+
+    /**
+     * Returns the arena of the tree, creating it at the root if necessary.
+     *
+     * @return the arena
+     */
+    Arena &arena();
+
+    /**
+     * Hands a set of instances and all its instances over to the arena.
+     *
+     * @param data the set, whose instances must not be owned elsewhere
+     * @return the set
+     */
+    Instances *keepInArena(Instances *data);
+
+    /**
+     * Drops the training data kept by the arena, leaving the nodes with the
+     * header information of the data only.
+     *
+     * @param data the training data
+     */
+    void dropTrainingData(Instances &data);
+
+    /**
+     * Deletes the sons and empties the list of sons.
+     */
+    void deleteSons();
+
+    /**
+     * Creates a son for every subset of the local model and builds them, as
+     * separate tasks if a thread pool is available and the node is large
+     * enough.
+     *
+     * @param numInstances the number of training rows at the node
+     * @param buildSon builds the son of the given index into mSons
+     */
+    void buildSons(int numInstances, const std::function<void(int)> &buildSon);
+
+    /**
+     * Replaces the local model by a NoSplit model with the same class
+     * distribution, deleting the old model.
+     */
+    void replaceByNoSplit();
+
 public:
 
     /**
@@ -85,9 +188,9 @@ public:
     ClassifierTree(ModelSelection *toSelectLocModel);
 
     /**
-    * Destructor.
-    */
-    ~ClassifierTree();
+     * Deletes the tree with all its subtrees.
+     */
+    virtual ~ClassifierTree();
 
     /**
      * Method for building a classifier tree.
@@ -106,6 +209,20 @@ public:
      */
     virtual void buildTree(Instances &data, bool keepData);
 
+    /**
+     * Builds the tree structure, selecting numeric splits from the presorted
+     * orders of the data. The data is passed down as views on the same
+     * dataset, and the views and orders of the sons are released as soon as
+     * the sons have been built. Only kept training data is copied.
+     *
+     * @param data the rows for which the tree structure is to be generated.
+     * @param sorted the presorted orders of the rows, may be null. Ownership
+     *          is passed to this tree.
+     * @param keepData is training data to be kept?
+     * @throws Exception if something goes wrong
+     */
+    virtual void buildTree(const InstancesView &data, SortedInstances *sorted, bool keepData);
+
     /**
      * Builds the tree structure with hold out set
      *
@@ -116,6 +233,20 @@ public:
      */
     virtual void buildTree(Instances &train, Instances &test, bool keepData);
 
+    /**
+     * Builds the tree structure with hold out set, passing both down as
+     * views and building the sons in the same way as buildTree() without a
+     * hold out set.
+     *
+     * @param train the rows for which the tree structure is to be generated.
+     * @param test the rows of the test data for potential pruning
+     * @param sorted the presorted orders of the training rows, may be null.
+     *          Ownership is passed to this tree.
+     * @param keepData is training Data to be kept?
+     * @throws Exception if something goes wrong
+     */
+    virtual void buildTree(const InstancesView &train, const InstancesView &test, SortedInstances *sorted, bool keepData);
+
     /**
      * Classifies an instance.
      *
@@ -132,6 +263,14 @@ public:
      */
     void cleanup(Instances &justHeaderInfo);
 
+    /**
+     * Returns the number of objects the arena of the tree holds, e.g. to
+     * check that a cleaned up tree keeps no training data.
+     *
+     * @return the number of objects, 0 if there is no arena
+     */
+    size_t arenaSize() const;
+
     /**
      * Returns class probabilities for a weighted instance.
      *
@@ -176,9 +315,30 @@ public:
      */
     virtual double_array getMembershipValues(Instance &instance);
 
-	virtual void serialize(std::ostream &os);
+    /**
+     * Writes the tree structure: the local models with their distributions
+     * and, recursively, the sons.
+     *
+     * @param writer the writer
+     */
+    virtual void serialize(BinaryWriter &writer) const;
+
+    /**
+     * Reads a tree structure written by serialize() into this tree, which
+     * has to be empty. Call cleanup() afterwards to attach the header
+     * information used for printing the tree.
+     *
+     * @param reader the reader
+     * @param header the header of the training data
+     * @throws Exception if the data is invalid
+     */
+    virtual void deserialize(BinaryReader &reader, const Instances &header);
 
 private:
+
+    friend class CompiledTree;
+    friend class LevelWiseBuilder;
+
     /**
      * For getting a unique ID when outputting the tree (hashcode isn't guaranteed
      * unique)
@@ -0,0 +1,477 @@
+#include "CompiledTree.h"
+#include "ClassifierTree.h"
+#include "C45Split.h"
+#include "NoSplit.h"
+#include "Distribution.h"
+#include "core/Instances.h"
+#include "core/Instance.h"
+#include "core/ColumnStore.h"
+#include "core/MappedFile.h"
+#include "core/Utils.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+const int CompiledTree::BLOCK_SIZE;
+
+CompiledTree::CompiledTree(const ClassifierTree &tree, const Instances &header) :
+    mNumAttributes(header.numAttributes()),
+    mNumClasses(header.numClasses()),
+    mClassIndex(header.classIndex()),
+    mDepth(0),
+    mFile(nullptr),
+    mMetadata(nullptr),
+    mMetadataSize(0)
+{
+    // Empty sons are leaves as well, so the tree's counts are exact.
+    mNodeStore.reserve(tree.numNodes());
+    mBranchWeightStore.reserve(tree.numNodes());
+    mProbStore.reserve((size_t)tree.numLeaves() * mNumClasses);
+    mLaplaceProbStore.reserve((size_t)tree.numLeaves() * mNumClasses);
+
+    mNodeStore.resize(1);
+    mBranchWeightStore.resize(1, 1);
+    compile(tree, 0, header, 0);
+
+    mNodes = mNodeStore.data();
+    mBranchWeights = mBranchWeightStore.data();
+    mProbs = mProbStore.data();
+    mLaplaceProbs = mLaplaceProbStore.data();
+    mNumNodes = (int)mNodeStore.size();
+    mNumProbs = (int)mProbStore.size();
+}
+
+CompiledTree::CompiledTree(MappedFile *file) :
+    mFile(file)
+{
+    const char *data = file->data();
+    size_t size = file->size();
+    FileHeader header;
+
+    if (size < sizeof(FileHeader))
+    {
+        throw string("Not a compiled C48 tree");
+    }
+    memcpy(&header, data, sizeof(FileHeader));
+    if (header.magic != FILE_MAGIC)
+    {
+        throw string("Not a compiled C48 tree");
+    }
+    if (header.version != FILE_VERSION)
+    {
+        throw string("Unsupported compiled C48 tree version: ") + std::to_string(header.version);
+    }
+    if (header.numNodes < 1 || header.numProbs < 0 || header.numClasses < 1 || header.numAttributes < 1
+        || header.depth < 0 || header.metadataSize < 0
+        || size != sizeof(FileHeader) + header.numNodes * (sizeof(Node) + sizeof(double))
+                    + 2 * sizeof(double) * header.numProbs + (size_t)header.metadataSize)
+    {
+        throw string("Invalid compiled C48 tree");
+    }
+
+    mNumAttributes = header.numAttributes;
+    mNumClasses = header.numClasses;
+    mClassIndex = header.classIndex;
+    mDepth = header.depth;
+    mNumNodes = header.numNodes;
+    mNumProbs = header.numProbs;
+
+    // The sizes of the header and of a node are multiples of 8, so the
+    // arrays are aligned inside the page-aligned mapping.
+    const char *position = data + sizeof(FileHeader);
+    mNodes = reinterpret_cast<const Node*>(position);
+    position += mNumNodes * sizeof(Node);
+    mBranchWeights = reinterpret_cast<const double*>(position);
+    position += mNumNodes * sizeof(double);
+    mProbs = reinterpret_cast<const double*>(position);
+    position += mNumProbs * sizeof(double);
+    mLaplaceProbs = reinterpret_cast<const double*>(position);
+    position += mNumProbs * sizeof(double);
+    mMetadata = position;
+    mMetadataSize = (size_t)header.metadataSize;
+
+    validate();
+}
+
+CompiledTree::~CompiledTree()
+{
+    if (mFile != nullptr)
+        delete mFile;
+}
+
+void CompiledTree::validate() const
+{
+    // Sons following their parent rules out cycles, and lets the depths be
+    // computed in the same pass. The depth bounds the scratch space.
+    int_array depths(mNumNodes, 0);
+
+    for (int i = 0; i < mNumNodes; i++)
+    {
+        const Node &node = mNodes[i];
+        // Empty nodes are never entered for missing values.
+        bool valid = node.isNominal <= 1 && node.isEmpty <= 1
+            && (node.isEmpty != 0 || depths[i] <= mDepth);
+        if (node.attIndex < 0)
+        {
+            valid = valid && node.offset >= 0 && node.offset <= mNumProbs - mNumClasses;
+        }
+        else
+        {
+            valid = valid && node.attIndex < mNumAttributes && node.offset > i
+                && (node.isNominal ? node.numSons > 0 : node.numSons == 2)
+                && node.offset <= mNumNodes - node.numSons;
+            for (int j = node.offset; valid && j < node.offset + node.numSons; j++)
+            {
+                depths[j] = depths[i] + 1;
+            }
+        }
+        if (!valid)
+        {
+            throw string("Invalid node in compiled C48 tree: ") + std::to_string(i);
+        }
+    }
+}
+
+CompiledTree *CompiledTree::map(const string &path)
+{
+    MappedFile *file = new MappedFile(path);
+    try
+    {
+        return new CompiledTree(file);
+    }
+    catch (...)
+    {
+        delete file;
+        throw;
+    }
+}
+
+void CompiledTree::save(std::ostream &os, const string &metadata) const
+{
+    FileHeader header;
+
+    // Clear the padding as well, so that equal trees give equal files.
+    memset(&header, 0, sizeof(FileHeader));
+    header.magic = FILE_MAGIC;
+    header.version = FILE_VERSION;
+    header.numAttributes = mNumAttributes;
+    header.numClasses = mNumClasses;
+    header.classIndex = mClassIndex;
+    header.depth = mDepth;
+    header.numNodes = mNumNodes;
+    header.numProbs = mNumProbs;
+    header.metadataSize = (long long)metadata.size();
+
+    os.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+    os.write(reinterpret_cast<const char*>(mNodes), mNumNodes * sizeof(Node));
+    os.write(reinterpret_cast<const char*>(mBranchWeights), mNumNodes * sizeof(double));
+    os.write(reinterpret_cast<const char*>(mProbs), mNumProbs * sizeof(double));
+    os.write(reinterpret_cast<const char*>(mLaplaceProbs), mNumProbs * sizeof(double));
+    os.write(metadata.data(), metadata.size());
+    if (!os)
+    {
+        throw string("Cannot write compiled C48 tree");
+    }
+}
+
+const char *CompiledTree::metadata() const
+{
+    return mMetadata;
+}
+
+size_t CompiledTree::metadataSize() const
+{
+    return mMetadataSize;
+}
+
+int CompiledTree::numAttributes() const
+{
+    return mNumAttributes;
+}
+
+int CompiledTree::classIndex() const
+{
+    return mClassIndex;
+}
+
+void CompiledTree::compile(const ClassifierTree &tree, const int index, const Instances &header, const int depth)
+{
+    mDepth = std::max(mDepth, depth);
+    mNodeStore[index].isEmpty = tree.mIsEmpty;
+    mNodeStore[index].splitPoint = 0;
+
+    if (tree.mIsLeaf)
+    {
+        const NoSplit *model = dynamic_cast<const NoSplit*>(tree.mLocalModel);
+        if (model == nullptr)
+        {
+            throw "Cannot compile a leaf with a split model";
+        }
+        addLeaf(index, *model->getDistribution(), -1);
+        return;
+    }
+
+    const C45Split *split = dynamic_cast<const C45Split*>(tree.mLocalModel);
+    if (split == nullptr)
+    {
+        throw "Cannot compile a split model other than C45Split";
+    }
+    Distribution *dist = split->getDistribution();
+    int numSons = (int)tree.mSons.size();
+    int first = (int)mNodeStore.size();
+
+    mNodeStore[index].attIndex = split->attIndex();
+    mNodeStore[index].numSons = numSons;
+    mNodeStore[index].offset = first;
+    mNodeStore[index].isNominal = header.attribute(split->attIndex()).isNominal();
+    mNodeStore[index].splitPoint = split->splitPoint();
+
+    // The sons are stored next to each other, so their subtrees follow them.
+    mNodeStore.resize(first + numSons);
+    mBranchWeightStore.resize(first + numSons);
+    for (int i = 0; i < numSons; i++)
+    {
+        mBranchWeightStore[first + i] = dist->perBag(i) / dist->total();
+    }
+    for (int i = 0; i < numSons; i++)
+    {
+        const ClassifierTree &son = *tree.mSons[i];
+        if (son.mIsEmpty)
+        {
+            // An empty son predicts the distribution of its branch at this node.
+            mNodeStore[first + i].isEmpty = true;
+            mNodeStore[first + i].splitPoint = 0;
+            addLeaf(first + i, *dist, i);
+        }
+        else
+        {
+            compile(son, first + i, header, depth + 1);
+        }
+    }
+}
+
+void CompiledTree::addLeaf(const int index, const Distribution &dist, const int bag)
+{
+    mNodeStore[index].attIndex = -1;
+    mNodeStore[index].numSons = 0;
+    mNodeStore[index].offset = (int)mProbStore.size();
+    mNodeStore[index].isNominal = false;
+    for (int c = 0; c < mNumClasses; c++)
+    {
+        if (bag < 0)
+        {
+            mProbStore.push_back(dist.prob(c));
+            mLaplaceProbStore.push_back(dist.laplaceProb(c));
+        }
+        else
+        {
+            mProbStore.push_back(dist.prob(c, bag));
+            mLaplaceProbStore.push_back(dist.laplaceProb(c, bag));
+        }
+    }
+}
+
+int CompiledTree::numClasses() const
+{
+    return mNumClasses;
+}
+
+int CompiledTree::numNodes() const
+{
+    return mNumNodes;
+}
+
+inline int CompiledTree::son(const Node &node, const double value) const
+{
+    if (node.isNominal)
+    {
+        // Compared as doubles, as values out of range need not fit an int.
+        return (value >= 0 && value < node.numSons) ? node.offset + static_cast<int>(value) : -1;
+    }
+    // Utils::smOrEq() written out without branches, as the direction taken
+    // is hard to predict.
+    int right = !((value - node.splitPoint < Utils::SMALL) | (value <= node.splitPoint));
+    return node.offset + right;
+}
+
+void CompiledTree::distribution(const int index, const Instance &instance, const double weight, const double *probs, double *dist, double *scratch) const
+{
+    const Node *node = &mNodes[index];
+
+    while (node->attIndex >= 0)
+    {
+        double value = instance.value(node->attIndex);
+        int next = std::isnan(value) ? -1 : son(*node, value);
+        if (next < 0)
+        {
+            // Sum the sons in order, as ClassifierTree::getProbs does.
+            for (int c = 0; c < mNumClasses; c++)
+            {
+                dist[c] = 0;
+            }
+            for (int i = node->offset; i < node->offset + node->numSons; i++)
+            {
+                if (!mNodes[i].isEmpty)
+                {
+                    distribution(i, instance, mBranchWeights[i] * weight, probs, scratch, scratch + mNumClasses);
+                    for (int c = 0; c < mNumClasses; c++)
+                    {
+                        dist[c] += scratch[c];
+                    }
+                }
+            }
+            return;
+        }
+
+        node = &mNodes[next];
+    }
+
+    const double *leaf = probs + node->offset;
+    for (int c = 0; c < mNumClasses; c++)
+    {
+        dist[c] = weight * leaf[c];
+    }
+}
+
+double *CompiledTree::scratch() const
+{
+    static thread_local double_array scratch;
+
+    size_t size = (size_t)(mDepth + 1) * mNumClasses;
+    if (scratch.size() < size)
+    {
+        scratch.resize(size);
+    }
+    return scratch.data();
+}
+
+void CompiledTree::distributionForInstance(const Instance &instance, const bool useLaplace, double *dist) const
+{
+    distribution(0, instance, 1, useLaplace ? mLaplaceProbs : mProbs, dist, scratch());
+}
+
+void CompiledTree::distributionsForBlock(Instances &batch, const ColumnStore &store, const int start, const int count, const double *const *columns, const double *probs, double *dist, double *scratch) const
+{
+    int nodes[BLOCK_SIZE];
+    int rows[BLOCK_SIZE];
+    int active[BLOCK_SIZE];
+    int numActive = count;
+
+    for (int i = 0; i < count; i++)
+    {
+        nodes[i] = 0;
+        rows[i] = batch.instance(start + i).row();
+        active[i] = i;
+    }
+
+    // Every pass moves the instances still inside the tree down one level
+    // and drops those that have reached a leaf.
+    while (numActive > 0)
+    {
+        int stillActive = 0;
+        for (int a = 0; a < numActive; a++)
+        {
+            int i = active[a];
+            const Node &node = mNodes[nodes[i]];
+            double *out = dist + (size_t)(start + i) * mNumClasses;
+
+            if (node.attIndex < 0)
+            {
+                const double *leaf = probs + node.offset;
+                for (int c = 0; c < mNumClasses; c++)
+                {
+                    out[c] = leaf[c];
+                }
+                continue;
+            }
+            const double *column = columns[node.attIndex];
+            double value = (column != nullptr) ? column[rows[i]] : store.value(rows[i], node.attIndex);
+            int next = std::isnan(value) ? -1 : son(node, value);
+            if (next < 0)
+            {
+                // The weight is still 1 on the path down to here.
+                distribution(nodes[i], batch.instance(start + i), 1, probs, out, scratch);
+                continue;
+            }
+            nodes[i] = next;
+            active[stillActive++] = i;
+        }
+        numActive = stillActive;
+    }
+}
+
+void CompiledTree::distributionsForInstances(Instances &batch, const bool useLaplace, double *dist) const
+{
+    const double *probs = useLaplace ? mLaplaceProbs : mProbs;
+    double *space = scratch();
+    int numInstances = batch.numInstances();
+    const ColumnStore *columnsStore = nullptr;
+    std::vector<const double*> columns;
+
+    for (int start = 0; start < numInstances; start += BLOCK_SIZE)
+    {
+        int count = std::min(BLOCK_SIZE, numInstances - start);
+
+        // Blocks are routed on the columns if all their values are in one
+        // store that keeps no attribute tested by the tree in its class column.
+        const ColumnStore *store = batch.instance(start).store();
+        if (store != nullptr && store->classIndex() >= 0 && store->classIndex() != mClassIndex)
+        {
+            store = nullptr;
+        }
+        for (int i = 1; i < count && store != nullptr; i++)
+        {
+            if (batch.instance(start + i).store() != store)
+            {
+                store = nullptr;
+            }
+        }
+
+        if (store != nullptr)
+        {
+            if (store != columnsStore)
+            {
+                columns.resize(store->numAttributes());
+                for (int att = 0; att < store->numAttributes(); att++)
+                {
+                    columns[att] = store->column(att);
+                }
+                columnsStore = store;
+            }
+            distributionsForBlock(batch, *store, start, count, columns.data(), probs, dist, space);
+        }
+        else
+        {
+            for (int i = start; i < start + count; i++)
+            {
+                distribution(0, batch.instance(i), 1, probs, dist + (size_t)i * mNumClasses, space);
+            }
+        }
+    }
+}
+
+double_array CompiledTree::distributionForInstance(const Instance &instance, const bool useLaplace) const
+{
+    double_array dist(mNumClasses);
+
+    distributionForInstance(instance, useLaplace, dist.data());
+    return dist;
+}
+
+double CompiledTree::classifyInstance(const Instance &instance) const
+{
+    double_array dist = distributionForInstance(instance, false);
+    double maxProb = -1;
+    int maxIndex = 0;
+
+    for (int j = 0; j < mNumClasses; j++)
+    {
+        if (Utils::gr(dist[j], maxProb))
+        {
+            maxIndex = j;
+            maxProb = dist[j];
+        }
+    }
+    return maxIndex;
+}
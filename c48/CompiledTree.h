@@ -0,0 +1,370 @@
+#ifndef _COMPILEDTREE_
+#define _COMPILEDTREE_
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+#include "core/Typedefs.h"
+
+// Forward class declarations:
+class ClassifierTree;
+class ColumnStore;
+class Distribution;
+class Instances;
+class Instance;
+class MappedFile;
+
+/**
+ * Class for a read-only copy of a built classifier tree laid out for fast
+ * classification. The nodes are stored in one contiguous array, the sons of
+ * a node next to each other, and the class probabilities of every leaf are
+ * computed once and stored in one contiguous pool. A single walk down the
+ * tree yields the whole class distribution, where ClassifierTree walks the
+ * tree once per class.
+ *
+ * The distributions are exactly the ones ClassifierTree computes, including
+ * instances with missing values that are passed down all branches: the
+ * fractional weights are multiplied and the results of the branches summed
+ * in the same order.
+ *
+ * The arrays can be saved to a file in the layout they have in memory and
+ * the file mapped back read-only, so that classification runs directly on
+ * the mapping. Processes mapping the same file share its pages, and opening
+ * a mapped tree costs no more than checking its structure. A file is only
+ * readable on machines of the byte order it was written on.
+ */
+class CompiledTree
+{
+
+protected:
+
+    /** A node of the tree, stored as is in saved files. */
+    struct Node
+    {
+        /** The attribute tested at the node, -1 for a leaf. */
+        int attIndex;
+
+        /** The number of sons of the node. */
+        int numSons;
+
+        /**
+         * For an inner node, the index of its first son. For a leaf, the
+         * index of its class probabilities in the probability pools.
+         */
+        int offset;
+
+        /**
+         * Whether the tested attribute is nominal, 0 or 1. The flags are
+         * bytes rather than bools as they are read from files.
+         */
+        uint8_t isNominal;
+
+        /** Whether the node is an empty leaf, skipped for missing values, 0 or 1. */
+        uint8_t isEmpty;
+
+        /** The split point of a numeric test. */
+        double splitPoint;
+    };
+
+    /** The fixed-size start of a saved file; the arrays follow in order. */
+    struct FileHeader
+    {
+        /** FILE_MAGIC. */
+        int magic;
+
+        /** The version of the layout. */
+        int version;
+
+        /** The number of attributes of the training data. */
+        int numAttributes;
+
+        /** The number of classes. */
+        int numClasses;
+
+        /** The index of the class attribute. */
+        int classIndex;
+
+        /** The depth of the tree. */
+        int depth;
+
+        /** The number of nodes. */
+        int numNodes;
+
+        /** The number of values in each probability pool. */
+        int numProbs;
+
+        /** The number of bytes of caller-defined data stored at the end. */
+        long long metadataSize;
+    };
+
+    /** Identifies a saved compiled tree; also tells apart files of the other byte order */
+    static const int FILE_MAGIC = 0x54383443;
+
+    /** The version of the saved layout */
+    static const int FILE_VERSION = 1;
+
+    /** The nodes, the root first. */
+    const Node *mNodes;
+
+    /**
+     * The weight of the branch leading to each node when the value tested
+     * at its parent is missing.
+     */
+    const double *mBranchWeights;
+
+    /** The class probabilities of the leaves. */
+    const double *mProbs;
+
+    /** The Laplace-corrected class probabilities of the leaves. */
+    const double *mLaplaceProbs;
+
+    /** The number of nodes. */
+    int mNumNodes;
+
+    /** The number of values in each probability pool. */
+    int mNumProbs;
+
+    /** The number of attributes of the training data. */
+    int mNumAttributes;
+
+    /** The number of classes. */
+    int mNumClasses;
+
+    /** The index of the class attribute of the training data. */
+    int mClassIndex;
+
+    /** The depth of the tree. */
+    int mDepth;
+
+    /** Holds the nodes of a tree compiled in memory. */
+    std::vector<Node> mNodeStore;
+
+    /** Holds the branch weights of a tree compiled in memory. */
+    double_array mBranchWeightStore;
+
+    /** Holds the class probabilities of a tree compiled in memory. */
+    double_array mProbStore;
+
+    /** Holds the Laplace-corrected probabilities of a tree compiled in memory. */
+    double_array mLaplaceProbStore;
+
+    /** The file the arrays are mapped from, null for a tree compiled in memory. */
+    MappedFile *mFile;
+
+    /** The caller-defined data of a mapped file. */
+    const char *mMetadata;
+
+    /** The number of bytes of caller-defined data. */
+    size_t mMetadataSize;
+
+    /**
+     * Creates a tree on the arrays of a mapped file.
+     *
+     * @param file the file, owned by the tree once created
+     * @throws Exception if the file is not a valid compiled tree
+     */
+    CompiledTree(MappedFile *file);
+
+    /**
+     * Checks that the nodes only refer to nodes below them and to values
+     * inside the pools, and that numeric tests have two sons, so that no
+     * classification can read past the arrays; son() checks nominal values
+     * against the number of sons.
+     *
+     * @throws Exception if a node is invalid
+     */
+    void validate() const;
+
+    /**
+     * Copies a node of the tree and, recursively, its sons.
+     *
+     * @param tree the node to copy
+     * @param index the slot of the node in mNodes
+     * @param header the structure of the training data
+     * @param depth the depth of the node
+     */
+    void compile(const ClassifierTree &tree, const int index, const Instances &header, const int depth);
+
+    /**
+     * Adds the class probabilities of a leaf to the pools, while compiling.
+     *
+     * @param index the slot of the leaf in mNodes
+     * @param dist the distribution the probabilities are taken from
+     * @param bag the bag of the distribution, -1 for all bags
+     */
+    void addLeaf(const int index, const Distribution &dist, const int bag);
+
+    /**
+     * Returns the son of an inner node an instance is passed to. A nominal
+     * value without a son is treated like a missing value.
+     *
+     * @param node the node
+     * @param value the instance's value of the tested attribute, not missing
+     * @return the index of the son, -1 if the value has no son
+     */
+    int son(const Node &node, const double value) const;
+
+    /**
+     * Computes the class distribution of an instance below a node.
+     *
+     * @param index the node
+     * @param instance the instance
+     * @param weight the weight of the instance at the node
+     * @param probs the probability pool of the leaves
+     * @param dist the array the distribution is written to
+     * @param scratch space for mNumClasses values per level below the node
+     */
+    void distribution(const int index, const Instance &instance, const double weight, const double *probs, double *dist, double *scratch) const;
+
+    /**
+     * Computes the class distributions of a block of instances whose values
+     * are held in the same column store. The instances are routed through
+     * the tree together, one level per pass, so that the lookups of
+     * different instances overlap instead of waiting for each other.
+     *
+     * @param batch the instances
+     * @param store the column store holding the instances
+     * @param start the first instance of the block
+     * @param count the number of instances in the block, at most BLOCK_SIZE
+     * @param columns the columns of the store holding the instances, null
+     *          for a column not held in doubles
+     * @param probs the probability pool of the leaves
+     * @param dist the row-major matrix the distributions of the batch are written to
+     * @param scratch space for mNumClasses values per level of the tree
+     */
+    void distributionsForBlock(Instances &batch, const ColumnStore &store, const int start, const int count, const double *const *columns, const double *probs, double *dist, double *scratch) const;
+
+    /**
+     * Returns scratch space for the distributions of missing values, large
+     * enough for every level of the tree.
+     *
+     * @return the scratch space of the calling thread
+     */
+    double *scratch() const;
+
+public:
+
+    /** The number of instances routed through the tree together. */
+    static const int BLOCK_SIZE = 256;
+
+    /**
+     * Creates the compiled copy of a built tree.
+     *
+     * @param tree the root of the tree
+     * @param header the structure of the data the tree was built from
+     * @throws Exception if the tree contains a split model that cannot be compiled
+     */
+    CompiledTree(const ClassifierTree &tree, const Instances &header);
+
+    /**
+     * Destructor, unmaps the file of a mapped tree.
+     */
+    ~CompiledTree();
+
+    /**
+     * Saves the tree in the layout map() reads.
+     *
+     * @param os the stream to write to, opened in binary mode
+     * @param metadata data of the caller stored at the end of the file, e.g.
+     *          the structure of the training data
+     */
+    void save(std::ostream &os, const string &metadata) const;
+
+    /**
+     * Maps a tree saved by save(). The tree classifies directly on the
+     * mapping, which is released when the tree is deleted.
+     *
+     * @param path the file to map
+     * @return the mapped tree
+     * @throws Exception if the file cannot be mapped or is not a valid
+     *           compiled tree of this byte order
+     */
+    static CompiledTree *map(const string &path);
+
+    /**
+     * Returns the caller-defined data saved with the tree.
+     *
+     * @return the start of the data, inside the mapping; null for a tree
+     *         compiled in memory
+     */
+    const char *metadata() const;
+
+    /**
+     * Returns the size of the caller-defined data saved with the tree.
+     *
+     * @return the number of bytes
+     */
+    size_t metadataSize() const;
+
+    /**
+     * Returns the number of attributes of the data the tree was built from.
+     *
+     * @return the number of attributes
+     */
+    int numAttributes() const;
+
+    /**
+     * Returns the index of the class attribute of the data the tree was built from.
+     *
+     * @return the class index
+     */
+    int classIndex() const;
+
+    /**
+     * Returns the number of classes.
+     *
+     * @return the number of classes
+     */
+    int numClasses() const;
+
+    /**
+     * Returns the number of nodes, including a leaf for every empty son.
+     *
+     * @return the number of nodes
+     */
+    int numNodes() const;
+
+    /**
+     * Computes the class probabilities of an instance.
+     *
+     * @param instance the instance to get the distribution for
+     * @param useLaplace whether to use the Laplace-corrected probabilities
+     * @param dist the array of numClasses() values the distribution is written to
+     */
+    void distributionForInstance(const Instance &instance, const bool useLaplace, double *dist) const;
+
+    /**
+     * Returns class probabilities for an instance.
+     *
+     * @param instance the instance to get the distribution for
+     * @param useLaplace whether to use the Laplace-corrected probabilities
+     * @return the distribution
+     */
+    double_array distributionForInstance(const Instance &instance, const bool useLaplace) const;
+
+    /**
+     * Computes the class probabilities of all instances of a batch. The
+     * distributions are the ones distributionForInstance() computes.
+     *
+     * @param batch the instances to get the distributions for
+     * @param useLaplace whether to use the Laplace-corrected probabilities
+     * @param dist the row-major matrix of numInstances() x numClasses()
+     *          values the distributions are written to
+     */
+    void distributionsForInstances(Instances &batch, const bool useLaplace, double *dist) const;
+
+    /**
+     * Classifies an instance.
+     *
+     * @param instance the instance to classify
+     * @return the classification
+     */
+    double classifyInstance(const Instance &instance) const;
+
+private:
+
+    CompiledTree(const CompiledTree&);
+    CompiledTree &operator=(const CompiledTree&);
+};
+
+#endif    // _COMPILEDTREE_
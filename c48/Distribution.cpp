@@ -1,33 +1,52 @@
 #include "Distribution.h"
 #include "core/Instances.h"
+#include "core/InstancesView.h"
 #include "ClassifierSplitModel.h"
 #include "core/Instance.h"
 #include "core/Utils.h"
+#include "core/BinaryWriter.h"
+#include "core/BinaryReader.h"
 #include <iterator>
+#include <algorithm>
 
-Distribution::Distribution(int numBags, int numClasses) :
-    mperBag(double_array(numBags)),
-    mperClass(double_array(numClasses))
+std::atomic<long> Distribution::NUM_LIVE(0);
+
+void *Distribution::operator new(size_t size) {
+
+    void *p = ::operator new(size);
+    NUM_LIVE++;
+    return p;
+}
+
+void Distribution::operator delete(void *p) {
+
+    if (p == nullptr)
+        return;
+    NUM_LIVE--;
+    ::operator delete(p);
+}
+
+long Distribution::numLive() {
+
+    return NUM_LIVE;
+}
+
+Distribution::Distribution(int numBags, int numClasses)
 {
-    for (int i = 0; i < numBags; i++)
-    {
-        this->mperClassPerBag.push_back( double_array(numClasses));
-    }
-    totaL = 0;
+    allocate(numBags, numClasses);
 }
 
-Distribution::Distribution(double_2D_array &table) :
-    mperClassPerBag(table),
-    mperBag(double_array(table.size())),
-    mperClass(double_array(table[0].size()))
+Distribution::Distribution(double_2D_array &table)
 {
 
     int i, j;
 
+    allocate((int)table.size(), (int)table[0].size());
     for (i = 0; i < (int)table.size(); i++)
     {
         for (j = 0; j < (int)table[i].size(); j++)
         {
+            mperClassPerBag[i * mNumClasses + j] = table[i][j];
             mperBag[i] += table[i][j];
             mperClass[j] += table[i][j];
             totaL += table[i][j];
@@ -35,15 +54,9 @@ Distribution::Distribution(double_2D_array &table) :
     }
 }
 
-Distribution::Distribution(Instances &source) :
-    mperBag(double_array(1)),
-    mperClass(double_array(source.numClasses()))
+Distribution::Distribution(Instances &source)
 {
-    // Clear 
-    mperClassPerBag.clear();
-
-    totaL = 0;
-    mperClassPerBag.push_back(double_array(source.numClasses()));
+    allocate(1, source.numClasses());
     int totalnum = source.numInstances();
     for (int i = 0; i < totalnum; i++)
     {
@@ -51,20 +64,13 @@ Distribution::Distribution(Instances &source) :
     }
 }
 
-Distribution::Distribution(Instances &source, ClassifierSplitModel &modelToUse) :
-    mperBag(double_array(modelToUse.numSubsets())),
-    mperClass(double_array(source.numClasses())) {
+Distribution::Distribution(Instances &source, ClassifierSplitModel &modelToUse) {
 
     int index;
 
     double_array weights;
 
-    // Clear 
-    mperClassPerBag.clear();
-    totaL = 0;
-    for (int i = 0; i < modelToUse.numSubsets(); i++) {
-        mperClassPerBag.push_back(double_array(source.numClasses()));
-    }
+    allocate(modelToUse.numSubsets(), source.numClasses());
     int totalnum = source.numInstances();
     for (int i = 0; i < totalnum; i++)
     {
@@ -79,46 +85,114 @@ Distribution::Distribution(Instances &source, ClassifierSplitModel &modelToUse)
     }
 }
 
-Distribution::Distribution(Distribution *toMerge) 
+Distribution::Distribution(const InstancesView &source)
+{
+    allocate(1, source.numClasses());
+    int totalnum = source.numInstances();
+    for (int i = 0; i < totalnum; i++)
+    {
+        add(0, static_cast<int>(source.classValue(i)), source.weight(i));
+    }
+}
+
+Distribution::Distribution(const InstancesView &source, const ClassifierSplitModel &modelToUse)
+{
+    allocate(modelToUse.numSubsets(), source.numClasses());
+    int totalnum = source.numInstances();
+    for (int i = 0; i < totalnum; i++)
+    {
+        Instance &instance = source.instance(i);
+        int index = modelToUse.whichSubset(instance);
+        if (index != -1)
+        {
+            add(index, static_cast<int>(instance.classValue()), source.weight(i));
+        }
+        else
+        {
+            addWeights(static_cast<int>(instance.classValue()), source.weight(i), modelToUse.weights(instance));
+        }
+    }
+}
+
+Distribution::Distribution(Distribution *toMerge)
 {
-    mperClassPerBag.clear();
-    mperBag.clear();
-    mperClass.clear();
+    allocate(1, toMerge->mNumClasses);
     totaL = toMerge->totaL;
-    std::copy(toMerge->mperClass.begin(), toMerge->mperClass.end(), std::back_inserter(mperClass));
-    mperClassPerBag.push_back(double_array(toMerge->numClasses()));
-    std::copy(toMerge->mperClass.begin(), toMerge->mperClass.end(), std::back_inserter(mperClassPerBag[0]));
-    mperBag.push_back(totaL);
+    std::copy(toMerge->mperClass, toMerge->mperClass + mNumClasses, mperClass);
+    std::copy(toMerge->mperClass, toMerge->mperClass + mNumClasses, mperClassPerBag);
+    mperBag[0] = totaL;
 }
 
-Distribution::Distribution(Distribution *toMerge, int index) :
-    mperClassPerBag(double_2D_array(1)),
-    mperBag(double_array(2)),
-    mperClass(double_array(toMerge->numClasses()))
+Distribution::Distribution(Distribution *toMerge, int index)
 {
 
     int i;
 
+    allocate(2, toMerge->mNumClasses);
     totaL = toMerge->totaL;
-    std::copy(toMerge->mperClass.begin(), toMerge->mperClass.end(), std::back_inserter(mperClass));
-    mperClassPerBag[0] = double_array(toMerge->numClasses());
-    std::copy(toMerge->mperClassPerBag[index].begin(), toMerge->mperClassPerBag[index].end(), std::back_inserter(mperClassPerBag[0]));
-    mperClassPerBag[1] = double_array(toMerge->numClasses());
-    for (i = 0; i < toMerge->numClasses(); i++)
+    std::copy(toMerge->mperClass, toMerge->mperClass + mNumClasses, mperClass);
+    for (i = 0; i < mNumClasses; i++)
     {
-        mperClassPerBag[1][i] = toMerge->mperClass[i] - mperClassPerBag[0][i];
+        mperClassPerBag[i] = toMerge->mperClassPerBag[index * mNumClasses + i];
+        mperClassPerBag[mNumClasses + i] = toMerge->mperClass[i] - mperClassPerBag[i];
     }
     mperBag[0] = toMerge->mperBag[index];
     mperBag[1] = totaL - mperBag[0];
 }
 
+Distribution::Distribution(const Distribution &other)
+{
+    allocate(other.mNumBags, other.mNumClasses);
+    *this = other;
+}
+
+Distribution &Distribution::operator=(const Distribution &other)
+{
+    if (this != &other)
+    {
+        if (mNumBags != other.mNumBags || mNumClasses != other.mNumClasses)
+        {
+            allocate(other.mNumBags, other.mNumClasses);
+        }
+        // The block is laid out the same way in both.
+        size_t size = (size_t)(mNumBags + 1) * (mNumClasses + 1) - 1;
+        std::copy(other.mperClassPerBag, other.mperClassPerBag + size, mperClassPerBag);
+        totaL = other.totaL;
+    }
+    return *this;
+}
+
+void Distribution::allocate(int numBags, int numClasses)
+{
+    // bags x classes weights, then the bag totals and the class totals
+    size_t size = (size_t)(numBags + 1) * (numClasses + 1) - 1;
+    double *block;
+    if (size <= INLINE_SIZE)
+    {
+        double_array().swap(mHeap);
+        block = mInline;
+        std::fill(block, block + size, 0.0);
+    }
+    else
+    {
+        mHeap.assign(size, 0.0);
+        block = mHeap.data();
+    }
+    mNumBags = numBags;
+    mNumClasses = numClasses;
+    mperClassPerBag = block;
+    mperBag = block + (size_t)numBags * numClasses;
+    mperClass = mperBag + numBags;
+    totaL = 0;
+}
+
 int Distribution::actualNumBags() const
 {
 
     int returnValue = 0;
     int i;
 
-    for (i = 0; i < (int)mperBag.size(); i++)
+    for (i = 0; i < mNumBags; i++)
     {
         if (Utils::gr(mperBag[i], 0))
         {
@@ -135,7 +209,7 @@ int Distribution::actualNumClasses() const
     int returnValue = 0;
     int i;
 
-    for (i = 0; i < (int)mperClass.size(); i++)
+    for (i = 0; i < mNumClasses; i++)
     {
         if (Utils::gr(mperClass[i], 0))
         {
@@ -152,9 +226,9 @@ int Distribution::actualNumClasses(int bagIndex) const
     int returnValue = 0;
     int i;
 
-    for (i = 0; i < (int)mperClass.size(); i++)
+    for (i = 0; i < mNumClasses; i++)
     {
-        if (Utils::gr(mperClassPerBag[bagIndex][i], 0))
+        if (Utils::gr(mperClassPerBag[bagIndex * mNumClasses + i], 0))
         {
             returnValue++;
         }
@@ -171,7 +245,15 @@ void Distribution::add(int bagIndex, Instance &instance)
 
     classIndex = static_cast<int>(instance.classValue());
     weight = instance.weight();
-    mperClassPerBag[bagIndex][classIndex] = mperClassPerBag[bagIndex][classIndex] + weight;
+    mperClassPerBag[bagIndex * mNumClasses + classIndex] = mperClassPerBag[bagIndex * mNumClasses + classIndex] + weight;
+    mperBag[bagIndex] = mperBag[bagIndex] + weight;
+    mperClass[classIndex] = mperClass[classIndex] + weight;
+    totaL = totaL + weight;
+}
+
+void Distribution::add(int bagIndex, int classIndex, double weight)
+{
+    mperClassPerBag[bagIndex * mNumClasses + classIndex] = mperClassPerBag[bagIndex * mNumClasses + classIndex] + weight;
     mperBag[bagIndex] = mperBag[bagIndex] + weight;
     mperClass[classIndex] = mperClass[classIndex] + weight;
     totaL = totaL + weight;
@@ -185,7 +267,7 @@ void Distribution::sub(int bagIndex, Instance &instance)
 
     classIndex = static_cast<int>(instance.classValue());
     weight = instance.weight();
-    mperClassPerBag[bagIndex][classIndex] = mperClassPerBag[bagIndex][classIndex] - weight;
+    mperClassPerBag[bagIndex * mNumClasses + classIndex] = mperClassPerBag[bagIndex * mNumClasses + classIndex] - weight;
     mperBag[bagIndex] = mperBag[bagIndex] - weight;
     mperClass[classIndex] = mperClass[classIndex] - weight;
     totaL = totaL - weight;
@@ -198,7 +280,7 @@ void Distribution::add(int bagIndex, double_array &counts)
 
     for (int i = 0; i < (int)counts.size(); i++)
     {
-        mperClassPerBag[bagIndex][i] += counts[i];
+        mperClassPerBag[bagIndex * mNumClasses + i] += counts[i];
     }
     mperBag[bagIndex] = mperBag[bagIndex] + sum;
     for (int i = 0; i < (int)counts.size(); i++)
@@ -211,42 +293,73 @@ void Distribution::add(int bagIndex, double_array &counts)
 void Distribution::addInstWithUnknown(Instances &source, int attIndex)
 {
 
-    double_array probs;
-    double weight, newWeight;
-    int classIndex;
-    int j;
-
-    probs = double_array(mperBag.size());
-    for (j = 0; j < (int)mperBag.size(); j++)
+    double_array probs = unknownProbs();
+    int totalnum = source.numInstances();
+    for (int i = 0; i < totalnum; i++)
     {
-        if (Utils::eq(totaL, 0))
+
+        if (source.instance(i).isMissing(attIndex))
         {
-            probs[j] = 1.0 / probs.size();
+            addUnknown(probs, static_cast<int>(source.instance(i).classValue()), source.instance(i).weight());
         }
-        else
+    }
+
+}
+
+void Distribution::addInstWithUnknown(const InstancesView &source, int attIndex)
+{
+    if (!source.hasMissingValues(attIndex))
+    {
+        return;
+    }
+    double_array probs = unknownProbs();
+    int totalnum = source.numInstances();
+    for (int i = 0; i < totalnum; i++)
+    {
+        if (source.isMissing(i, attIndex))
         {
-            probs[j] = mperBag[j] / totaL;
+            addUnknown(probs, static_cast<int>(source.classValue(i)), source.weight(i));
         }
     }
+}
+
+void Distribution::addUnknown(const InstancesView &source)
+{
+    double_array probs = unknownProbs();
     int totalnum = source.numInstances();
     for (int i = 0; i < totalnum; i++)
     {
+        addUnknown(probs, static_cast<int>(source.classValue(i)), source.weight(i));
+    }
+}
 
-        if (source.instance(i).isMissing(attIndex))
+double_array Distribution::unknownProbs() const
+{
+    double_array probs(mNumBags);
+    for (int j = 0; j < mNumBags; j++)
+    {
+        if (Utils::eq(totaL, 0))
         {
-            classIndex = static_cast<int>(source.instance(i).classValue());
-            weight = source.instance(i).weight();
-            mperClass[classIndex] = mperClass[classIndex] + weight;
-            totaL = totaL + weight;
-            for (j = 0; j < (int)mperBag.size(); j++)
-            {
-                newWeight = probs[j] * weight;
-                mperClassPerBag[j][classIndex] = mperClassPerBag[j][classIndex] + newWeight;
-                mperBag[j] = mperBag[j] + newWeight;
-            }
+            probs[j] = 1.0 / probs.size();
+        }
+        else
+        {
+            probs[j] = mperBag[j] / totaL;
         }
     }
+    return probs;
+}
 
+void Distribution::addUnknown(const double_array &probs, int classIndex, double weight)
+{
+    mperClass[classIndex] = mperClass[classIndex] + weight;
+    totaL = totaL + weight;
+    for (int j = 0; j < mNumBags; j++)
+    {
+        double newWeight = probs[j] * weight;
+        mperClassPerBag[j * mNumClasses + classIndex] = mperClassPerBag[j * mNumClasses + classIndex] + newWeight;
+        mperBag[j] = mperBag[j] + newWeight;
+    }
 }
 
 void Distribution::addRange(int bagIndex, Instances &source, int startIndex, int lastPlusOne)
@@ -261,13 +374,27 @@ void Distribution::addRange(int bagIndex, Instances &source, int startIndex, int
         Instance &instance = source.instance(i);
         classIndex = static_cast<int>(instance.classValue());
         sumOfWeights = sumOfWeights + instance.weight();
-        mperClassPerBag[bagIndex][classIndex] += instance.weight();
+        mperClassPerBag[bagIndex * mNumClasses + classIndex] += instance.weight();
         mperClass[classIndex] += instance.weight();
     }
     mperBag[bagIndex] += sumOfWeights;
     totaL += sumOfWeights;
 }
 
+void Distribution::addRange(int bagIndex, const int_array &classes, const double_array &weights, int startIndex, int lastPlusOne)
+{
+    double sumOfWeights = 0;
+
+    for (int i = startIndex; i < lastPlusOne; i++)
+    {
+        sumOfWeights = sumOfWeights + weights[i];
+        mperClassPerBag[bagIndex * mNumClasses + classes[i]] += weights[i];
+        mperClass[classes[i]] += weights[i];
+    }
+    mperBag[bagIndex] += sumOfWeights;
+    totaL += sumOfWeights;
+}
+
 void Distribution::addWeights(Instance &instance, double_array &weights)
 {
 
@@ -275,23 +402,35 @@ void Distribution::addWeights(Instance &instance, double_array &weights)
     int i;
 
     classIndex = static_cast<int>(instance.classValue());
-    for (i = 0; i < (int)mperBag.size(); i++)
+    for (i = 0; i < mNumBags; i++)
     {
         double weight = instance.weight() * weights[i];
-        mperClassPerBag[i][classIndex] = mperClassPerBag[i][classIndex] + weight;
+        mperClassPerBag[i * mNumClasses + classIndex] = mperClassPerBag[i * mNumClasses + classIndex] + weight;
         mperBag[i] = mperBag[i] + weight;
         mperClass[classIndex] = mperClass[classIndex] + weight;
         totaL = totaL + weight;
     }
 }
 
+void Distribution::addWeights(int classIndex, double weight, const double_array &weights)
+{
+    for (int i = 0; i < mNumBags; i++)
+    {
+        double newWeight = weight * weights[i];
+        mperClassPerBag[i * mNumClasses + classIndex] = mperClassPerBag[i * mNumClasses + classIndex] + newWeight;
+        mperBag[i] = mperBag[i] + newWeight;
+        mperClass[classIndex] = mperClass[classIndex] + newWeight;
+        totaL = totaL + newWeight;
+    }
+}
+
 bool Distribution::check(double minNoObj) const
 {
 
     int counter = 0;
     int i;
 
-    for (i = 0; i < (int)mperBag.size(); i++)
+    for (i = 0; i < mNumBags; i++)
     {
         if (Utils::grOrEq(mperBag[i], minNoObj))
         {
@@ -313,16 +452,16 @@ bool Distribution::check(double minNoObj) const
 
     int i, j;
 
-    Distribution *newDistribution = new Distribution((int)mperBag.size(), (int)mperClass.size());
-    for (i = 0; i < (int)mperBag.size(); i++)
+    Distribution *newDistribution = new Distribution(mNumBags, mNumClasses);
+    for (i = 0; i < mNumBags; i++)
     {
         newDistribution->mperBag[i] = mperBag[i];
-        for (j = 0; j < (int)mperClass.size(); j++)
+        for (j = 0; j < mNumClasses; j++)
         {
-            newDistribution->mperClassPerBag[i][j] = mperClassPerBag[i][j];
+            newDistribution->mperClassPerBag[i * newDistribution->mNumClasses + j] = mperClassPerBag[i * mNumClasses + j];
         }
     }
-    for (j = 0; j < (int)mperClass.size(); j++)
+    for (j = 0; j < mNumClasses; j++)
     {
         newDistribution->mperClass[j] = mperClass[j];
     }
@@ -339,7 +478,7 @@ void Distribution::del(int bagIndex, Instance &instance)
 
     classIndex = static_cast<int>(instance.classValue());
     weight = instance.weight();
-    mperClassPerBag[bagIndex][classIndex] = mperClassPerBag[bagIndex][classIndex] - weight;
+    mperClassPerBag[bagIndex * mNumClasses + classIndex] = mperClassPerBag[bagIndex * mNumClasses + classIndex] - weight;
     mperBag[bagIndex] = mperBag[bagIndex] - weight;
     mperClass[classIndex] = mperClass[classIndex] - weight;
     totaL = totaL - weight;
@@ -356,7 +495,7 @@ void Distribution::delRange(int bagIndex, Instances &source, int startIndex, int
         Instance &instance = source.instance(i);
         classIndex = static_cast<int>(instance.classValue());
         sumOfWeights = sumOfWeights + instance.weight();
-        mperClassPerBag[bagIndex][classIndex] -= instance.weight();
+        mperClassPerBag[bagIndex * mNumClasses + classIndex] -= instance.weight();
         mperClass[classIndex] -= instance.weight();
     }
     mperBag[bagIndex] -= sumOfWeights;
@@ -369,12 +508,12 @@ string Distribution::dumpDistribution() const
     int i, j;
 
     text = "";
-    for (i = 0; i < (int)mperBag.size(); i++)
+    for (i = 0; i < mNumBags; i++)
     {
         text.append(string("Bag num ") + std::to_string(i) + string("\n"));
-        for (j = 0; j < (int)mperClass.size(); j++)
+        for (j = 0; j < mNumClasses; j++)
         {
-            text.append(string("Class num ") + std::to_string(j) + string(" ") + std::to_string(mperClassPerBag[i][j]) + string("\n"));
+            text.append(string("Class num ") + std::to_string(j) + string(" ") + std::to_string(mperClassPerBag[i * mNumClasses + j]) + string("\n"));
         }
     }
     return text;
@@ -383,19 +522,19 @@ string Distribution::dumpDistribution() const
 void Distribution::initialize()
 {
 
-    for (int i = 0; i < (int)mperClass.size(); i++)
+    for (int i = 0; i < mNumClasses; i++)
     {
         mperClass[i] = 0;
     }
-    for (int i = 0; i < (int)mperBag.size(); i++)
+    for (int i = 0; i < mNumBags; i++)
     {
         mperBag[i] = 0;
     }
-    for (int i = 0; i < (int)mperBag.size(); i++)
+    for (int i = 0; i < mNumBags; i++)
     {
-        for (int j = 0; j < (int)mperClass.size(); j++)
+        for (int j = 0; j < mNumClasses; j++)
         {
-            mperClassPerBag[i][j] = 0;
+            mperClassPerBag[i * mNumClasses + j] = 0;
         }
     }
     totaL = 0;
@@ -404,7 +543,12 @@ void Distribution::initialize()
 double_2D_array Distribution::matrix()
 {
 
-    return mperClassPerBag;
+    double_2D_array table(mNumBags);
+    for (int i = 0; i < mNumBags; i++)
+    {
+        table[i].assign(mperClassPerBag + i * mNumClasses, mperClassPerBag + (i + 1) * mNumClasses);
+    }
+    return table;
 }
 
 int Distribution::maxBag()  const
@@ -416,7 +560,7 @@ int Distribution::maxBag()  const
 
     max = 0;
     maxIndex = -1;
-    for (i = 0; i < (int)mperBag.size(); i++)
+    for (i = 0; i < mNumBags; i++)
     {
         if (Utils::grOrEq(mperBag[i], max))
         {
@@ -434,7 +578,7 @@ int Distribution::maxClass() const
     int maxIndex = 0;
     int i;
 
-    for (i = 0; i < (int)mperClass.size(); i++)
+    for (i = 0; i < mNumClasses; i++)
     {
         if (Utils::gr(mperClass[i], maxCount))
         {
@@ -455,11 +599,11 @@ int Distribution::maxClass(int index) const
 
     if (Utils::gr(mperBag[index], 0))
     {
-        for (i = 0; i < (int)mperClass.size(); i++)
+        for (i = 0; i < mNumClasses; i++)
         {
-            if (Utils::gr(mperClassPerBag[index][i], maxCount))
+            if (Utils::gr(mperClassPerBag[index * mNumClasses + i], maxCount))
             {
-                maxCount = mperClassPerBag[index][i];
+                maxCount = mperClassPerBag[index * mNumClasses + i];
                 maxIndex = i;
             }
         }
@@ -474,13 +618,13 @@ int Distribution::maxClass(int index) const
 int Distribution::numBags() const
 {
 
-    return (int)mperBag.size();
+    return mNumBags;
 }
 
 int Distribution::numClasses() const
 {
 
-    return (int)mperClass.size();
+    return mNumClasses;
 }
 
 double Distribution::numCorrect() const
@@ -492,7 +636,7 @@ double Distribution::numCorrect() const
 double Distribution::numCorrect(int index) const
 {
 
-    return mperClassPerBag[index][maxClass(index)];
+    return mperClassPerBag[index * mNumClasses + maxClass(index)];
 }
 
 double Distribution::numIncorrect() const
@@ -510,7 +654,7 @@ double Distribution::numIncorrect(int index) const
 double Distribution::perClassPerBag(int bagIndex, int classIndex) const
 {
 
-    return mperClassPerBag[bagIndex][classIndex];
+    return mperClassPerBag[bagIndex * mNumClasses + classIndex];
 }
 
 double Distribution::perBag(int bagIndex) const
@@ -523,9 +667,29 @@ double Distribution::perClass(int classIndex) const
     return mperClass[classIndex];
 }
 
+const double *Distribution::perClassPerBagArray(int bagIndex) const
+{
+    return mperClassPerBag + bagIndex * mNumClasses;
+}
+
+const double *Distribution::perBagArray() const
+{
+    return mperBag;
+}
+
+const double *Distribution::perClassArray() const
+{
+    return mperClass;
+}
+
+const double *Distribution::weightBlock() const
+{
+    return mperClassPerBag;
+}
+
 double Distribution::laplaceProb(int classIndex) const
 {
-    return (mperClass[classIndex] + 1) / (totaL + mperClass.size());
+    return (mperClass[classIndex] + 1) / (totaL + mNumClasses);
 }
 
 double Distribution::laplaceProb(int classIndex, int intIndex) const
@@ -533,7 +697,7 @@ double Distribution::laplaceProb(int classIndex, int intIndex) const
 
     if (Utils::gr(mperBag[intIndex], 0))
     {
-        return (mperClassPerBag[intIndex][classIndex] + 1.0) / (mperBag[intIndex] + mperClass.size());
+        return (mperClassPerBag[intIndex * mNumClasses + classIndex] + 1.0) / (mperBag[intIndex] + mNumClasses);
     }
     else
     {
@@ -560,7 +724,7 @@ double Distribution::prob(int classIndex, int intIndex) const
 
     if (Utils::gr(mperBag[intIndex], 0))
     {
-        return mperClassPerBag[intIndex][classIndex] / mperBag[intIndex];
+        return mperClassPerBag[intIndex * mNumClasses + classIndex] / mperBag[intIndex];
     }
     else
     {
@@ -571,14 +735,14 @@ double Distribution::prob(int classIndex, int intIndex) const
 Distribution *Distribution::subtract(Distribution *toSubstract)  const
 {
 
-    Distribution *newDist = new Distribution(1, (int)mperClass.size());
+    Distribution *newDist = new Distribution(1, mNumClasses);
 
     newDist->mperBag[0] = totaL - toSubstract->totaL;
     newDist->totaL = newDist->mperBag[0];
-    for (int i = 0; i < (int)mperClass.size(); i++)
+    for (int i = 0; i < mNumClasses; i++)
     {
-        newDist->mperClassPerBag[0][i] = mperClass[i] - toSubstract->mperClass[i];
-        newDist->mperClass[i] = newDist->mperClassPerBag[0][i];
+        newDist->mperClassPerBag[0 * newDist->mNumClasses + i] = mperClass[i] - toSubstract->mperClass[i];
+        newDist->mperClass[i] = newDist->mperClassPerBag[0 * newDist->mNumClasses + i];
     }
     return newDist;
 }
@@ -596,8 +760,8 @@ void Distribution::shift(int from, int to, Instance &instance)
 
     classIndex = static_cast<int>(instance.classValue());
     weight = instance.weight();
-    mperClassPerBag[from][classIndex] -= weight;
-    mperClassPerBag[to][classIndex] += weight;
+    mperClassPerBag[from * mNumClasses + classIndex] -= weight;
+    mperClassPerBag[to * mNumClasses + classIndex] += weight;
     mperBag[from] -= weight;
     mperBag[to] += weight;
 }
@@ -613,9 +777,87 @@ void Distribution::shiftRange(int from, int to, Instances &source, int startInde
         Instance &instance = source.instance(i);
         classIndex = static_cast<int>(instance.classValue());
         weight = instance.weight();
-        mperClassPerBag[from][classIndex] -= weight;
-        mperClassPerBag[to][classIndex] += weight;
+        mperClassPerBag[from * mNumClasses + classIndex] -= weight;
+        mperClassPerBag[to * mNumClasses + classIndex] += weight;
         mperBag[from] -= weight;
         mperBag[to] += weight;
     }
 }
+
+void Distribution::shiftRange(int from, int to, const int_array &classes, const double_array &weights, int startIndex, int lastPlusOne)
+{
+    double *fromCounts = mperClassPerBag + from * mNumClasses;
+    double *toCounts = mperClassPerBag + to * mNumClasses;
+    double fromTotal = mperBag[from];
+    double toTotal = mperBag[to];
+
+    for (int i = startIndex; i < lastPlusOne; i++)
+    {
+        fromCounts[classes[i]] -= weights[i];
+        toCounts[classes[i]] += weights[i];
+        fromTotal -= weights[i];
+        toTotal += weights[i];
+    }
+    mperBag[from] = fromTotal;
+    mperBag[to] = toTotal;
+}
+
+void Distribution::shiftCounts(int from, int to, const double *counts)
+{
+    double *fromCounts = mperClassPerBag + from * mNumClasses;
+    double *toCounts = mperClassPerBag + to * mNumClasses;
+    double fromTotal = mperBag[from];
+    double toTotal = mperBag[to];
+
+    for (int i = 0; i < mNumClasses; i++)
+    {
+        fromCounts[i] -= counts[i];
+        toCounts[i] += counts[i];
+        fromTotal -= counts[i];
+        toTotal += counts[i];
+    }
+    mperBag[from] = fromTotal;
+    mperBag[to] = toTotal;
+}
+
+void Distribution::serialize(BinaryWriter &writer) const
+{
+    // The sums are written as well, rather than recomputed on reading, so
+    // that a read distribution has exactly the same values.
+    writer.writeInt(numBags());
+    writer.writeInt(numClasses());
+    for (int i = 0; i < mNumBags; i++)
+    {
+        writer.writeDoubles(mperClassPerBag + i * mNumClasses, mNumClasses);
+    }
+    writer.writeDoubles(mperBag, mNumBags);
+    writer.writeDoubles(mperClass, mNumClasses);
+    writer.writeDouble(totaL);
+}
+
+Distribution *Distribution::deserialize(BinaryReader &reader, const Instances &header)
+{
+    int numBags = reader.readInt();
+    int numClasses = reader.readInt();
+    if (numBags < 1 || numClasses != header.numClasses() || (size_t)numBags * numClasses > reader.remaining() / sizeof(double))
+    {
+        throw string("Invalid distribution with ") + std::to_string(numBags) + " bags and " + std::to_string(numClasses) + " classes";
+    }
+    Distribution *result = new Distribution(numBags, numClasses);
+    try
+    {
+        for (int i = 0; i < numBags; i++)
+        {
+            reader.readDoubles(result->mperClassPerBag + i * numClasses, numClasses);
+        }
+        reader.readDoubles(result->mperBag, numBags);
+        reader.readDoubles(result->mperClass, numClasses);
+        result->totaL = reader.readDouble();
+    }
+    catch (...)
+    {
+        delete result;
+        throw;
+    }
+    return result;
+}
@@ -4,36 +4,86 @@
 #include <string>
 #include <vector>
 #include <stdexcept>
+#include <atomic>
+#include <cstddef>
 #include "core/Typedefs.h"
 
 class Instances;
+class InstancesView;
 class ClassifierSplitModel;
 class Instance;
+class BinaryWriter;
+class BinaryReader;
 
 
 /**
  * Class for handling a distribution of class values.
  *
+ * All weights are held in one contiguous block: the weights per class of
+ * each bag, bag after bag, then the weights per bag and the weights per
+ * class. Small distributions, e.g. those of binary splits on a few classes
+ * evaluated for every split point, keep the block inside the object and
+ * need no allocation of their own.
  */
 class Distribution
 {
 
 protected:
 
-    /** Weight of instances per class per bag. */
-    double_2D_array mperClassPerBag;
+    /** The number of values a distribution can hold without allocating. */
+    static const int INLINE_SIZE = 32;
+
+    /** Number of bags. */
+    int mNumBags;
+
+    /** Number of classes. */
+    int mNumClasses;
+
+    /** Weight of instances per class per bag, bag after bag. */
+    double *mperClassPerBag;
 
     /** Weight of instances per bag. */
-    double_array mperBag;
+    double *mperBag;
 
     /** Weight of instances per class. */
-    double_array mperClass;
+    double *mperClass;
 
     /** Total weight of instances. */
     double totaL = 0;
 
+    /** Holds the block of a distribution of at most INLINE_SIZE values. */
+    double mInline[INLINE_SIZE];
+
+    /** Holds the block of a larger distribution. */
+    double_array mHeap;
+
+    /** The number of distributions currently allocated on the heap. */
+    static std::atomic<long> NUM_LIVE;
+
+    /**
+     * Sets up the block for the given numbers of bags and classes, with all
+     * weights zero.
+     */
+    void allocate(int numBags, int numClasses);
+
 public:
 
+    /**
+     * Allocates a distribution on the heap, counting it as live.
+     */
+    static void *operator new(size_t size);
+
+    /**
+     * Frees a distribution allocated on the heap.
+     */
+    static void operator delete(void *p);
+
+    /**
+     * Returns the number of distributions currently allocated on the heap.
+     * Distributions on the stack or inside other objects are not counted.
+     */
+    static long numLive();
+
     /**
      * Creates and initializes a new distribution.
      */
@@ -61,6 +111,20 @@ public:
      */
     Distribution(Instances &source, ClassifierSplitModel &modelToUse);
 
+    /**
+     * Creates a distribution with only one bag according
+     * to the rows of the given view.
+     */
+    Distribution(const InstancesView &source);
+
+    /**
+     * Creates a distribution according to the rows of the given view and
+     * split model.
+     *
+     * @exception Exception if something goes wrong
+     */
+    Distribution(const InstancesView &source, const ClassifierSplitModel &modelToUse);
+
     /**
      * Creates distribution with only one bag by merging all
      * bags of given distribution.
@@ -73,6 +137,16 @@ public:
      */
     Distribution(Distribution *toMerge, int index);
 
+    /**
+     * Creates a copy of the given distribution.
+     */
+    Distribution(const Distribution &other);
+
+    /**
+     * Copies the given distribution into this one.
+     */
+    Distribution &operator=(const Distribution &other);
+
     /**
      * Returns number of non-empty bags of distribution.
      */
@@ -95,6 +169,11 @@ public:
      */
     void add(int bagIndex, Instance &instance);
 
+    /**
+     * Adds given weight for given class to given bag.
+     */
+    void add(int bagIndex, int classIndex, double weight);
+
     /**
      * Subtracts given instance from given bag.
      *
@@ -115,6 +194,36 @@ public:
      */
     void addInstWithUnknown(Instances &source, int attIndex);
 
+    /**
+     * Adds all rows of the view with unknown values for given attribute,
+     * weighted according to frequency of instances in each bag.
+     */
+    void addInstWithUnknown(const InstancesView &source, int attIndex);
+
+    /**
+     * Adds all rows of a view, spreading each over the bags in proportion
+     * to the weights of the bags as addInstWithUnknown() does, e.g. for rows
+     * already known to miss the value the bags are split on.
+     */
+    void addUnknown(const InstancesView &source);
+
+    /**
+     * Returns the proportions of the bags addInstWithUnknown() spreads the
+     * rows with unknown values over: the weights of the bags before any of
+     * those rows are added, or equal shares if the bags are empty.
+     */
+    double_array unknownProbs() const;
+
+    /**
+     * Adds a row with an unknown value, spread over the bags in the given
+     * proportions, e.g. for rows that are not at hand as a view.
+     *
+     * @param probs the proportions unknownProbs() returned
+     * @param classIndex the class of the row
+     * @param weight the weight of the row
+     */
+    void addUnknown(const double_array &probs, int classIndex, double weight);
+
     /**
      * Adds all instances in given range to given bag.
      *
@@ -122,6 +231,13 @@ public:
      */
     void addRange(int bagIndex, Instances &source, int startIndex, int lastPlusOne);
 
+    /**
+     * Adds all rows in given range of the class and weight columns to given bag.
+     *
+     * @exception Exception if something goes wrong
+     */
+    void addRange(int bagIndex, const int_array &classes, const double_array &weights, int startIndex, int lastPlusOne);
+
     /**
      * Adds given instance to all bags weighting it according to given weights.
      *
@@ -129,6 +245,12 @@ public:
      */
     void addWeights(Instance &instance, double_array &weights);
 
+    /**
+     * Adds given weight for given class to all bags weighting it according
+     * to given weights.
+     */
+    void addWeights(int classIndex, double weight, const double_array &weights);
+
     /**
      * Checks if at least two bags contain a minimum number of instances.
      */
@@ -224,6 +346,29 @@ public:
      */
     double perClass(int classIndex) const;
 
+    /**
+     * Returns the weights per class of the given bag as an array of
+     * numClasses() values.
+     */
+    const double *perClassPerBagArray(int bagIndex) const;
+
+    /**
+     * Returns the weights per bag as an array of numBags() values.
+     */
+    const double *perBagArray() const;
+
+    /**
+     * Returns the weights per class as an array of numClasses() values.
+     */
+    const double *perClassArray() const;
+
+    /**
+     * Returns the block of weights: numBags() x numClasses() weights per
+     * class per bag, bag after bag, followed by the numBags() weights per
+     * bag and the numClasses() weights per class.
+     */
+    const double *weightBlock() const;
+
     /**
      * Returns relative frequency of class over all bags with
      * Laplace correction.
@@ -270,6 +415,39 @@ public:
      */
     void shiftRange(int from, int to, Instances &source, int startIndex, int lastPlusOne);
 
+    /**
+     * Shifts all rows in given range of the class and weight columns from one
+     * bag to another one.
+     *
+     * @exception Exception if something goes wrong
+     */
+    void shiftRange(int from, int to, const int_array &classes, const double_array &weights, int startIndex, int lastPlusOne);
+
+    /**
+     * Shifts the given weights per class from one bag to another one.
+     *
+     * @param counts numClasses() weights
+     */
+    void shiftCounts(int from, int to, const double *counts);
+
+    /**
+     * Writes the distribution.
+     *
+     * @param writer the writer
+     */
+    void serialize(BinaryWriter &writer) const;
+
+    /**
+     * Reads a distribution written by serialize(), which must have as many
+     * classes as the header.
+     *
+     * @param reader the reader
+     * @param header the header of the training data
+     * @return the distribution
+     * @exception Exception if the data is invalid
+     */
+    static Distribution *deserialize(BinaryReader &reader, const Instances &header);
+
 };
 
 #endif    // _DISTRIBUTION_
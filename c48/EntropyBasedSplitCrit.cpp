@@ -1,52 +1,225 @@
 #include "EntropyBasedSplitCrit.h"
 #include "Distribution.h"
-//#include "core/ContingencyTables.h"
+#include "core/ContingencyTables.h"
+#include <algorithm>
 #include <cmath>
 
-double EntropyBasedSplitCrit::lnFunc(double num) const {
+// The AVX2 kernel is compiled for its own target and picked at run time
+// with GCC and Clang on x86; MSVC has it when building for AVX2.
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#ifdef __SSE2__
+#define C48_SSE2_KERNEL 1
+#else
+#define C48_SSE2_KERNEL 0
+#endif
+#define C48_AVX2_KERNEL 1
+#define C48_AVX2_TARGET __attribute__((target("avx2")))
+#elif defined(_MSC_VER) && defined(_M_X64)
+#include <immintrin.h>
+#define C48_SSE2_KERNEL 1
+#ifdef __AVX2__
+#define C48_AVX2_KERNEL 1
+#else
+#define C48_AVX2_KERNEL 0
+#endif
+#define C48_AVX2_TARGET
+#else
+#define C48_SSE2_KERNEL 0
+#define C48_AVX2_KERNEL 0
+#endif
+
+namespace {
+
+/** The natural log of 2, which the terms are divided by. */
+const double LN2 = log(2.0);
 
+/** Values below this are taken as zero by lnFunc(). */
+const double MIN_NUM = 1e-6;
+
+/**
+ * The term of a single value, as lnFunc() computes it.
+ */
+inline double lnTerm(double num)
+{
     // Constant hard coded for efficiency reasons
-    if (num < 1e-6) {
+    if (num < MIN_NUM) {
         return 0;
     }
     else {
-        //return ContingencyTables::lnFunc(num);
-        return num * log(num) / log(2);
+        // Integral weights, the usual case, need no log at all.
+        return ContingencyTables::lnFunc(num) / LN2;
     }
 }
 
-double EntropyBasedSplitCrit::oldEnt(Distribution &bags) const {
+void lnTermsScalar(const double *nums, int count, double *terms)
+{
+    for (int i = 0; i < count; i++) {
+        terms[i] = lnTerm(nums[i]);
+    }
+}
 
-    double returnValue = 0;
-    int j;
+#if C48_SSE2_KERNEL
+void lnTermsSSE2(const double *nums, int count, double *terms)
+{
+    const double *cache = ContingencyTables::intNLogNCacheData();
+    const __m128d minNum = _mm_set1_pd(MIN_NUM);
+    const __m128d cacheSize = _mm_set1_pd(ContingencyTables::intNLogNCacheSize());
+    const __m128d ln2 = _mm_set1_pd(LN2);
+    int i = 0;
+
+    for (; i + 2 <= count; i += 2) {
+        __m128d x = _mm_loadu_pd(nums + i);
+        __m128i n = _mm_cvttpd_epi32(x);
+
+        // Pairs of cached integers are looked up and divided together;
+        // anything else, zeros included, goes through lnTerm().
+        __m128d cached = _mm_and_pd(_mm_and_pd(_mm_cmpnlt_pd(x, minNum), _mm_cmplt_pd(x, cacheSize)),
+                                    _mm_cmpeq_pd(_mm_cvtepi32_pd(n), x));
+        if (_mm_movemask_pd(cached) == 3) {
+            __m128d values = _mm_set_pd(cache[_mm_cvtsi128_si32(_mm_shuffle_epi32(n, 1))], cache[_mm_cvtsi128_si32(n)]);
+            _mm_storeu_pd(terms + i, _mm_div_pd(values, ln2));
+        }
+        else {
+            terms[i] = lnTerm(nums[i]);
+            terms[i + 1] = lnTerm(nums[i + 1]);
+        }
+    }
+    lnTermsScalar(nums + i, count - i, terms + i);
+}
+#endif
+
+#if C48_AVX2_KERNEL
+C48_AVX2_TARGET
+void lnTermsAVX2(const double *nums, int count, double *terms)
+{
+    const double *cache = ContingencyTables::intNLogNCacheData();
+    const __m256d minNum = _mm256_set1_pd(MIN_NUM);
+    const __m256d cacheSize = _mm256_set1_pd(ContingencyTables::intNLogNCacheSize());
+    const __m256d ln2 = _mm256_set1_pd(LN2);
+    int i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m256d x = _mm256_loadu_pd(nums + i);
+        __m128i n = _mm256_cvttpd_epi32(x);
+
+        // Values below MIN_NUM fail the first test and get zero from the
+        // gather, which leaves them zero after the division. NaNs pass it,
+        // the compare being unordered, but fail the ordered cache bound and
+        // so take lnTerm() below like the scalar code.
+        __m256d nonZero = _mm256_cmp_pd(x, minNum, _CMP_NLT_UQ);
+        __m256d cached = _mm256_and_pd(_mm256_and_pd(nonZero, _mm256_cmp_pd(x, cacheSize, _CMP_LT_OQ)),
+                                       _mm256_cmp_pd(_mm256_cvtepi32_pd(n), x, _CMP_EQ_OQ));
+        __m256d values = _mm256_mask_i32gather_pd(_mm256_setzero_pd(), cache, n, cached, 8);
+        _mm256_storeu_pd(terms + i, _mm256_div_pd(values, ln2));
+
+        // Values that are not cached integers need a log of their own.
+        int logged = _mm256_movemask_pd(_mm256_andnot_pd(cached, nonZero));
+        while (logged != 0) {
+            int lane = 0;
+            while (((logged >> lane) & 1) == 0) {
+                lane++;
+            }
+            terms[i + lane] = lnTerm(nums[i + lane]);
+            logged &= logged - 1;
+        }
+    }
+    lnTermsScalar(nums + i, count - i, terms + i);
+}
+#endif
+
+typedef void (*LnTermsKernel)(const double *nums, int count, double *terms);
+
+/**
+ * Picks the widest kernel the processor runs.
+ */
+LnTermsKernel selectKernel()
+{
+#if C48_AVX2_KERNEL && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return lnTermsAVX2;
+    }
+#elif C48_AVX2_KERNEL
+    return lnTermsAVX2;
+#endif
+#if C48_SSE2_KERNEL
+    return lnTermsSSE2;
+#else
+    return lnTermsScalar;
+#endif
+}
+
+const LnTermsKernel lnTermsKernel = selectKernel();
+
+}
+
+const int EntropyBasedSplitCrit::TERMS_PER_PASS;
+
+double EntropyBasedSplitCrit::lnFunc(double num) const {
+
+    return lnTerm(num);
+}
+
+void EntropyBasedSplitCrit::lnTerms(const double *nums, int count, double *terms) const {
+
+    lnTermsKernel(nums, count, terms);
+}
 
-    for (j = 0; j < bags.numClasses(); j++) {
-        returnValue = returnValue + lnFunc(bags.perClass(j));
+double EntropyBasedSplitCrit::lnSum(double sum, const double *nums, int count) const {
+
+    // The terms are computed a pass at a time and added in order, so the
+    // sum rounds as it does when adding them one by one.
+    double terms[TERMS_PER_PASS];
+    for (int start = 0; start < count; start += TERMS_PER_PASS) {
+        int n = std::min(TERMS_PER_PASS, count - start);
+        lnTerms(nums + start, n, terms);
+        for (int i = 0; i < n; i++) {
+            sum = sum + terms[i];
+        }
     }
+    return sum;
+}
+
+double EntropyBasedSplitCrit::oldEnt(Distribution &bags) const {
+
+    double returnValue = lnSum(0, bags.perClassArray(), bags.numClasses());
+
     return lnFunc(bags.total()) - returnValue;
 }
 
 double EntropyBasedSplitCrit::newEnt(Distribution &bags) const {
 
     double returnValue = 0;
+    int numBags = bags.numBags();
+    int numClasses = bags.numClasses();
+    int count = numBags * numClasses + numBags;
     int i, j;
 
-    for (i = 0; i < bags.numBags(); i++) {
-        for (j = 0; j < bags.numClasses(); j++) {
-            returnValue = returnValue + lnFunc(bags.perClassPerBag(i, j));
+    if (count > TERMS_PER_PASS) {
+        for (i = 0; i < numBags; i++) {
+            returnValue = lnSum(returnValue, bags.perClassPerBagArray(i), numClasses);
+            returnValue = returnValue - lnFunc(bags.perBag(i));
+        }
+        return -returnValue;
+    }
+
+    // The weights per class of all bags are followed by the weights per
+    // bag, so the terms of a small distribution are computed in one pass.
+    double terms[TERMS_PER_PASS];
+    lnTerms(bags.weightBlock(), count, terms);
+    for (i = 0; i < numBags; i++) {
+        for (j = 0; j < numClasses; j++) {
+            returnValue = returnValue + terms[i * numClasses + j];
         }
-        returnValue = returnValue - lnFunc(bags.perBag(i));
+        returnValue = returnValue - terms[numBags * numClasses + i];
     }
     return -returnValue;
 }
 
 double EntropyBasedSplitCrit::splitEnt(Distribution &bags) const {
 
-    double returnValue = 0;
-    int i;
+    double returnValue = lnSum(0, bags.perBagArray(), bags.numBags());
 
-    for (i = 0; i < bags.numBags(); i++) {
-        returnValue = returnValue + lnFunc(bags.perBag(i));
-    }
     return lnFunc(bags.total()) - returnValue;
 }
@@ -11,6 +11,11 @@ class Distribution;
  */
 class EntropyBasedSplitCrit : public SplitCriterion {
 
+protected:
+
+    /** The number of terms computed at once by the sums. */
+    static const int TERMS_PER_PASS = 64;
+
 public:
 
     /**
@@ -18,6 +23,28 @@ public:
      */
     double lnFunc(double num) const;
 
+    /**
+     * Computes lnFunc() of each of the given values. The values are taken
+     * several at a time with AVX2 or SSE2 where the processor has them,
+     * looking integral values up in the cache of ContingencyTables at once;
+     * the results are exactly those of lnFunc().
+     *
+     * @param nums the values
+     * @param count the number of values
+     * @param terms the array the count results are written to
+     */
+    void lnTerms(const double *nums, int count, double *terms) const;
+
+    /**
+     * Adds lnFunc() of each of the given values to a sum, in order.
+     *
+     * @param sum the sum to add to
+     * @param nums the values
+     * @param count the number of values
+     * @return the new sum
+     */
+    double lnSum(double sum, const double *nums, int count) const;
+
     /**
      * Computes entropy of distribution before splitting.
      */
@@ -0,0 +1,87 @@
+#include "ErrorEstimator.h"
+#include "Stats.h"
+#include "core/Utils.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+ErrorEstimator::ErrorEstimator(float CF)
+{
+    mCF = CF;
+    mHasZ = CF > 0 && CF <= 0.5;
+    mZ = mHasZ ? Stats::normalInverse(1 - CF) : 0;
+    if (mHasZ)
+    {
+        mZeroErrors.resize(TABLE_SIZE);
+        mOneErrors.resize(TABLE_SIZE);
+        for (int n = 0; n < TABLE_SIZE; n++)
+        {
+            double N = n;
+            mZeroErrors[n] = N * (1 - pow(mCF, 1 / N));
+            mOneErrors[n] = addErrsForOne(N);
+        }
+    }
+}
+
+float ErrorEstimator::confidence() const
+{
+    return mCF;
+}
+
+double ErrorEstimator::addErrsForOne(double N) const
+{
+    if (1 + 0.5 >= N)
+    {
+        return std::max(N - 1, 0.0);
+    }
+    return Stats::addErrsNormal(N, 1, mHasZ ? mZ : Stats::normalInverse(1 - mCF));
+}
+
+double ErrorEstimator::addErrs(double N, double e) const
+{
+
+    // Ignore stupid values for CF
+    if (mCF > 0.5)
+    {
+        std::cout << "WARNING: confidence value for pruning too high. Error estimate not modified.";
+        return 0;
+    }
+
+    // The low end, interpolated between no error and one error
+    if (e < 1)
+    {
+        bool tabled = N >= 0 && N < mZeroErrors.size() && N == static_cast<int>(N);
+        double base = tabled ? mZeroErrors[static_cast<int>(N)] : N * (1 - pow(mCF, 1 / N));
+        if (e == 0)
+        {
+            return base;
+        }
+        double one = tabled ? mOneErrors[static_cast<int>(N)] : addErrsForOne(N);
+        return base + e * (one - base);
+    }
+
+    // The high end, where the continuity correction takes over
+    if (e + 0.5 >= N)
+    {
+        return std::max(N - e, 0.0);
+    }
+
+    return Stats::addErrsNormal(N, e, mHasZ ? mZ : Stats::normalInverse(1 - mCF));
+}
+
+double ErrorEstimator::estimatedErrors(double N, double e) const
+{
+    if (Utils::eq(N, 0))
+    {
+        return 0;
+    }
+    return e + addErrs(N, e);
+}
+
+void ErrorEstimator::estimatedErrors(const double *N, const double *e, double *result, int count) const
+{
+    for (int i = 0; i < count; i++)
+    {
+        result[i] = estimatedErrors(N[i], e[i]);
+    }
+}
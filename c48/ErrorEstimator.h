@@ -0,0 +1,91 @@
+#ifndef _ERRORESTIMATOR_
+#define _ERRORESTIMATOR_
+
+#include "core/Typedefs.h"
+
+/**
+ * Class for the pessimistic error estimates C4.5 prunes with, for one
+ * confidence value. The z-score of the confidence value is computed once,
+ * and the estimates for errors below one, which do not use the normal
+ * approximation, are looked up for integral numbers of instances. The
+ * estimates are the ones Stats::addErrs() gives, bit for bit.
+ */
+class ErrorEstimator
+{
+
+protected:
+
+    /** The number of integral instance counts whose low-end estimates are tabled. */
+    static const int TABLE_SIZE = 1024;
+
+    /** The confidence value. */
+    float mCF;
+
+    /** True if the z-score of the confidence value exists. */
+    bool mHasZ;
+
+    /** The z-score of the confidence value. */
+    double mZ;
+
+    /** The extra error for no observed error, by number of instances. */
+    double_array mZeroErrors;
+
+    /** The extra error for one observed error, by number of instances. */
+    double_array mOneErrors;
+
+    /**
+     * Computes the extra error for one observed error.
+     *
+     * @param N number of instances
+     * @return the extra error
+     */
+    double addErrsForOne(double N) const;
+
+public:
+
+    /**
+     * Creates the estimator for a confidence value.
+     *
+     * @param CF the confidence value
+     */
+    ErrorEstimator(float CF);
+
+    /**
+     * Returns the confidence value.
+     *
+     * @return the confidence value
+     */
+    float confidence() const;
+
+    /**
+     * Computes estimated extra error for given total number of instances
+     * and error, as Stats::addErrs() does.
+     *
+     * @param N number of instances
+     * @param e observed error
+     * @return the extra error
+     */
+    double addErrs(double N, double e) const;
+
+    /**
+     * Computes the estimated errors of a leaf, i.e. the observed error plus
+     * the extra error, or zero if the leaf has no instances.
+     *
+     * @param N number of instances
+     * @param e observed error
+     * @return the estimated errors
+     */
+    double estimatedErrors(double N, double e) const;
+
+    /**
+     * Computes the estimated errors of a number of leaves in one call.
+     *
+     * @param N the number of instances of each leaf
+     * @param e the observed error of each leaf
+     * @param result receives the estimated errors of each leaf
+     * @param count the number of leaves
+     */
+    void estimatedErrors(const double *N, const double *e, double *result, int count) const;
+};
+
+#endif    // _ERRORESTIMATOR_
@@ -46,13 +46,11 @@ double GainRatioSplitCrit::splitEnt(Distribution &bags, double totalnoInst) cons
 
     double returnValue = 0;
     double noUnknown;
-    int i;
 
     noUnknown = totalnoInst - bags.total();
     if (Utils::gr(bags.total(), 0)) {
-        for (i = 0; i < bags.numBags(); i++) {
-            returnValue = returnValue - lnFunc(bags.perBag(i));
-        }
+        // Negating the sum of the bags rounds exactly as subtracting them one by one.
+        returnValue = -lnSum(0, bags.perBagArray(), bags.numBags());
         returnValue = returnValue - lnFunc(noUnknown);
         returnValue = returnValue + lnFunc(totalnoInst);
     }
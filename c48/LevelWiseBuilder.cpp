@@ -0,0 +1,609 @@
+#include "LevelWiseBuilder.h"
+#include "ClassifierTree.h"
+#include "C45ModelSelection.h"
+#include "C45Split.h"
+#include "Distribution.h"
+#include "SortedInstances.h"
+#include "core/Attribute.h"
+#include "core/ColumnStore.h"
+#include "core/Instances.h"
+#include "core/ThreadPool.h"
+#include "core/Utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace
+{
+    /**
+     * Cuts the values in the given buckets into bins the way SortedInstances
+     * cuts the sorted values, as far as the buckets tell the values apart.
+     * Returns the first bucket a bin may close inside of, -1 once all bins
+     * are cut.
+     */
+    template <typename Bucket>
+    int cutBins(const std::vector<Bucket> &buckets, const double total, const int maxBins, double_array &lowers, double_array &uppers)
+    {
+        lowers.clear();
+        uppers.clear();
+        double cumulative = 0;
+        int numBuckets = (int)buckets.size();
+        for (int k = 0; k < numBuckets; k++)
+        {
+            const Bucket &bucket = buckets[k];
+            int bin = (int)uppers.size();
+            bool reachesShare = bin + 1 < maxBins && cumulative + bucket.weight >= total * (bin + 1) / maxBins;
+            if (bucket.min < bucket.max && reachesShare)
+            {
+                return k;
+            }
+            if (lowers.size() == uppers.size())
+            {
+                lowers.push_back(bucket.min);
+            }
+            cumulative += bucket.weight;
+            if (k == numBuckets - 1 || reachesShare)
+            {
+                uppers.push_back(bucket.max);
+            }
+        }
+        return -1;
+    }
+}
+
+const int LevelWiseBuilder::NO_SLOT;
+const int LevelWiseBuilder::SHARED;
+const size_t LevelWiseBuilder::MAX_COUNTS_PER_PASS;
+const int LevelWiseBuilder::FIRST_BITS;
+const int LevelWiseBuilder::NEXT_BITS;
+
+LevelWiseBuilder::LevelWiseBuilder(const ColumnStore &columns, Instances &header, const C45ModelSelection &selection, const int numBins, ThreadPool *threadPool) :
+    mColumns(columns),
+    mHeader(header, 0),
+    mSelection(selection),
+    mNumBins(numBins),
+    mThreadPool(threadPool),
+    mBins(nullptr)
+{
+    if (header.classIndex() < 0 || columns.classIndex() != header.classIndex() || !header.classAttribute().isNominal())
+    {
+        throw "Class attribute must be nominal and held in the class column!";
+    }
+}
+
+LevelWiseBuilder::~LevelWiseBuilder()
+{
+    delete mBins;
+}
+
+std::uint64_t LevelWiseBuilder::key(double value)
+{
+    // -0 is the same value as 0
+    if (value == 0)
+    {
+        value = 0;
+    }
+    std::uint64_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return ((bits >> 63) != 0) ? ~bits : (bits | (std::uint64_t(1) << 63));
+}
+
+template <typename Visit>
+void LevelWiseBuilder::forEachShare(const Visit &visit) const
+{
+    const double *weights = mColumns.weightColumn();
+    int numRows = mColumns.numRows();
+    size_t next = 0;
+    for (int row = 0; row < numRows; row++)
+    {
+        int slot = mSlots[row];
+        if (slot >= 0)
+        {
+            visit(row, slot, weights[row]);
+        }
+        else if (slot == SHARED)
+        {
+            for (; next < mShares.size() && mShares[next].row == row; next++)
+            {
+                visit(row, mShares[next].slot, mShares[next].weight);
+            }
+        }
+    }
+}
+
+void LevelWiseBuilder::parallelFor(const int size, const std::function<void(int)> &body) const
+{
+    if (mThreadPool != nullptr)
+    {
+        mThreadPool->parallelFor(size, body);
+        return;
+    }
+    for (int i = 0; i < size; i++)
+    {
+        body(i);
+    }
+}
+
+void LevelWiseBuilder::refineBuckets(const int attIndex, std::vector<Bucket> &buckets, const int_array &expand) const
+{
+    int numExpand = (int)expand.size();
+    std::vector<std::uint64_t> firsts(numExpand), lasts(numExpand);
+    int_array childBits(numExpand), shifts(numExpand);
+    std::vector<size_t> offsets(numExpand + 1, 0);
+    for (int e = 0; e < numExpand; e++)
+    {
+        const Bucket &bucket = buckets[expand[e]];
+        firsts[e] = bucket.first;
+        lasts[e] = bucket.first | (~std::uint64_t(0) >> bucket.bits);
+        childBits[e] = (bucket.bits == 0) ? FIRST_BITS : std::min(NEXT_BITS, 64 - bucket.bits);
+        shifts[e] = 64 - bucket.bits - childBits[e];
+        offsets[e + 1] = offsets[e] + ((size_t)1 << childBits[e]);
+    }
+
+    // Count the rows of the buckets to split by the next bits of their keys.
+    double_array weights(offsets[numExpand], 0);
+    double_array mins(offsets[numExpand], std::numeric_limits<double>::infinity());
+    double_array maxs(offsets[numExpand], -std::numeric_limits<double>::infinity());
+    const int *classes = mColumns.classColumn();
+    const double *rowWeights = mColumns.weightColumn();
+    int numRows = mColumns.numRows();
+    for (int row = 0; row < numRows; row++)
+    {
+        if (classes[row] < 0 || mColumns.isMissing(row, attIndex))
+        {
+            continue;
+        }
+        double value = mColumns.value(row, attIndex);
+        std::uint64_t bits = key(value);
+        int e = (int)(std::upper_bound(firsts.begin(), firsts.end(), bits) - firsts.begin()) - 1;
+        if (e < 0 || bits > lasts[e])
+        {
+            continue;
+        }
+        size_t index = offsets[e] + (size_t)((bits >> shifts[e]) & ((std::uint64_t(1) << childBits[e]) - 1));
+        weights[index] += rowWeights[row];
+        mins[index] = std::min(mins[index], value);
+        maxs[index] = std::max(maxs[index], value);
+    }
+
+    // Replace them by their non-empty parts.
+    std::vector<Bucket> refined;
+    refined.reserve(buckets.size());
+    int e = 0;
+    for (int k = 0; k < (int)buckets.size(); k++)
+    {
+        if (e == numExpand || expand[e] != k)
+        {
+            refined.push_back(buckets[k]);
+            continue;
+        }
+        for (size_t child = 0; child < ((size_t)1 << childBits[e]); child++)
+        {
+            size_t index = offsets[e] + child;
+            if (mins[index] <= maxs[index])
+            {
+                Bucket part = { buckets[k].first | ((std::uint64_t)child << shifts[e]), buckets[k].bits + childBits[e], weights[index], mins[index], maxs[index] };
+                refined.push_back(part);
+            }
+        }
+        e++;
+    }
+    buckets.swap(refined);
+}
+
+void LevelWiseBuilder::findBins(const int attIndex, double_array &lowers, double_array &uppers) const
+{
+    // One bucket holds all values at first.
+    Bucket all = { 0, 0, 0, 0, 0 };
+    std::vector<Bucket> buckets(1, all);
+    int_array expand(1, 0);
+    while (true)
+    {
+        refineBuckets(attIndex, buckets, expand);
+        double_array ends(buckets.size());
+        double total = 0;
+        for (size_t k = 0; k < buckets.size(); k++)
+        {
+            total += buckets[k].weight;
+            ends[k] = total;
+        }
+        int ambiguous = cutBins(buckets, total, mNumBins, lowers, uppers);
+        if (ambiguous < 0)
+        {
+            return;
+        }
+
+        // Refine the buckets the weight reaches the share of a bin in along
+        // with that one, as most bins close there whatever came before, so
+        // that the scans needed do not grow with the number of bins.
+        bool_array marked(buckets.size(), false);
+        marked[ambiguous] = true;
+        for (int bin = 0; bin + 1 < mNumBins; bin++)
+        {
+            size_t k = std::lower_bound(ends.begin(), ends.end(), total * (bin + 1) / mNumBins) - ends.begin();
+            if (k < buckets.size() && buckets[k].min < buckets[k].max)
+            {
+                marked[k] = true;
+            }
+        }
+        expand.clear();
+        for (size_t k = 0; k < buckets.size(); k++)
+        {
+            if (marked[k])
+            {
+                expand.push_back((int)k);
+            }
+        }
+    }
+}
+
+void LevelWiseBuilder::grow(ClassifierTree &root)
+{
+    int numAttributes = mHeader.numAttributes();
+    int numClasses = mHeader.numClasses();
+    int numRows = mColumns.numRows();
+    const int *classes = mColumns.classColumn();
+    const double *weights = mColumns.weightColumn();
+
+    // bin the numeric attributes once for the whole tree
+    if (mBins == nullptr)
+    {
+        std::vector<double_array> lowers(numAttributes), uppers(numAttributes);
+        bool_array binned(numAttributes, false);
+        for (int i = 0; i < numAttributes; i++)
+        {
+            binned[i] = (i != mHeader.classIndex()) && mHeader.attribute(i).isNumeric();
+        }
+        parallelFor(numAttributes, [&](int i)
+        {
+            if (binned[i])
+            {
+                findBins(i, lowers[i], uppers[i]);
+            }
+        });
+        mBins = new SortedInstances(std::move(lowers), std::move(uppers), binned);
+    }
+
+    // the root holds the rows with a known class; its sons share its arena
+    root.arena();
+    mSlots.assign(numRows, NO_SLOT);
+    mShares.clear();
+    std::vector<ClassifierTree*> level(1, &root);
+    std::vector<Distribution*> distributions(1, new Distribution(1, numClasses));
+    for (int row = 0; row < numRows; row++)
+    {
+        if (classes[row] >= 0)
+        {
+            mSlots[row] = 0;
+            distributions[0]->add(0, classes[row], weights[row]);
+        }
+    }
+
+    while (!level.empty())
+    {
+        std::vector<ClassifierSplitModel*> models = selectModels(distributions);
+        addUnknowns(models);
+
+        // the sons of the splits make up the next level
+        std::vector<ClassifierTree*> nextLevel;
+        int_array firstSons(level.size(), -1);
+        for (size_t i = 0; i < level.size(); i++)
+        {
+            ClassifierTree &node = *level[i];
+            node.mLocalModel = models[i];
+            node.mIsLeaf = models[i]->numSubsets() <= 1;
+            node.mIsEmpty = node.mIsLeaf && Utils::eq(models[i]->getDistribution()->total(), 0);
+            if (!node.mIsLeaf)
+            {
+                firstSons[i] = (int)nextLevel.size();
+                node.mSons = std::vector<ClassifierTree*>(models[i]->numSubsets());
+                for (ClassifierTree *&son : node.mSons)
+                {
+                    son = node.getEmptyTree();
+                    nextLevel.push_back(son);
+                }
+            }
+        }
+        distributions = route(models, firstSons, (int)nextLevel.size());
+        level.swap(nextLevel);
+    }
+    mSlots = int_array();
+    mShares = std::vector<Share>();
+
+    if (mSelection.relocatesSplitPoints())
+    {
+        relocateSplitPoints(root);
+    }
+}
+
+std::vector<ClassifierSplitModel*> LevelWiseBuilder::selectModels(std::vector<Distribution*> &distributions) const
+{
+    int numSlots = (int)distributions.size();
+    int numAttributes = mHeader.numAttributes();
+    int numClasses = mHeader.numClasses();
+    const int *classes = mColumns.classColumn();
+    std::vector<ClassifierSplitModel*> models(numSlots, nullptr);
+
+    // Only nodes that may split need their counts per bin or value; as
+    // many of them are counted in a pass as the memory allows.
+    int_array open;
+    for (int i = 0; i < numSlots; i++)
+    {
+        if (!mSelection.isLeaf(*distributions[i]))
+        {
+            open.push_back(i);
+        }
+    }
+    std::vector<size_t> sizes(numAttributes, 0);
+    size_t countsPerNode = 0;
+    for (int i = 0; i < numAttributes; i++)
+    {
+        if (i != mHeader.classIndex())
+        {
+            const Attribute &attribute = mHeader.attribute(i);
+            sizes[i] = (size_t)(attribute.isNominal() ? attribute.numValues() : mBins->numBins(i)) * numClasses;
+            countsPerNode += sizes[i];
+        }
+    }
+    size_t batchSize = std::max((size_t)1, MAX_COUNTS_PER_PASS / std::max((size_t)1, countsPerNode));
+
+    int_array batchOf(numSlots, -1);
+    for (size_t first = 0; first < open.size(); first += batchSize)
+    {
+        int count = (int)std::min(batchSize, open.size() - first);
+        for (int b = 0; b < count; b++)
+        {
+            batchOf[open[first + b]] = b;
+        }
+        std::vector<std::vector<double_array>> histograms(count, std::vector<double_array>(numAttributes));
+        parallelFor(numAttributes, [&](int att)
+        {
+            if (sizes[att] == 0)
+            {
+                return;
+            }
+            for (int b = 0; b < count; b++)
+            {
+                histograms[b][att].assign(sizes[att], 0);
+            }
+            bool nominal = mHeader.attribute(att).isNominal();
+            forEachShare([&](int row, int slot, double weight)
+            {
+                int b = batchOf[slot];
+                if (b < 0 || mColumns.isMissing(row, att))
+                {
+                    return;
+                }
+                double value = mColumns.value(row, att);
+                int index = nominal ? static_cast<int>(value) : mBins->binOf(att, value);
+                histograms[b][att][index * numClasses + classes[row]] += weight;
+            });
+        });
+        parallelFor(count, [&](int b)
+        {
+            int slot = open[first + b];
+            SortedInstances *counts = mBins->withCounts(std::move(histograms[b]), distributions[slot]);
+            distributions[slot] = nullptr;
+            models[slot] = mSelection.selectModelFromCounts(mHeader, *counts);
+            delete counts;
+        });
+        for (int b = 0; b < count; b++)
+        {
+            batchOf[open[first + b]] = -1;
+        }
+    }
+
+    // the others become leaves
+    for (int i = 0; i < numSlots; i++)
+    {
+        if (distributions[i] != nullptr)
+        {
+            SortedInstances *counts = mBins->withCounts(std::vector<double_array>(numAttributes), distributions[i]);
+            distributions[i] = nullptr;
+            models[i] = mSelection.selectModelFromCounts(mHeader, *counts);
+            delete counts;
+        }
+    }
+    return models;
+}
+
+void LevelWiseBuilder::addUnknowns(const std::vector<ClassifierSplitModel*> &models) const
+{
+    const int *classes = mColumns.classColumn();
+    int_array attributes(models.size(), -1);
+    std::vector<double_array> probs(models.size());
+    bool anyUnknown = false;
+    for (size_t i = 0; i < models.size(); i++)
+    {
+        C45Split *split = dynamic_cast<C45Split*>(models[i]);
+        if (split != nullptr && mColumns.numMissing(split->attIndex()) > 0)
+        {
+            attributes[i] = split->attIndex();
+            probs[i] = split->getDistribution()->unknownProbs();
+            anyUnknown = true;
+        }
+    }
+    if (!anyUnknown)
+    {
+        return;
+    }
+    forEachShare([&](int row, int slot, double weight)
+    {
+        if (attributes[slot] >= 0 && mColumns.isMissing(row, attributes[slot]))
+        {
+            models[slot]->getDistribution()->addUnknown(probs[slot], classes[row], weight);
+        }
+    });
+}
+
+std::vector<Distribution*> LevelWiseBuilder::route(const std::vector<ClassifierSplitModel*> &models, const int_array &firstSons, const int numSons)
+{
+    int numClasses = mHeader.numClasses();
+    int numRows = mColumns.numRows();
+    const int *classes = mColumns.classColumn();
+    const double *weights = mColumns.weightColumn();
+    std::vector<Distribution*> distributions(numSons);
+    for (int j = 0; j < numSons; j++)
+    {
+        distributions[j] = new Distribution(1, numClasses);
+    }
+    std::vector<const C45Split*> splits(models.size(), nullptr);
+    std::vector<double_array> missingWeights(models.size());
+    for (size_t i = 0; i < models.size(); i++)
+    {
+        if (firstSons[i] >= 0)
+        {
+            splits[i] = dynamic_cast<const C45Split*>(models[i]);
+            missingWeights[i] = splits[i]->missingWeights();
+        }
+    }
+
+    // A row goes to the son its value selects, or with part of its weight
+    // to every son if the value is missing, as ClassifierSplitModel::split()
+    // sends it.
+    std::vector<Share> shares, rowShares;
+    auto routeShare = [&](int row, int slot, double weight)
+    {
+        const C45Split *split = splits[slot];
+        if (split == nullptr)
+        {
+            return;
+        }
+        int att = split->attIndex();
+        if (mColumns.isMissing(row, att))
+        {
+            for (int j = 0; j < split->numSubsets(); j++)
+            {
+                if (Utils::gr(missingWeights[slot][j], 0))
+                {
+                    Share share = { row, firstSons[slot] + j, missingWeights[slot][j] * weight };
+                    rowShares.push_back(share);
+                }
+            }
+            return;
+        }
+        double value = mColumns.value(row, att);
+        int subset;
+        if (mHeader.attribute(att).isNominal())
+        {
+            subset = static_cast<int>(value);
+        }
+        else
+        {
+            subset = Utils::smOrEq(value, split->splitPoint()) ? 0 : 1;
+        }
+        Share share = { row, firstSons[slot] + subset, weight };
+        rowShares.push_back(share);
+    };
+    size_t next = 0;
+    for (int row = 0; row < numRows; row++)
+    {
+        int slot = mSlots[row];
+        if (slot == NO_SLOT)
+        {
+            continue;
+        }
+        rowShares.clear();
+        if (slot >= 0)
+        {
+            routeShare(row, slot, weights[row]);
+        }
+        else
+        {
+            for (; next < mShares.size() && mShares[next].row == row; next++)
+            {
+                routeShare(row, mShares[next].slot, mShares[next].weight);
+            }
+        }
+        for (const Share &share : rowShares)
+        {
+            distributions[share.slot]->add(0, classes[row], share.weight);
+        }
+        if (rowShares.empty())
+        {
+            mSlots[row] = NO_SLOT;
+        }
+        else if (rowShares.size() == 1 && rowShares[0].weight == weights[row])
+        {
+            mSlots[row] = rowShares[0].slot;
+        }
+        else
+        {
+            mSlots[row] = SHARED;
+            shares.insert(shares.end(), rowShares.begin(), rowShares.end());
+        }
+    }
+    mShares.swap(shares);
+    return distributions;
+}
+
+void LevelWiseBuilder::relocateSplitPoints(ClassifierTree &root) const
+{
+    int numAttributes = mHeader.numAttributes();
+    std::vector<std::vector<C45Split*>> splits(numAttributes);
+    std::vector<ClassifierTree*> nodes(1, &root);
+    while (!nodes.empty())
+    {
+        ClassifierTree *node = nodes.back();
+        nodes.pop_back();
+        if (node->mIsLeaf)
+        {
+            continue;
+        }
+        C45Split *split = dynamic_cast<C45Split*>(node->mLocalModel);
+        if (split != nullptr && mHeader.attribute(split->attIndex()).isNumeric())
+        {
+            splits[split->attIndex()].push_back(split);
+        }
+        nodes.insert(nodes.end(), node->mSons.begin(), node->mSons.end());
+    }
+
+    parallelFor(numAttributes, [&](int att)
+    {
+        if (splits[att].empty())
+        {
+            return;
+        }
+        double_array points;
+        for (C45Split *split : splits[att])
+        {
+            points.push_back(split->splitPoint());
+        }
+        std::sort(points.begin(), points.end());
+        points.erase(std::unique(points.begin(), points.end()), points.end());
+
+        // A value is up to all split points from some point on; it is kept
+        // for the first of them and carried over to the others afterwards.
+        double_array greatest(points.size(), -std::numeric_limits<double>::max());
+        int numRows = mColumns.numRows();
+        for (int row = 0; row < numRows; row++)
+        {
+            if (mColumns.isMissing(row, att))
+            {
+                continue;
+            }
+            double value = mColumns.value(row, att);
+            auto first = std::partition_point(points.begin(), points.end(), [value](double point)
+            {
+                return !Utils::smOrEq(value, point);
+            });
+            if (first != points.end())
+            {
+                double &best = greatest[first - points.begin()];
+                best = std::max(best, value);
+            }
+        }
+        for (size_t i = 1; i < greatest.size(); i++)
+        {
+            greatest[i] = std::max(greatest[i], greatest[i - 1]);
+        }
+        greatest.erase(std::unique(greatest.begin(), greatest.end()), greatest.end());
+
+        // Among these values a split point finds the one it finds among all.
+        for (C45Split *split : splits[att])
+        {
+            split->setSplitPoint(greatest);
+        }
+    });
+}
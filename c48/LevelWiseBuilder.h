@@ -0,0 +1,232 @@
+#ifndef _LEVELWISEBUILDER_
+#define _LEVELWISEBUILDER_
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "core/Typedefs.h"
+#include "core/InstancesView.h"
+
+// Forward class declarations:
+class ClassifierTree;
+class ClassifierSplitModel;
+class C45ModelSelection;
+class ColumnStore;
+class Distribution;
+class Instances;
+class SortedInstances;
+class ThreadPool;
+
+/**
+ * Class for growing a C4.5 tree from a data set too large for the memory,
+ * held in a column store mapped from its cache file. The tree is grown one
+ * level at a time in sequential passes over the columns, and no instance or
+ * view of the rows is ever created: besides the nodes of the tree the
+ * builder keeps only the node each row is at and the counts of the nodes of
+ * the current level.
+ *
+ * The numeric attributes are binned first, into the quantile bins
+ * SortedInstances cuts in memory. The values cannot be sorted here, so each
+ * attribute is scanned a few times instead, counting the weight of its
+ * values by ranges of their leading bits and refining only those ranges
+ * that a bin boundary may fall into, until every boundary is a value.
+ *
+ * Each level then takes one pass to count the class weights per bin or
+ * nominal value of the rows at its open nodes, or a few passes if the
+ * counts of all of them would take too much memory, and one pass to route
+ * the rows to the sons of the splits selected from the counts. Rows missing
+ * the value a split tests go down every branch with part of their weight,
+ * as they do in memory; the nodes are selected and their distributions
+ * summed in the same order, so that the tree is the one the binned splits
+ * give in memory without subtree raising.
+ */
+class LevelWiseBuilder
+{
+
+protected:
+
+    /** The slot of a row at no node of the level. */
+    static const int NO_SLOT = -1;
+
+    /** The slot of a row whose shares are kept in mShares. */
+    static const int SHARED = -2;
+
+    /** The largest number of counts taken by the nodes counted in one pass. */
+    static const size_t MAX_COUNTS_PER_PASS = 1 << 24;
+
+    /** The leading bits of the values told apart by the first scan of an attribute. */
+    static const int FIRST_BITS = 16;
+
+    /** The further bits told apart by each later scan. */
+    static const int NEXT_BITS = 8;
+
+    /**
+     * A share of a row at a node of the level, for rows at more than one
+     * node or at a node with part of their weight.
+     */
+    struct Share
+    {
+        /** The row. */
+        int row;
+
+        /** The node of the level. */
+        int slot;
+
+        /** The weight of the row at the node. */
+        double weight;
+    };
+
+    /** The values of an attribute whose keys share their leading bits. */
+    struct Bucket
+    {
+        /** The smallest key of the range. */
+        std::uint64_t first;
+
+        /** The number of leading bits the keys share. */
+        int bits;
+
+        /** The weight of the rows with a value in the range. */
+        double weight;
+
+        /** The smallest value in the range. */
+        double min;
+
+        /** The largest value in the range. */
+        double max;
+    };
+
+    /** The columns of the training data. */
+    const ColumnStore &mColumns;
+
+    /** The header of the training data, without rows. */
+    InstancesView mHeader;
+
+    /** The split selection method. */
+    const C45ModelSelection &mSelection;
+
+    /** The largest number of bins per numeric attribute. */
+    const int mNumBins;
+
+    /** The pool the attributes are scanned on, null to scan them in turn. */
+    ThreadPool *mThreadPool;
+
+    /** The bins of the numeric attributes, null until they are found. */
+    SortedInstances *mBins;
+
+    /** The node of the level each row is at, NO_SLOT or SHARED. */
+    int_array mSlots;
+
+    /** The shares of the SHARED rows, in ascending order of the rows. */
+    std::vector<Share> mShares;
+
+    /**
+     * Returns a key of a value that orders as the value does.
+     *
+     * @param value a known value
+     * @return the key
+     */
+    static std::uint64_t key(double value);
+
+    /**
+     * Calls visit(row, slot, weight) for every share of every row at a
+     * node of the level, in ascending order of the rows.
+     */
+    template <typename Visit>
+    void forEachShare(const Visit &visit) const;
+
+    /**
+     * Runs body(0) ... body(size - 1), on the thread pool if there is one.
+     */
+    void parallelFor(const int size, const std::function<void(int)> &body) const;
+
+    /**
+     * Splits the buckets of an attribute at the given indices by the next
+     * bits of their keys, in a scan of the attribute's column.
+     *
+     * @param attIndex the attribute's index
+     * @param buckets the buckets in ascending order of their keys
+     * @param expand the indices of the buckets to split, in ascending order
+     */
+    void refineBuckets(const int attIndex, std::vector<Bucket> &buckets, const int_array &expand) const;
+
+    /**
+     * Finds the quantile bins of a numeric attribute.
+     *
+     * @param attIndex the attribute's index
+     * @param lowers filled with the smallest value in each bin
+     * @param uppers filled with the largest value in each bin
+     */
+    void findBins(const int attIndex, double_array &lowers, double_array &uppers) const;
+
+    /**
+     * Selects the models of the nodes of a level from the counts of their
+     * rows.
+     *
+     * @param distributions the class distribution of each node, deleted here
+     * @return the model of each node
+     */
+    std::vector<ClassifierSplitModel*> selectModels(std::vector<Distribution*> &distributions) const;
+
+    /**
+     * Adds the rows missing the value a split tests to the distribution of
+     * the split, as C45ModelSelection does in memory.
+     *
+     * @param models the model of each node of the level
+     */
+    void addUnknowns(const std::vector<ClassifierSplitModel*> &models) const;
+
+    /**
+     * Moves the rows from the nodes of a level to the sons of their splits.
+     *
+     * @param models the model of each node of the level
+     * @param firstSons the slot of the first son of each node of the level
+     *          in the next level, -1 for a leaf
+     * @param numSons the number of nodes of the next level
+     * @return the class distribution of each node of the next level
+     */
+    std::vector<Distribution*> route(const std::vector<ClassifierSplitModel*> &models, const int_array &firstSons, const int numSons);
+
+    /**
+     * Relocates the split points of the numeric splits of a tree to the
+     * greatest value of the training data not above them, as
+     * C45ModelSelection does in memory, in a scan of each attribute split on.
+     *
+     * @param root the root of the tree
+     */
+    void relocateSplitPoints(ClassifierTree &root) const;
+
+public:
+
+    /**
+     * Creates a builder for the given training data.
+     *
+     * @param columns the columns of the training data; the class attribute
+     *          must be held in the class column
+     * @param header the header of the training data
+     * @param selection the split selection method, which must keep the
+     *          number of rows of the training data
+     * @param numBins the largest number of bins per numeric attribute
+     * @param threadPool the pool to scan the attributes on, may be null
+     */
+    LevelWiseBuilder(const ColumnStore &columns, Instances &header, const C45ModelSelection &selection, const int numBins, ThreadPool *threadPool);
+
+    /**
+     * Destructor.
+     */
+    ~LevelWiseBuilder();
+
+    /**
+     * Grows a tree from the training data. The tree is neither collapsed
+     * nor pruned.
+     *
+     * @param root the root of a tree that has not been built
+     */
+    void grow(ClassifierTree &root);
+
+private:
+
+    LevelWiseBuilder(const LevelWiseBuilder&);
+    LevelWiseBuilder &operator=(const LevelWiseBuilder&);
+};
+
+#endif    // _LEVELWISEBUILDER_
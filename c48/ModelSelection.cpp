@@ -1,6 +1,24 @@
 #include "ModelSelection.h"
 #include "ClassifierSplitModel.h"
 #include "core/Instances.h"
+#include "core/InstancesView.h"
+
+ModelSelection::~ModelSelection()
+{
+}
+
+ClassifierSplitModel *ModelSelection::selectModel(const InstancesView &data, const SortedInstances * /* sorted */) const
+{
+    Instances *instances = data.toInstances();
+    ClassifierSplitModel *model = selectModel(*instances);
+    delete instances;
+    return model;
+}
+
+ThreadPool *ModelSelection::threadPool() const
+{
+    return nullptr;
+}
 
 ClassifierSplitModel *ModelSelection::selectModel(Instances &train, Instances &test) const
 {
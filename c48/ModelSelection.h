@@ -5,6 +5,9 @@
 
 class ClassifierSplitModel;
 class Instances;
+class SortedInstances;
+class InstancesView;
+class ThreadPool;
 
 /**
  * Abstract class for model selection criteria.
@@ -14,6 +17,11 @@ class ModelSelection
 {
 
 public:
+    /**
+     * Destructor.
+     */
+    virtual ~ModelSelection();
+
     /**
      * Selects a model for the given dataset.
      *
@@ -21,12 +29,29 @@ public:
      */
     virtual ClassifierSplitModel *selectModel(Instances &data) const = 0;
 
+    /**
+     * Selects a model for the rows of the given view, using the given
+     * presorted orders of the numeric attributes if available. The default
+     * implementation copies the rows and calls selectModel(Instances&).
+     *
+     * @exception Exception if model can't be selected
+     */
+    virtual ClassifierSplitModel *selectModel(const InstancesView &data, const SortedInstances *sorted) const;
+
     /**
      * Selects a model for the given train data using the given test data
      *
      * @exception Exception if model can't be selected
      */
     virtual ClassifierSplitModel *selectModel(Instances &train, Instances &test) const;
+
+    /**
+     * Returns the pool models are selected on, which trees using this model
+     * selection also build their subtrees on.
+     *
+     * @return the pool, null if everything runs on the calling thread
+     */
+    virtual ThreadPool *threadPool() const;
 };
 
 #endif    //#ifndef _MODELSELECTION_
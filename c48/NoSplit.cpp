@@ -2,6 +2,7 @@
 #include "Distribution.h"
 #include "core/Instances.h"
 #include "core/Instance.h"
+#include "core/BinaryWriter.h"
 
 
 NoSplit::NoSplit(Distribution *distribution)
@@ -12,6 +13,7 @@ NoSplit::NoSplit(Distribution *distribution)
 
 void NoSplit::buildClassifier(Instances instances)
 {
+    delete mDistribution;
     mDistribution = new Distribution(instances);
     mNumSubsets = 1;
 }
@@ -41,3 +43,16 @@ string NoSplit::sourceExpression(const int index, Instances &data)
     return "true"; // or should this be false??
 }
 
+void NoSplit::serialize(BinaryWriter &writer) const
+{
+    writer.writeInt(NO_SPLIT);
+    mDistribution->serialize(writer);
+}
+
+NoSplit *NoSplit::deserialize(BinaryReader &reader, const Instances &header)
+{
+    Distribution *distribution = Distribution::deserialize(reader, header);
+    NoSplit *result = new NoSplit(distribution);
+    delete distribution;
+    return result;
+}
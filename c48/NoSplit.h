@@ -59,6 +59,23 @@ public:
      */
     string sourceExpression(const int index, Instances &data);
 
+    /**
+     * Writes the model.
+     *
+     * @param writer the writer
+     */
+    void serialize(BinaryWriter &writer) const override;
+
+    /**
+     * Reads a model written by serialize(), after its tag.
+     *
+     * @param reader the reader
+     * @param header the header of the training data
+     * @return the model
+     * @exception Exception if the data is invalid
+     */
+    static NoSplit *deserialize(BinaryReader &reader, const Instances &header);
+
 };
 
 #endif    //#ifndef _NOSPLIT_
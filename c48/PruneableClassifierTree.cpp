@@ -0,0 +1,150 @@
+#include "PruneableClassifierTree.h"
+#include "ModelSelection.h"
+#include "ClassifierSplitModel.h"
+#include "core/Instances.h"
+#include "core/InstancesView.h"
+#include "core/Instance.h"
+#include "Distribution.h"
+#include "core/Utils.h"
+#include "SortedInstances.h"
+#include "core/Arena.h"
+
+PruneableClassifierTree::PruneableClassifierTree(ModelSelection *toSelectLocModel, bool pruneTree, int num, bool cleanup, bool presort, int numBins, bool countTables) : ClassifierTree(toSelectLocModel)
+{
+    mPruneTheTree = pruneTree;
+    mNumSets = num;
+    mCleanup = cleanup;
+    mPresort = presort;
+    mNumBins = numBins;
+    mCountTables = countTables;
+}
+
+void PruneableClassifierTree::buildClassifier(Instances &data)
+{
+
+    if (data.classIndex() < 0)
+    {
+        throw "Class index is negative (not set)!";
+    }
+
+    // drop what a previous build kept
+    if (mArena != nullptr)
+    {
+        mArena->release();
+    }
+
+    // leave out instances with missing class, without copying the others,
+    // and stratify them so that the pruning set gets its share of each class
+    std::vector<Instance*> known;
+    known.reserve(data.numInstances());
+    for (int i = 0; i < data.numInstances(); i++)
+    {
+        if (!data.instance(i).classIsMissing())
+        {
+            known.push_back(&data.instance(i));
+        }
+    }
+    Instances stratified(&data, known);
+    stratified.stratify(mNumSets);
+
+    // the folds are copies, kept until the tree is cleaned up
+    Instances *train = keepInArena(stratified.trainCV(mNumSets, mNumSets - 1));
+    Instances *test = keepInArena(stratified.testCV(mNumSets, mNumSets - 1));
+    InstancesView trainView(*train);
+    InstancesView testView(*test);
+
+    SortedInstances *sorted = SortedInstances::forTree(trainView, mPresort, mNumBins, mCountTables);
+    buildTree(trainView, testView, sorted, !mCleanup);
+    if (mPruneTheTree)
+    {
+        prune();
+    }
+    if (mCleanup)
+    {
+        // the folds are no longer needed
+        dropTrainingData(data);
+    }
+}
+
+void PruneableClassifierTree::prune()
+{
+
+    if (!mIsLeaf)
+    {
+
+        // Prune all subtrees.
+        for (int i = 0; i < (int)mSons.size(); i++)
+        {
+            son(i)->prune();
+        }
+
+        // Decide if leaf is best choice.
+        if (Utils::smOrEq(errorsForLeaf(), errorsForTree()))
+        {
+
+            // Free son Trees
+            deleteSons();
+            mIsLeaf = true;
+
+            // Get NoSplit Model for node.
+            replaceByNoSplit();
+        }
+    }
+}
+
+ClassifierTree *PruneableClassifierTree::getNewTree(Instances &train, Instances &test) const
+{
+
+    PruneableClassifierTree *newTree = new PruneableClassifierTree(mToSelectModel, mPruneTheTree, mNumSets, mCleanup, mPresort, mNumBins, mCountTables);
+    attachSubtree(*newTree);
+    newTree->buildTree(train, test, !mCleanup);
+
+    return newTree;
+}
+
+ClassifierTree *PruneableClassifierTree::getNewTree(const InstancesView &train, const InstancesView &test, SortedInstances *sorted) const
+{
+
+    PruneableClassifierTree *newTree = new PruneableClassifierTree(mToSelectModel, mPruneTheTree, mNumSets, mCleanup, mPresort, mNumBins, mCountTables);
+    attachSubtree(*newTree);
+    newTree->buildTree(train, test, sorted, !mCleanup);
+
+    return newTree;
+}
+
+ClassifierTree *PruneableClassifierTree::getEmptyTree() const
+{
+    PruneableClassifierTree *newTree = new PruneableClassifierTree(mToSelectModel, mPruneTheTree, mNumSets, mCleanup, mPresort, mNumBins, mCountTables);
+    attachSubtree(*newTree);
+    return newTree;
+}
+
+double PruneableClassifierTree::errorsForTree() const
+{
+
+    double errors = 0;
+
+    if (mIsLeaf)
+    {
+        return errorsForLeaf();
+    }
+    else
+    {
+        for (int i = 0; i < (int)mSons.size(); i++)
+        {
+            errors = errors + son(i)->errorsForTree();
+        }
+        return errors;
+    }
+}
+
+double PruneableClassifierTree::errorsForLeaf() const
+{
+
+    return mTest->total() - mTest->perClass(mLocalModel->getDistribution()->maxClass());
+}
+
+PruneableClassifierTree *PruneableClassifierTree::son(int index) const
+{
+    return static_cast<PruneableClassifierTree*>(mSons[index]);
+}
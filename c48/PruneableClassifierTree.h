@@ -0,0 +1,126 @@
+#ifndef _PRUNEABLECLASSIFIERTREE_
+#define _PRUNEABLECLASSIFIERTREE_
+
+#include "ClassifierTree.h"
+#include <string>
+#include <vector>
+#include <stdexcept>
+
+// Forward class declarations:
+class ModelSelection;
+class Instances;
+class Distribution;
+class SortedInstances;
+
+/**
+ * Class for handling a tree structure that can
+ * be pruned using a pruning set.
+ */
+class PruneableClassifierTree : public ClassifierTree
+{
+protected:
+    /** True if the tree is to be pruned. */
+    bool mPruneTheTree = false;
+
+    /** How many subsets of equal size? One used for pruning, the rest for training. */
+    int mNumSets = 3;
+
+    /** Cleanup after the tree has been built. */
+    bool mCleanup = true;
+
+    /** Sort numeric attributes once instead of at every node? */
+    bool mPresort = true;
+
+    /** The number of bins numeric attributes are cut into, 0 for exact splits. */
+    int mNumBins = 0;
+
+    /** Derive the counts of the largest son from its parent's? */
+    bool mCountTables = false;
+
+    /**
+     * Returns a newly created tree.
+     *
+     * @param train the training data
+     * @param test the pruning data.
+     * @return the generated tree
+     * @throws Exception if something goes wrong
+     */
+    virtual ClassifierTree *getNewTree(Instances &train, Instances &test) const override;
+
+    /**
+     * Returns a newly created tree.
+     *
+     * @param train the rows of the training data
+     * @param test the rows of the pruning data
+     * @param sorted the presorted orders of the training rows, may be null
+     * @return the new tree
+     * @throws Exception if something goes wrong
+     */
+    virtual ClassifierTree *getNewTree(const InstancesView &train, const InstancesView &test, SortedInstances *sorted) const override;
+
+    /**
+     * Returns a new pruneable tree with the same settings that has not been
+     * built.
+     *
+     * @return the new tree
+     */
+    virtual ClassifierTree *getEmptyTree() const override;
+
+public:
+    /**
+     * Constructor for pruneable tree structure. Stores reference
+     * to associated training data at each node.
+     *
+     * @param toSelectLocModel selection method for local splitting model
+     * @param pruneTree true if the tree is to be pruned
+     * @param num number of subsets of equal size
+     * @param cleanup
+     * @param presort true if numeric attributes are to be sorted only once
+     * @param numBins the number of quantile bins numeric attributes are cut
+     *          into for approximate splits, 0 for exact splits
+     * @param countTables true if every node is to keep its class counts per
+     *          nominal value, deriving those of its largest son by subtraction
+     * @throws Exception if something goes wrong
+     */
+    PruneableClassifierTree(ModelSelection *toSelectLocModel, bool pruneTree, int num, bool cleanup, bool presort, int numBins, bool countTables);
+
+    /**
+     * Method for building a pruneable classifier tree. The data is
+     * stratified and the last of the subsets is held out for pruning.
+     *
+     * @param data the data to build the tree from
+     * @throws Exception if something goes wrong
+     */
+    virtual void buildClassifier(Instances &data) override;
+
+    /**
+     * Prunes a tree using the pruning data (reduced-error pruning).
+     *
+     * @throws Exception if tree can't be pruned successfully
+     */
+    void prune();
+
+private:
+    /**
+     * Computes estimated errors for tree.
+     *
+     * @return the estimated errors
+     * @throws Exception if something goes wrong
+     */
+    double errorsForTree() const;
+
+    /**
+     * Computes estimated errors for leaf.
+     *
+     * @return the estimated errors
+     * @throws Exception if something goes wrong
+     */
+    double errorsForLeaf() const;
+
+    /**
+     * Method just exists to make program easier to read.
+     */
+    PruneableClassifierTree *son(int index) const;
+};
+
+#endif    // _PRUNEABLECLASSIFIERTREE_
@@ -0,0 +1,429 @@
+#include "SortedInstances.h"
+#include "ClassifierSplitModel.h"
+#include "Distribution.h"
+#include "core/InstancesView.h"
+#include "core/Instances.h"
+#include "core/Instance.h"
+#include "core/ColumnStore.h"
+#include "core/Utils.h"
+
+#include <algorithm>
+
+namespace
+{
+    /**
+     * Adds the weights of the rows of a view per nominal code and class,
+     * reading the codes and classes of the base dataset by index.
+     */
+    template <typename Code>
+    void countCodes(const Code *codes, const Code missing, const int *classes, const InstancesView &data, const int numClasses, double *counts)
+    {
+        int totalInst = data.numInstances();
+        for (int i = 0; i < totalInst; i++)
+        {
+            int index = data.index(i);
+            if (codes[index] != missing)
+            {
+                counts[codes[index] * numClasses + classes[index]] += data.weight(i);
+            }
+        }
+    }
+}
+
+SortedInstances::SortedInstances(int numAttributes) :
+    mOrders(numAttributes),
+    mIsSorted(numAttributes, false),
+    mHistograms(numAttributes),
+    mDistribution(nullptr),
+    mStore(nullptr)
+{
+}
+
+SortedInstances::~SortedInstances()
+{
+    delete mDistribution;
+}
+
+SortedInstances *SortedInstances::forTree(const InstancesView &data, bool presort, int numBins, bool countTables)
+{
+    // sort or bin the numeric attributes once for the whole tree
+    SortedInstances *sorted = nullptr;
+    if (numBins > 0)
+    {
+        sorted = new SortedInstances(data, numBins);
+    }
+    else if (presort)
+    {
+        sorted = new SortedInstances(data);
+    }
+    if (countTables)
+    {
+        if (sorted == nullptr)
+        {
+            sorted = new SortedInstances(data.numAttributes());
+        }
+        sorted->addCounts(data);
+    }
+    return sorted;
+}
+
+void SortedInstances::addCounts(const InstancesView &data)
+{
+    const ColumnStore *store = data.store();
+    mStore = (store != nullptr && store->classIndex() == data.classIndex()) ? store : nullptr;
+    for (int i = 0; i < data.numAttributes(); i++)
+    {
+        if ((i != data.classIndex()) && data.attribute(i).isNominal())
+        {
+            mHistograms[i] = histogram(i, data);
+        }
+    }
+    delete mDistribution;
+    mDistribution = new Distribution(data);
+}
+
+SortedInstances::SortedInstances(const InstancesView &data) :
+    SortedInstances(data.numAttributes())
+{
+    for (int i = 0; i < data.numAttributes(); i++)
+    {
+        if ((i != data.classIndex()) && data.attribute(i).isNumeric())
+        {
+            mOrders[i] = data.sortedOrder(i);
+            mIsSorted[i] = true;
+        }
+    }
+}
+
+SortedInstances::SortedInstances(const InstancesView &data, const int maxBins) :
+    SortedInstances(data.numAttributes())
+{
+    std::shared_ptr<Bins> bins = std::make_shared<Bins>();
+    int numAttributes = data.numAttributes();
+    int numBaseInstances = data.dataset().numInstances();
+    bins->codes.resize(numAttributes);
+    bins->lowers.resize(numAttributes);
+    bins->uppers.resize(numAttributes);
+    bins->binned.assign(numAttributes, false);
+    for (int i = 0; i < numAttributes; i++)
+    {
+        if ((i == data.classIndex()) || !data.attribute(i).isNumeric())
+        {
+            continue;
+        }
+        bins->binned[i] = true;
+        int_array order = data.sortedOrder(i);
+        int known = 0;
+        double total = 0;
+        while (known < (int)order.size() && !data.isMissing(order[known], i))
+        {
+            total += data.weight(order[known]);
+            known++;
+        }
+
+        // Close a bin once the weight up to it reaches its share of the
+        // total, always after the last of a run of equal values.
+        std::vector<unsigned short> &codes = bins->codes[i];
+        double_array &lowers = bins->lowers[i];
+        double_array &uppers = bins->uppers[i];
+        codes.assign(numBaseInstances, (unsigned short)MISSING_BIN);
+        double cumulative = 0;
+        int j = 0;
+        while (j < known)
+        {
+            double value = data.value(order[j], i);
+            if (lowers.size() == uppers.size())
+            {
+                lowers.push_back(value);
+            }
+            int bin = (int)uppers.size();
+            do
+            {
+                codes[data.index(order[j])] = (unsigned short)bin;
+                cumulative += data.weight(order[j]);
+                j++;
+            } while (j < known && data.value(order[j], i) == value);
+            if (j == known || (bin + 1 < maxBins && cumulative >= total * (bin + 1) / maxBins))
+            {
+                uppers.push_back(value);
+            }
+        }
+    }
+    mBins = bins;
+
+    for (int i = 0; i < numAttributes; i++)
+    {
+        if (!mBins->codes[i].empty())
+        {
+            mHistograms[i] = histogram(i, data);
+        }
+    }
+}
+
+SortedInstances::SortedInstances(std::vector<double_array> &&lowers, std::vector<double_array> &&uppers, const bool_array &binned) :
+    SortedInstances((int)binned.size())
+{
+    std::shared_ptr<Bins> bins = std::make_shared<Bins>();
+    bins->codes.resize(binned.size());
+    bins->lowers = std::move(lowers);
+    bins->uppers = std::move(uppers);
+    bins->binned = binned;
+    mBins = bins;
+}
+
+double_array SortedInstances::histogram(const int attIndex, const InstancesView &data) const
+{
+    int numClasses = data.numClasses();
+    int totalInst = data.numInstances();
+    if (data.attribute(attIndex).isNominal())
+    {
+        double_array result(data.attribute(attIndex).numValues() * numClasses, 0);
+        if (mStore != nullptr && mStore->byteCodes(attIndex) != nullptr)
+        {
+            countCodes(mStore->byteCodes(attIndex), ColumnStore::MISSING_BYTE, mStore->classColumn(), data, numClasses, result.data());
+            return result;
+        }
+        if (mStore != nullptr && mStore->shortCodes(attIndex) != nullptr)
+        {
+            countCodes(mStore->shortCodes(attIndex), ColumnStore::MISSING_SHORT, mStore->classColumn(), data, numClasses, result.data());
+            return result;
+        }
+        for (int i = 0; i < totalInst; i++)
+        {
+            double value = data.value(i, attIndex);
+            if (!Utils::isMissingValue(value))
+            {
+                result[static_cast<int>(value) * numClasses + static_cast<int>(data.classValue(i))] += data.weight(i);
+            }
+        }
+        return result;
+    }
+
+    const std::vector<unsigned short> &codes = mBins->codes[attIndex];
+    double_array result(mBins->uppers[attIndex].size() * numClasses, 0);
+    for (int i = 0; i < totalInst; i++)
+    {
+        unsigned short bin = codes[data.index(i)];
+        if (bin != MISSING_BIN)
+        {
+            result[bin * numClasses + static_cast<int>(data.classValue(i))] += data.weight(i);
+        }
+    }
+    return result;
+}
+
+bool SortedInstances::isSorted(const int attIndex) const
+{
+    return mIsSorted[attIndex];
+}
+
+const int_array &SortedInstances::order(const int attIndex) const
+{
+    return mOrders[attIndex];
+}
+
+bool SortedInstances::isBinned(const int attIndex) const
+{
+    return mBins != nullptr && mBins->binned[attIndex];
+}
+
+bool SortedInstances::hasCounts(const int attIndex) const
+{
+    return !mHistograms[attIndex].empty();
+}
+
+const Distribution *SortedInstances::distribution() const
+{
+    return mDistribution;
+}
+
+int SortedInstances::numBins(const int attIndex) const
+{
+    return (int)mBins->uppers[attIndex].size();
+}
+
+const double_array &SortedInstances::histogram(const int attIndex) const
+{
+    return mHistograms[attIndex];
+}
+
+int SortedInstances::binOf(const int attIndex, const double value) const
+{
+    const double_array &uppers = mBins->uppers[attIndex];
+    return (int)(std::lower_bound(uppers.begin(), uppers.end(), value) - uppers.begin());
+}
+
+double SortedInstances::lowerValue(const int attIndex, const int bin) const
+{
+    return mBins->lowers[attIndex][bin];
+}
+
+double SortedInstances::upperValue(const int attIndex, const int bin) const
+{
+    return mBins->uppers[attIndex][bin];
+}
+
+std::vector<SortedInstances*> SortedInstances::split(const ClassifierSplitModel &model, const InstancesView &data, const std::vector<InstancesView*> &views) const
+{
+    int numSubsets = model.numSubsets();
+    int numAttributes = (int)mOrders.size();
+    std::vector<SortedInstances*> subsets(numSubsets);
+    for (int j = 0; j < numSubsets; j++)
+    {
+        subsets[j] = new SortedInstances(numAttributes);
+        subsets[j]->mBins = mBins;
+        subsets[j]->mStore = mStore;
+    }
+
+    // Count all sons but the largest, which gets what is left.
+    int largest = 0;
+    for (int j = 1; j < numSubsets; j++)
+    {
+        if (views[j]->numInstances() > views[largest]->numInstances())
+        {
+            largest = j;
+        }
+    }
+    for (int i = 0; i < numAttributes; i++)
+    {
+        if (!hasCounts(i))
+        {
+            continue;
+        }
+        double_array &rest = subsets[largest]->mHistograms[i];
+        rest = mHistograms[i];
+        for (int j = 0; j < numSubsets; j++)
+        {
+            if (j == largest)
+            {
+                continue;
+            }
+            subsets[j]->mHistograms[i] = histogram(i, *views[j]);
+            const double_array &counts = subsets[j]->mHistograms[i];
+            for (size_t k = 0; k < rest.size(); k++)
+            {
+                // Rounding must not leave negative weights behind.
+                rest[k] = std::max(rest[k] - counts[k], 0.0);
+            }
+        }
+    }
+    if (mDistribution != nullptr)
+    {
+        Distribution *rest = new Distribution(*mDistribution);
+        for (int j = 0; j < numSubsets; j++)
+        {
+            if (j != largest)
+            {
+                subsets[j]->mDistribution = new Distribution(*views[j]);
+                Distribution *difference = rest->subtract(subsets[j]->mDistribution);
+                delete rest;
+                rest = difference;
+            }
+        }
+        subsets[largest]->mDistribution = rest;
+    }
+    if (std::find(mIsSorted.begin(), mIsSorted.end(), true) == mIsSorted.end())
+    {
+        return subsets;
+    }
+
+    // Find the row each row of the parent gets in its subset(s), numbering
+    // the rows of each subset in the order ClassifierSplitModel::split()
+    // adds them. For a row assigned to more than one subset subsetRow holds
+    // the index of its entry in multiRows instead.
+    int totalInst = data.numInstances();
+    int_array subsetOf(totalInst);
+    int_array subsetRow(totalInst);
+    std::vector<int_array> multiRows;
+    int_array counts(numSubsets, 0);
+    for (int i = 0; i < totalInst; i++)
+    {
+        Instance &instance = data.instance(i);
+        int subset = model.whichSubset(instance);
+        subsetOf[i] = subset;
+        if (subset > -1)
+        {
+            subsetRow[i] = counts[subset]++;
+        }
+        else
+        {
+            double_array _weights = model.weights(instance);
+            int_array rows(numSubsets, -1);
+            for (int j = 0; j < numSubsets; j++)
+            {
+                if (Utils::gr(_weights[j], 0))
+                {
+                    rows[j] = counts[j]++;
+                }
+            }
+            subsetRow[i] = (int)multiRows.size();
+            multiRows.push_back(rows);
+        }
+    }
+
+    for (int i = 0; i < numAttributes; i++)
+    {
+        if (!mIsSorted[i])
+        {
+            continue;
+        }
+        for (int j = 0; j < numSubsets; j++)
+        {
+            subsets[j]->mIsSorted[i] = true;
+            subsets[j]->mOrders[i].reserve(counts[j]);
+        }
+        for (auto row : mOrders[i])
+        {
+            int subset = subsetOf[row];
+            if (subset > -1)
+            {
+                subsets[subset]->mOrders[i].push_back(subsetRow[row]);
+            }
+            else
+            {
+                const int_array &rows = multiRows[subsetRow[row]];
+                for (int j = 0; j < numSubsets; j++)
+                {
+                    if (rows[j] > -1)
+                    {
+                        subsets[j]->mOrders[i].push_back(rows[j]);
+                    }
+                }
+            }
+        }
+    }
+    return subsets;
+}
+
+SortedInstances *SortedInstances::subset(const int_array &rows) const
+{
+    int numAttributes = (int)mOrders.size();
+    SortedInstances *result = new SortedInstances(numAttributes);
+    for (int i = 0; i < numAttributes; i++)
+    {
+        if (!mIsSorted[i])
+        {
+            continue;
+        }
+        int_array &order = result->mOrders[i];
+        order.reserve(mOrders[i].size());
+        for (int row : mOrders[i])
+        {
+            if (rows[row] > -1)
+            {
+                order.push_back(rows[row]);
+            }
+        }
+        result->mIsSorted[i] = true;
+    }
+    return result;
+}
+
+SortedInstances *SortedInstances::withCounts(std::vector<double_array> &&histograms, Distribution *distribution) const
+{
+    SortedInstances *result = new SortedInstances((int)mOrders.size());
+    result->mBins = mBins;
+    result->mHistograms = std::move(histograms);
+    result->mDistribution = distribution;
+    return result;
+}
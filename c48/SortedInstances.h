@@ -0,0 +1,296 @@
+#ifndef _SORTEDINSTANCES_
+#define _SORTEDINSTANCES_
+
+#include <memory>
+#include <vector>
+#include "core/Typedefs.h"
+
+// Forward class declarations:
+class InstancesView;
+class ClassifierSplitModel;
+class Distribution;
+class ColumnStore;
+
+/**
+ * Class for holding the instances that reach a node of the tree in
+ * ascending order of each numeric attribute. The orders are computed once
+ * for the full training set and are then partitioned stably down the tree,
+ * so split selection never has to sort again (SLIQ/SPRINT-style presorting).
+ * The orders hold rows of the InstancesView of the node.
+ *
+ * For approximate split selection the numeric attributes are binned instead:
+ * the values of each are cut once into at most a given number of quantile
+ * bins, and every node holds the class weights per bin of each attribute.
+ * The split search then scans the bins rather than the rows. The histograms
+ * of all sons but the largest are counted from their rows; the largest one
+ * is the parent's histogram minus its siblings'. A tree grown level by
+ * level from data on disk brings bins and histograms of its own instead,
+ * as no node holds rows there.
+ *
+ * The class weights per value of the nominal attributes and the class
+ * distribution of the node can be kept in the same way, so that a node only
+ * counts the rows of its smaller sons.
+ */
+class SortedInstances
+{
+
+public:
+
+    /** The largest number of bins per attribute. */
+    static const int MAX_BINS = 65535;
+
+protected:
+
+    /** The bin of a missing value. */
+    static const unsigned short MISSING_BIN = 65535;
+
+    /** The quantile bins of the numeric attributes, shared by all nodes. */
+    struct Bins
+    {
+        /**
+         * The bin of the value of each row of the base dataset, per
+         * attribute (empty for attributes that are not binned).
+         */
+        std::vector<std::vector<unsigned short>> codes;
+
+        /** The smallest value in each bin, per attribute. */
+        std::vector<double_array> lowers;
+
+        /** The largest value in each bin, per attribute. */
+        std::vector<double_array> uppers;
+
+        /** Whether each attribute is binned. */
+        bool_array binned;
+    };
+
+    /** Rows in ascending order per attribute (empty for nominal attributes). */
+    std::vector<int_array> mOrders;
+
+    /** Whether the order for an attribute is available. */
+    bool_array mIsSorted;
+
+    /** The bins of the numeric attributes, null if they are not binned. */
+    std::shared_ptr<const Bins> mBins;
+
+    /**
+     * The weights of the rows per bin or nominal value and class, bin after
+     * bin, per attribute (empty for attributes that are not counted).
+     */
+    std::vector<double_array> mHistograms;
+
+    /** The class distribution of the rows, null if it is not kept. */
+    Distribution *mDistribution;
+
+    /**
+     * The column store holding the base dataset at the rows of its indices,
+     * whose nominal codes are then counted directly; null if the values are
+     * read through the instances.
+     */
+    const ColumnStore *mStore;
+
+    /**
+     * Counts the weights of the given rows per bin or value and class of an
+     * attribute.
+     *
+     * @param attIndex the attribute's index
+     * @param data the rows to count
+     * @return the histogram of the attribute
+     */
+    double_array histogram(const int attIndex, const InstancesView &data) const;
+
+public:
+
+    /**
+     * Creates an empty set of orders for the given number of attributes.
+     *
+     * @param numAttributes the number of attributes
+     */
+    SortedInstances(int numAttributes);
+
+    /**
+     * Sorts the rows of the given view once for each numeric attribute apart
+     * from the class attribute. Rows with missing values are placed at the
+     * end of each order.
+     *
+     * @param data the rows to sort
+     */
+    SortedInstances(const InstancesView &data);
+
+    /**
+     * Bins the values of each numeric attribute of the given view apart
+     * from the class attribute into at most maxBins bins of about equal
+     * weight; equal values always share a bin. Rows with missing values are
+     * left out of the histograms.
+     *
+     * @param data the rows to bin
+     * @param maxBins the largest number of bins per attribute, at most MAX_BINS
+     */
+    SortedInstances(const InstancesView &data, const int maxBins);
+
+    /**
+     * Creates the bins of the numeric attributes from bounds found
+     * elsewhere, e.g. by scans of a data set too large to sort. No row has
+     * a bin; the nodes get their histograms from withCounts().
+     *
+     * @param lowers the smallest value in each bin, per attribute
+     * @param uppers the largest value in each bin, per attribute
+     * @param binned whether each attribute is binned
+     */
+    SortedInstances(std::vector<double_array> &&lowers, std::vector<double_array> &&uppers, const bool_array &binned);
+
+    /**
+     * Destructor.
+     */
+    ~SortedInstances();
+
+    /**
+     * Prepares the rows a tree is grown from according to the settings of
+     * the tree.
+     *
+     * @param data the rows of the root
+     * @param presort true if numeric attributes are to be sorted only once
+     * @param numBins the number of quantile bins for numeric attributes, 0
+     *          for exact splits
+     * @param countTables true if the nodes are to keep their class counts
+     *          per nominal value
+     * @return the prepared orders, null if the settings need none
+     */
+    static SortedInstances *forTree(const InstancesView &data, bool presort, int numBins, bool countTables);
+
+    /**
+     * Counts the class weights per value of every nominal attribute apart
+     * from the class attribute, and the class distribution of the given
+     * view. The sons created by split() derive theirs from these.
+     *
+     * @param data the rows the orders refer to
+     */
+    void addCounts(const InstancesView &data);
+
+    /**
+     * Tests whether an order is available for the given attribute.
+     *
+     * @param attIndex the attribute's index
+     * @return true if the instances are sorted on the attribute
+     */
+    bool isSorted(const int attIndex) const;
+
+    /**
+     * Returns the rows in ascending order of the given attribute.
+     *
+     * @param attIndex the attribute's index
+     * @return the sorted rows
+     */
+    const int_array &order(const int attIndex) const;
+
+    /**
+     * Tests whether the given attribute is binned.
+     *
+     * @param attIndex the attribute's index
+     * @return true if histograms are available for the attribute
+     */
+    bool isBinned(const int attIndex) const;
+
+    /**
+     * Tests whether class weights per bin or value are available for the
+     * given attribute.
+     *
+     * @param attIndex the attribute's index
+     * @return true if the histogram of the attribute is available
+     */
+    bool hasCounts(const int attIndex) const;
+
+    /**
+     * Returns the class distribution of the rows.
+     *
+     * @return the distribution, null if it is not kept
+     */
+    const Distribution *distribution() const;
+
+    /**
+     * Returns the number of bins of an attribute.
+     *
+     * @param attIndex the attribute's index
+     * @return the number of bins
+     */
+    int numBins(const int attIndex) const;
+
+    /**
+     * Returns the weights of the rows per bin or nominal value and class of
+     * an attribute.
+     *
+     * @param attIndex the attribute's index
+     * @return numBins() (numValues() for a nominal attribute) x numClasses
+     *         values, bin after bin
+     */
+    const double_array &histogram(const int attIndex) const;
+
+    /**
+     * Returns the bin a value of an attribute falls into.
+     *
+     * @param attIndex the attribute's index
+     * @param value a known value in the range of the bins
+     * @return the first bin whose largest value is not below the value
+     */
+    int binOf(const int attIndex, const double value) const;
+
+    /**
+     * Returns the smallest value in a bin.
+     *
+     * @param attIndex the attribute's index
+     * @param bin the bin
+     * @return the smallest value of the whole training set in the bin
+     */
+    double lowerValue(const int attIndex, const int bin) const;
+
+    /**
+     * Returns the largest value in a bin.
+     *
+     * @param attIndex the attribute's index
+     * @param bin the bin
+     * @return the largest value of the whole training set in the bin
+     */
+    double upperValue(const int attIndex, const int bin) const;
+
+    /**
+     * Partitions the orders according to the given split model. Each subset
+     * keeps the relative order of its parent and refers to the rows of the
+     * view ClassifierSplitModel::split() creates for it from the same data.
+     *
+     * @param model the split model to use
+     * @param data the rows the orders refer to
+     * @param subsets the views ClassifierSplitModel::split() created
+     * @return the orders for each subset of the split
+     */
+    std::vector<SortedInstances*> split(const ClassifierSplitModel &model, const InstancesView &data, const std::vector<InstancesView*> &subsets) const;
+
+    /**
+     * Returns the orders of a subset of the rows, filtered out of these
+     * orders instead of sorting the subset again. Only the sorted orders are
+     * kept, not the bins or the counts.
+     *
+     * @param rows the row each row of these orders has in the subset, -1 for
+     *          the rows left out
+     * @return the orders of the subset
+     */
+    SortedInstances *subset(const int_array &rows) const;
+
+    /**
+     * Returns a set sharing these bins that holds counts counted elsewhere
+     * instead of rows, e.g. those of a node grown level by level.
+     *
+     * @param histograms the weights per bin or nominal value and class, as
+     *          histogram() returns them, per attribute (empty for attributes
+     *          that are not counted)
+     * @param distribution the class distribution of the rows. Ownership is
+     *          passed to the new set.
+     * @return the counts
+     */
+    SortedInstances *withCounts(std::vector<double_array> &&histograms, Distribution *distribution) const;
+
+private:
+
+    SortedInstances(const SortedInstances&);
+    SortedInstances &operator=(const SortedInstances&);
+};
+
+#endif    // _SORTEDINSTANCES_
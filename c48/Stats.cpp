@@ -65,7 +65,10 @@ double Stats::addErrs(double N, double e, float CF) {
     }
 
     // Get z-score corresponding to CF
-    double z = normalInverse(1 - CF);
+    return addErrsNormal(N, e, normalInverse(1 - CF));
+}
+
+double Stats::addErrsNormal(double N, double e, double z) {
 
     // Compute upper limit of confidence interval
     double f = (e + 0.5) / N;
@@ -21,6 +21,17 @@ public:
       */
     static double addErrs(double N, double e, float CF);
 
+    /**
+      * Computes estimated extra error for given total number of instances
+      * and error from the upper limit of the confidence interval of the
+      * normal approximation, for an error not close to either end.
+      *
+      * @param N number of instances
+      * @param e observed error, at least 1 and less than N - 0.5
+      * @param z the z-score of the confidence value
+      */
+    static double addErrsNormal(double N, double e, double z);
+
     /**
      * Returns the value, x, for which the area under the Normal
      * (Gaussian) probability density function (integrated from minus infinity to
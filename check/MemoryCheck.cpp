@@ -0,0 +1,131 @@
+#include "core/DataSource.h"
+#include "core/Instances.h"
+#include "core/Instance.h"
+#include "c48/C48.h"
+#include "c48/Distribution.h"
+#include "c48/ClassifierSplitModel.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/**
+ * Rebuilds the same C48 model many times and checks that the live
+ * allocations stay flat: the distributions and split models on the heap
+ * and the objects held by the arena of the tree. Once the tree has been
+ * cleaned up the arena must be empty.
+ */
+
+namespace {
+
+/** The number of times each model is rebuilt after the first build. */
+const int NUM_REBUILDS = 20;
+
+/** The number of rows the models are built on, to keep the check quick. */
+const int NUM_ROWS = 5000;
+
+/** One configuration of the classifier to check. */
+struct Config
+{
+    const char *name;
+    bool unpruned;
+    bool reducedErrorPruning;
+    bool subtreeRaising;
+    bool noCleanup;
+    int numThreads;
+};
+
+const Config CONFIGS[] = {
+    { "default (raising)", false, false, true, false, 1 },
+    { "-U", true, false, true, false, 1 },
+    { "-R", false, true, true, false, 1 },
+    { "-S", false, false, false, false, 1 },
+    { "-L", false, false, true, true, 1 },
+    { "-threads 2", false, false, true, false, 2 }
+};
+
+bool check(bool condition, const Config &config, const std::string &what)
+{
+    if (!condition)
+        std::cout << "FAILED " << config.name << ": " << what << std::endl;
+    return condition;
+}
+
+bool checkConfig(const Config &config, Instances &data)
+{
+    long distributions = Distribution::numLive();
+    long splitModels = ClassifierSplitModel::numLive();
+    bool ok = true;
+
+    C48 *classifier = new C48();
+    classifier->setUnpruned(config.unpruned);
+    classifier->setReducedErrorPruning(config.reducedErrorPruning);
+    classifier->setSubtreeRaising(config.subtreeRaising);
+    classifier->setSaveInstanceData(config.noCleanup);
+    classifier->setNumThreads(config.numThreads);
+
+    classifier->buildClassifier(data);
+    long builtDistributions = Distribution::numLive();
+    long builtSplitModels = ClassifierSplitModel::numLive();
+    size_t builtArena = classifier->arenaSize();
+    if (!config.noCleanup)
+        ok &= check(builtArena == 0, config, "arena not empty after cleanup");
+
+    for (int i = 0; i < NUM_REBUILDS; i++)
+    {
+        classifier->buildClassifier(data);
+        ok &= check(Distribution::numLive() == builtDistributions, config,
+            "live distributions grew to " + std::to_string(Distribution::numLive()));
+        ok &= check(ClassifierSplitModel::numLive() == builtSplitModels, config,
+            "live split models grew to " + std::to_string(ClassifierSplitModel::numLive()));
+        ok &= check(classifier->arenaSize() == builtArena, config,
+            "arena grew to " + std::to_string(classifier->arenaSize()));
+        if (!ok)
+            break;
+    }
+
+    delete classifier;
+    ok &= check(Distribution::numLive() == distributions, config, "distributions left after delete");
+    ok &= check(ClassifierSplitModel::numLive() == splitModels, config, "split models left after delete");
+
+    std::cout << (ok ? "ok     " : "FAILED ") << config.name
+        << ": " << builtDistributions - distributions << " distributions, "
+        << builtSplitModels - splitModels << " split models, "
+        << builtArena << " arena objects" << std::endl;
+    return ok;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cout << argv[0] << " <data file>" << std::endl;
+        return 2;
+    }
+
+    try
+    {
+        DataSource source{ std::string(argv[1]) };
+        source.setUseCache(false);
+        Instances *allData = source.getDataSet();
+        std::vector<Instance*> rows;
+        for (int i = 0; i < std::min(NUM_ROWS, allData->numInstances()); i++)
+            rows.push_back(&allData->instance(i));
+        Instances *data = new Instances(allData, rows);
+
+        bool ok = true;
+        for (const Config &config : CONFIGS)
+            ok &= checkConfig(config, *data);
+
+        delete data;
+        delete allData;
+        return ok ? 0 : 1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << "FAILED: " << e.what() << std::endl;
+        return 1;
+    }
+}
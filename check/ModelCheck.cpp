@@ -0,0 +1,143 @@
+#include "core/DataSource.h"
+#include "core/Instances.h"
+#include "core/Instance.h"
+#include "c48/C48.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/**
+ * Saves a C48 model and loads damaged copies of it: every truncation of
+ * the file must be rejected, and a copy with a flipped byte must either be
+ * rejected or load into a model that classifies the rows without failing.
+ * Run it under a sanitizer to have invalid reads reported as well.
+ */
+
+namespace {
+
+/** The number of rows the model is built on, to keep the check quick. */
+const int NUM_ROWS = 200;
+
+/** The number of rows classified with each model that loads. */
+const int NUM_CLASSIFIED = 100;
+
+/** The masks each byte of the file is flipped with in turn. */
+const unsigned char FLIP_MASKS[] = { 0x01, 0x80, 0xFF };
+
+/**
+ * Loads a model from the given bytes.
+ *
+ * @return whether the model loaded
+ */
+bool load(C48 &classifier, const std::string &bytes)
+{
+    std::istringstream is(bytes);
+    try
+    {
+        classifier.load(is);
+        return true;
+    }
+    catch (...)
+    {
+        return false;
+    }
+}
+
+/**
+ * Classifies the first rows with a loaded model.
+ *
+ * @return whether every row got a class
+ */
+bool classify(const C48 &classifier, Instances &data)
+{
+    try
+    {
+        for (int i = 0; i < std::min(NUM_CLASSIFIED, data.numInstances()); i++)
+            classifier.classifyInstance(data.instance(i));
+        return true;
+    }
+    catch (...)
+    {
+        return false;
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cout << argv[0] << " <data file>" << std::endl;
+        return 2;
+    }
+
+    try
+    {
+        DataSource source{ std::string(argv[1]) };
+        source.setUseCache(false);
+        Instances *allData = source.getDataSet();
+        std::vector<Instance*> rows;
+        for (int i = 0; i < std::min(NUM_ROWS, allData->numInstances()); i++)
+            rows.push_back(&allData->instance(i));
+        Instances *data = new Instances(allData, rows);
+
+        C48 trained;
+        trained.buildClassifier(*data);
+        std::ostringstream os;
+        trained.save(os);
+        const std::string model = os.str();
+
+        bool ok = true;
+        C48 loaded;
+        if (!load(loaded, model) || !classify(loaded, *data))
+        {
+            std::cout << "FAILED: the saved model does not load" << std::endl;
+            ok = false;
+        }
+
+        int truncatedLoads = 0;
+        for (size_t size = 0; size < model.size(); size++)
+        {
+            C48 classifier;
+            if (load(classifier, model.substr(0, size)))
+                truncatedLoads++;
+        }
+        ok &= truncatedLoads == 0;
+        std::cout << (truncatedLoads == 0 ? "ok     " : "FAILED ") << "truncated: "
+            << truncatedLoads << " of " << model.size() << " loaded" << std::endl;
+
+        int flippedLoads = 0;
+        int failedClassifications = 0;
+        for (unsigned char mask : FLIP_MASKS)
+        {
+            for (size_t i = 0; i < model.size(); i++)
+            {
+                std::string flipped = model;
+                flipped[i] = (char)(flipped[i] ^ mask);
+                C48 classifier;
+                if (load(classifier, flipped))
+                {
+                    flippedLoads++;
+                    if (!classify(classifier, *data))
+                        failedClassifications++;
+                }
+            }
+        }
+        ok &= failedClassifications == 0;
+        std::cout << (failedClassifications == 0 ? "ok     " : "FAILED ") << "flipped: "
+            << flippedLoads << " of " << model.size() * sizeof(FLIP_MASKS) << " loaded, "
+            << failedClassifications << " failed to classify" << std::endl;
+
+        delete data;
+        delete allData;
+        return ok ? 0 : 1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << "FAILED: " << e.what() << std::endl;
+        return 1;
+    }
+}
@@ -0,0 +1,106 @@
+#include "core/DataSource.h"
+#include "core/Instances.h"
+#include "core/Instance.h"
+#include "c48/C48.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+/**
+ * Checks that C48 rejects option values it cannot build with, from the
+ * command line and from the setters, and still builds with the smallest
+ * valid ones.
+ */
+
+namespace {
+
+/** The number of rows the models are built on, to keep the check quick. */
+const int NUM_ROWS = 2000;
+
+bool check(bool condition, const std::string &what)
+{
+    std::cout << (condition ? "ok     " : "FAILED ") << what << std::endl;
+    return condition;
+}
+
+/**
+ * Passes the given options to a new classifier as setParameters() gets
+ * them from main().
+ *
+ * @return whether the options were accepted
+ */
+bool accepts(std::vector<std::string> options, int expectedNumFolds)
+{
+    options.insert(options.begin(), "c48");
+    std::vector<char*> argv;
+    for (std::string &option : options)
+        argv.push_back(&option[0]);
+    C48 classifier;
+    bool isOkay = classifier.setParameters((int)argv.size(), argv.data());
+    return isOkay && classifier.getNumFolds() == expectedNumFolds;
+}
+
+/**
+ * Sets the number of folds of a new classifier.
+ *
+ * @return whether the number was accepted
+ */
+bool setsNumFolds(int numFolds)
+{
+    C48 classifier;
+    try
+    {
+        classifier.setNumFolds(numFolds);
+        return classifier.getNumFolds() == numFolds;
+    }
+    catch (const std::string &)
+    {
+        return false;
+    }
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 2)
+    {
+        std::cout << argv[0] << " <data file>" << std::endl;
+        return 2;
+    }
+
+    try
+    {
+        bool ok = true;
+        ok &= check(!accepts({ "-R", "-N", "0" }, 0), "-R -N 0 rejected");
+        ok &= check(!accepts({ "-R", "-N", "1" }, 1), "-R -N 1 rejected");
+        ok &= check(accepts({ "-R", "-N", "2" }, 2), "-R -N 2 accepted");
+        ok &= check(!setsNumFolds(0), "setNumFolds(0) rejected");
+        ok &= check(!setsNumFolds(1), "setNumFolds(1) rejected");
+        ok &= check(setsNumFolds(2), "setNumFolds(2) accepted");
+
+        DataSource source{ std::string(argv[1]) };
+        source.setUseCache(false);
+        Instances *allData = source.getDataSet();
+        std::vector<Instance*> rows;
+        for (int i = 0; i < std::min(NUM_ROWS, allData->numInstances()); i++)
+            rows.push_back(&allData->instance(i));
+        Instances *data = new Instances(allData, rows);
+
+        C48 classifier;
+        classifier.setReducedErrorPruning(true);
+        classifier.setNumFolds(2);
+        classifier.buildClassifier(*data);
+        ok &= check(classifier.measureTreeSize() > 0, "-R -N 2 builds a tree");
+
+        delete data;
+        delete allData;
+        return ok ? 0 : 1;
+    }
+    catch (const std::exception &e)
+    {
+        std::cout << "FAILED: " << e.what() << std::endl;
+        return 1;
+    }
+}
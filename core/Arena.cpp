@@ -0,0 +1,30 @@
+#include "Arena.h"
+
+Arena::Arena()
+{
+}
+
+Arena::~Arena()
+{
+    release();
+}
+
+void Arena::release()
+{
+    std::vector<Entry> objects;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        objects.swap(mObjects);
+    }
+    // later objects may refer to earlier ones, so they go first
+    for (auto it = objects.rbegin(); it != objects.rend(); ++it)
+    {
+        it->destroy(it->object);
+    }
+}
+
+size_t Arena::size() const
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mObjects.size();
+}
@@ -0,0 +1,89 @@
+#ifndef _ARENA_
+#define _ARENA_
+
+#include <mutex>
+#include <vector>
+
+/**
+ * Class for a set of heap objects that are deleted together. Objects whose
+ * ownership is shared or hard to follow, such as the instance subsets built
+ * while a tree is grown and pruned and the instances they share, are added
+ * to an arena that outlives all their users. The arena deletes them when it
+ * is released or destroyed, in the reverse order of adding.
+ *
+ * Objects may be added from several threads at once.
+ */
+class Arena
+{
+
+protected:
+
+    /** An owned object with the function deleting it. */
+    struct Entry
+    {
+        void *object;
+        void (*destroy)(void*);
+    };
+
+    /** Guards the list of objects. */
+    mutable std::mutex mMutex;
+
+    /** The owned objects, in the order of adding. */
+    std::vector<Entry> mObjects;
+
+    /**
+     * Deletes an object of a given type.
+     *
+     * @param object the object
+     */
+    template <typename T>
+    static void destroy(void *object)
+    {
+        delete static_cast<T*>(object);
+    }
+
+public:
+
+    /**
+     * Creates an empty arena.
+     */
+    Arena();
+
+    /**
+     * Deletes all objects of the arena.
+     */
+    ~Arena();
+
+    /**
+     * Hands an object over to the arena.
+     *
+     * @param object the object to own, which must have been created with new
+     * @return the object
+     */
+    template <typename T>
+    T *add(T *object)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mObjects.push_back(Entry{ object, &destroy<T> });
+        return object;
+    }
+
+    /**
+     * Deletes all objects of the arena, leaving it empty for reuse.
+     */
+    void release();
+
+    /**
+     * Returns the number of objects the arena owns.
+     *
+     * @return the number of objects
+     */
+    size_t size() const;
+
+private:
+
+    Arena(const Arena&);
+    Arena &operator=(const Arena&);
+};
+
+#endif    // _ARENA_
@@ -0,0 +1,106 @@
+#include "BinaryReader.h"
+
+#include <cstring>
+#include <sstream>
+#include <stdint.h>
+
+BinaryReader::BinaryReader(std::istream &is) :
+    mPosition(0)
+{
+    // Files and string streams can tell their size, so the contents are read
+    // in one piece; other streams are copied as they come.
+    std::streampos start = is.tellg();
+    is.seekg(0, std::ios::end);
+    std::streampos end = is.tellg();
+    if (start != std::streampos(-1) && end != std::streampos(-1) && end >= start)
+    {
+        is.seekg(start);
+        mBuffer.resize((size_t)(end - start));
+        is.read(&mBuffer[0], mBuffer.size());
+        mBuffer.resize((size_t)is.gcount());
+    }
+    else
+    {
+        is.clear();
+        std::ostringstream contents;
+        contents << is.rdbuf();
+        mBuffer = contents.str();
+    }
+    mData = mBuffer.data();
+    mSize = mBuffer.size();
+}
+
+BinaryReader::BinaryReader(const char *data, const size_t size) :
+    mData(data),
+    mSize(size),
+    mPosition(0)
+{
+}
+
+void BinaryReader::readBytes(void *data, const size_t size)
+{
+    if (size > mSize - mPosition)
+    {
+        throw string("Unexpected end of data at byte ") + std::to_string(mPosition);
+    }
+    if (size > 0)
+    {
+        memcpy(data, mData + mPosition, size);
+    }
+    mPosition += size;
+}
+
+bool BinaryReader::readBool()
+{
+    char byte;
+    readBytes(&byte, 1);
+    return byte != 0;
+}
+
+int BinaryReader::readInt()
+{
+    int32_t word;
+    readBytes(&word, sizeof(word));
+    return word;
+}
+
+float BinaryReader::readFloat()
+{
+    float value;
+    readBytes(&value, sizeof(value));
+    return value;
+}
+
+double BinaryReader::readDouble()
+{
+    double value;
+    readBytes(&value, sizeof(value));
+    return value;
+}
+
+string BinaryReader::readString()
+{
+    int size = readInt();
+    if (size < 0 || (size_t)size > mSize - mPosition)
+    {
+        throw string("Invalid string length at byte ") + std::to_string(mPosition);
+    }
+    string value(mData + mPosition, size);
+    mPosition += size;
+    return value;
+}
+
+void BinaryReader::readDoubles(double *values, const int count)
+{
+    readBytes(values, count * sizeof(double));
+}
+
+size_t BinaryReader::position() const
+{
+    return mPosition;
+}
+
+size_t BinaryReader::remaining() const
+{
+    return mSize - mPosition;
+}
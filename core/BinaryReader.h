@@ -0,0 +1,115 @@
+#ifndef _BINARYREADER_
+#define _BINARYREADER_
+
+#include <istream>
+#include <string>
+#include "Typedefs.h"
+
+/**
+ * Class for reading values from a binary buffer written by a BinaryWriter.
+ * The reader either copies the contents of a stream or parses memory owned
+ * by the caller, which then has to outlive the reader. Reading past the end
+ * of the buffer throws an exception instead of returning garbage.
+ */
+class BinaryReader
+{
+
+protected:
+
+    /** The contents of the stream, if the reader was created from one. */
+    string mBuffer;
+
+    /** The start of the memory to read. */
+    const char *mData;
+
+    /** The number of bytes in the memory to read. */
+    size_t mSize;
+
+    /** The position of the next byte to read. */
+    size_t mPosition;
+
+    /**
+     * Copies raw bytes out of the buffer and advances the position.
+     *
+     * @param data where to copy the bytes to
+     * @param size the number of bytes
+     * @throws Exception if the buffer ends before
+     */
+    void readBytes(void *data, const size_t size);
+
+public:
+
+    /**
+     * Creates a reader for the remaining contents of a stream.
+     *
+     * @param is the stream
+     */
+    BinaryReader(std::istream &is);
+
+    /**
+     * Creates a reader for memory owned by the caller.
+     *
+     * @param data the start of the memory
+     * @param size the number of bytes
+     */
+    BinaryReader(const char *data, const size_t size);
+
+    /**
+     * Reads a boolean.
+     *
+     * @return the value
+     */
+    bool readBool();
+
+    /**
+     * Reads a 32-bit integer.
+     *
+     * @return the value
+     */
+    int readInt();
+
+    /**
+     * Reads a single-precision floating-point number.
+     *
+     * @return the value
+     */
+    float readFloat();
+
+    /**
+     * Reads a double-precision floating-point number.
+     *
+     * @return the value
+     */
+    double readDouble();
+
+    /**
+     * Reads a string.
+     *
+     * @return the string
+     */
+    string readString();
+
+    /**
+     * Reads doubles written without their number.
+     *
+     * @param values where to store the doubles
+     * @param count the number of doubles
+     */
+    void readDoubles(double *values, const int count);
+
+    /**
+     * Returns the number of bytes read so far.
+     *
+     * @return the position
+     */
+    size_t position() const;
+
+    /**
+     * Returns the number of bytes left to read.
+     *
+     * @return the number of bytes after the position
+     */
+    size_t remaining() const;
+};
+
+#endif    // _BINARYREADER_
@@ -0,0 +1,51 @@
+#include "BinaryWriter.h"
+
+#include <stdint.h>
+
+void BinaryWriter::writeBytes(const void *data, const size_t size)
+{
+    mBuffer.append(static_cast<const char*>(data), size);
+}
+
+void BinaryWriter::writeBool(const bool value)
+{
+    char byte = value ? 1 : 0;
+    writeBytes(&byte, 1);
+}
+
+void BinaryWriter::writeInt(const int value)
+{
+    int32_t word = value;
+    writeBytes(&word, sizeof(word));
+}
+
+void BinaryWriter::writeFloat(const float value)
+{
+    writeBytes(&value, sizeof(value));
+}
+
+void BinaryWriter::writeDouble(const double value)
+{
+    writeBytes(&value, sizeof(value));
+}
+
+void BinaryWriter::writeString(const string &value)
+{
+    writeInt((int)value.size());
+    writeBytes(value.data(), value.size());
+}
+
+void BinaryWriter::writeDoubles(const double *values, const int count)
+{
+    writeBytes(values, count * sizeof(double));
+}
+
+const string &BinaryWriter::buffer() const
+{
+    return mBuffer;
+}
+
+void BinaryWriter::writeTo(std::ostream &os) const
+{
+    os.write(mBuffer.data(), mBuffer.size());
+}
@@ -0,0 +1,90 @@
+#ifndef _BINARYWRITER_
+#define _BINARYWRITER_
+
+#include <ostream>
+#include <string>
+#include "Typedefs.h"
+
+/**
+ * Class for writing values into a binary buffer. Numbers are written in the
+ * byte order of the machine, strings and arrays are preceded by their
+ * length. The buffer is written out in one piece, so that readers can parse
+ * it from memory with a BinaryReader.
+ */
+class BinaryWriter
+{
+
+protected:
+
+    /** The bytes written so far. */
+    string mBuffer;
+
+    /**
+     * Appends raw bytes to the buffer.
+     *
+     * @param data the bytes
+     * @param size the number of bytes
+     */
+    void writeBytes(const void *data, const size_t size);
+
+public:
+
+    /**
+     * Writes a boolean as one byte.
+     *
+     * @param value the value
+     */
+    void writeBool(const bool value);
+
+    /**
+     * Writes a 32-bit integer.
+     *
+     * @param value the value
+     */
+    void writeInt(const int value);
+
+    /**
+     * Writes a single-precision floating-point number.
+     *
+     * @param value the value
+     */
+    void writeFloat(const float value);
+
+    /**
+     * Writes a double-precision floating-point number.
+     *
+     * @param value the value
+     */
+    void writeDouble(const double value);
+
+    /**
+     * Writes a string.
+     *
+     * @param value the string
+     */
+    void writeString(const string &value);
+
+    /**
+     * Writes doubles without their number.
+     *
+     * @param values the doubles
+     * @param count the number of doubles
+     */
+    void writeDoubles(const double *values, const int count);
+
+    /**
+     * Returns the bytes written so far.
+     *
+     * @return the buffer
+     */
+    const string &buffer() const;
+
+    /**
+     * Writes the buffer to a stream.
+     *
+     * @param os the stream
+     */
+    void writeTo(std::ostream &os) const;
+};
+
+#endif    // _BINARYWRITER_
@@ -0,0 +1,487 @@
+#include "ColumnStore.h"
+#include "Utils.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+
+namespace
+{
+    /**
+     * Returns whether values are all missing or codes below the missing code.
+     */
+    template <typename Code>
+    bool fitCodes(const double *values, const size_t stride, const int count, const Code missing)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            double value = values[i * stride];
+            if (!Utils::isMissingValue(value) && !(value >= 0 && value < missing && value == static_cast<Code>(value)))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Converts values to codes, returning false at the first value that is
+     * not missing or a code below the missing code.
+     */
+    template <typename Code>
+    bool encodeCodes(const double *values, const size_t stride, const int count, const Code missing, Code *out)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            double value = values[i * stride];
+            if (Utils::isMissingValue(value))
+            {
+                out[i] = missing;
+            }
+            else if (value >= 0 && value < missing && value == static_cast<Code>(value))
+            {
+                out[i] = static_cast<Code>(value);
+            }
+            else
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+ColumnStore::ColumnStore(const std::vector<ColumnType> &types, const int classIndex) :
+    mColumns(types.size()),
+    mTypes(types),
+    mClassIndex(classIndex),
+    mMappedClassValues(nullptr),
+    mMappedWeights(nullptr),
+    mMappedRows(0),
+    mMissingBits(types.size()),
+    mNumMissing(types.size(), 0)
+{
+}
+
+ColumnStore::ColumnStore(const std::vector<ColumnType> &types, const int classIndex, const int numRows, const std::vector<const char*> &columns, const int *classValues, const double *weights, const std::shared_ptr<MappedFile> &file) :
+    mColumns(types.size()),
+    mTypes(types),
+    mClassIndex(classIndex),
+    mFile(file),
+    mMappedColumns(columns),
+    mMappedClassValues(classValues),
+    mMappedWeights(weights),
+    mMappedRows(numRows),
+    mMissingBits(types.size()),
+    mNumMissing(types.size(), 0)
+{
+    // The bitmaps are built in memory, a block of decoded values at a time.
+    const int blockSize = 4096;
+    double_array values(blockSize);
+    for (int i = 0; i < (int)types.size(); i++)
+    {
+        mMissingBits[i].reserve((numRows + 63) / 64);
+        for (int first = 0; first < numRows; first += blockSize)
+        {
+            int count = std::min(blockSize, numRows - first);
+            for (int row = 0; row < count; row++)
+            {
+                values[row] = value(first + row, i);
+            }
+            markMissing(i, first, values.data(), 1, count);
+        }
+    }
+}
+
+ColumnStore::ColumnType ColumnStore::typeFor(const int numValues, const bool singlePrecision)
+{
+    if (numValues < 0)
+    {
+        return singlePrecision ? FLOAT_VALUES : DOUBLE_VALUES;
+    }
+    // The largest code is reserved for missing values.
+    if (numValues <= MISSING_BYTE)
+    {
+        return BYTE_CODES;
+    }
+    if (numValues <= MISSING_SHORT)
+    {
+        return SHORT_CODES;
+    }
+    return DOUBLE_VALUES;
+}
+
+size_t ColumnStore::valueSize(const ColumnType type)
+{
+    switch (type)
+    {
+    case FLOAT_VALUES:
+        return sizeof(float);
+    case BYTE_CODES:
+        return sizeof(unsigned char);
+    case SHORT_CODES:
+        return sizeof(unsigned short);
+    default:
+        return sizeof(double);
+    }
+}
+
+ColumnStore::ColumnType ColumnStore::fitType(const ColumnType type, const double *values, const size_t stride, const int count)
+{
+    if (type == BYTE_CODES && fitCodes<unsigned char>(values, stride, count, MISSING_BYTE))
+    {
+        return BYTE_CODES;
+    }
+    if ((type == BYTE_CODES || type == SHORT_CODES) && fitCodes<unsigned short>(values, stride, count, MISSING_SHORT))
+    {
+        return SHORT_CODES;
+    }
+    return (type == FLOAT_VALUES) ? FLOAT_VALUES : DOUBLE_VALUES;
+}
+
+bool ColumnStore::encode(const ColumnType type, const double *values, const size_t stride, const int count, char *out)
+{
+    switch (type)
+    {
+    case FLOAT_VALUES:
+    {
+        float *column = reinterpret_cast<float*>(out);
+        for (int i = 0; i < count; i++)
+        {
+            column[i] = static_cast<float>(values[i * stride]);
+        }
+        return true;
+    }
+    case BYTE_CODES:
+        return encodeCodes<unsigned char>(values, stride, count, MISSING_BYTE, reinterpret_cast<unsigned char*>(out));
+    case SHORT_CODES:
+        return encodeCodes<unsigned short>(values, stride, count, MISSING_SHORT, reinterpret_cast<unsigned short*>(out));
+    default:
+    {
+        double *column = reinterpret_cast<double*>(out);
+        for (int i = 0; i < count; i++)
+        {
+            column[i] = values[i * stride];
+        }
+        return true;
+    }
+    }
+}
+
+bool ColumnStore::isMapped() const
+{
+    return mFile != nullptr;
+}
+
+void ColumnStore::materialize()
+{
+    if (mFile == nullptr)
+    {
+        return;
+    }
+    for (int i = 0; i < (int)mColumns.size(); i++)
+    {
+        if (i != mClassIndex)
+        {
+            mColumns[i].assign(mMappedColumns[i], mMappedColumns[i] + valueSize(mTypes[i]) * mMappedRows);
+        }
+    }
+    if (mClassIndex >= 0)
+    {
+        mClassValues.assign(mMappedClassValues, mMappedClassValues + mMappedRows);
+    }
+    mWeights.assign(mMappedWeights, mMappedWeights + mMappedRows);
+
+    mMappedColumns.clear();
+    mMappedClassValues = nullptr;
+    mMappedWeights = nullptr;
+    mMappedRows = 0;
+    mFile.reset();
+}
+
+void ColumnStore::reserve(const int capacity)
+{
+    materialize();
+    for (int i = 0; i < (int)mColumns.size(); i++)
+    {
+        if (i != mClassIndex)
+        {
+            mColumns[i].reserve(valueSize(mTypes[i]) * capacity);
+        }
+    }
+    if (mClassIndex >= 0)
+    {
+        mClassValues.reserve(capacity);
+    }
+    mWeights.reserve(capacity);
+    for (int i = 0; i < (int)mMissingBits.size(); i++)
+    {
+        mMissingBits[i].reserve((capacity + 63) / 64);
+    }
+}
+
+void ColumnStore::markMissing(const int attIndex, const int first, const double *values, const size_t stride, const int count)
+{
+    std::vector<std::uint64_t> &bits = mMissingBits[attIndex];
+    if ((int)bits.size() * 64 < first + count)
+    {
+        bits.resize((first + count + 63) / 64, 0);
+    }
+    for (int i = 0; i < count; i++)
+    {
+        int row = first + i;
+        std::uint64_t mask = (std::uint64_t)1 << (row % 64);
+        bool missing = Utils::isMissingValue(values[i * stride]);
+        if (missing != ((bits[row / 64] & mask) != 0))
+        {
+            bits[row / 64] ^= mask;
+            mNumMissing[attIndex] += missing ? 1 : -1;
+        }
+    }
+}
+
+void ColumnStore::storeValues(const int attIndex, const int first, const double *values, const size_t stride, const int count)
+{
+    ColumnType type = fitType(mTypes[attIndex], values, stride, count);
+    if (type != mTypes[attIndex])
+    {
+        setColumnType(attIndex, type);
+        type = mTypes[attIndex];
+    }
+    encode(type, values, stride, count, mColumns[attIndex].data() + valueSize(type) * first);
+}
+
+int ColumnStore::add(const double_array &values, const double weight)
+{
+    materialize();
+    int row = numRows();
+    for (int i = 0; i < (int)mColumns.size(); i++)
+    {
+        if (i == mClassIndex)
+        {
+            mClassValues.push_back(Utils::isMissingValue(values[i]) ? -1 : static_cast<int>(values[i]));
+        }
+        else
+        {
+            mColumns[i].resize(valueSize(mTypes[i]) * (row + 1));
+            storeValues(i, row, &values[i], 1, 1);
+        }
+        markMissing(i, row, &values[i], 1, 1);
+    }
+    mWeights.push_back(weight);
+    return row;
+}
+
+int ColumnStore::addRows(const double *values, const int count, const double weight)
+{
+    materialize();
+    int first = numRows();
+    int numAttributes = (int)mColumns.size();
+
+    // Column by column, so that every column is appended to in one go.
+    for (int i = 0; i < numAttributes; i++)
+    {
+        if (i == mClassIndex)
+        {
+            mClassValues.resize(first + count);
+            for (int row = 0; row < count; row++)
+            {
+                double value = values[(size_t)row * numAttributes + i];
+                mClassValues[first + row] = Utils::isMissingValue(value) ? -1 : static_cast<int>(value);
+            }
+        }
+        else
+        {
+            mColumns[i].resize(valueSize(mTypes[i]) * (first + count));
+            storeValues(i, first, values + i, numAttributes, count);
+        }
+        markMissing(i, first, values + i, numAttributes, count);
+    }
+    mWeights.resize(first + count, weight);
+    return first;
+}
+
+int ColumnStore::numRows() const
+{
+    if (mFile != nullptr)
+    {
+        return mMappedRows;
+    }
+    return (int)mWeights.size();
+}
+
+int ColumnStore::numAttributes() const
+{
+    return (int)mColumns.size();
+}
+
+int ColumnStore::classIndex() const
+{
+    return mClassIndex;
+}
+
+void ColumnStore::setClassIndex(const int classIndex)
+{
+    if (classIndex == mClassIndex)
+    {
+        return;
+    }
+    materialize();
+    int totalRows = numRows();
+    if (mClassIndex >= 0)
+    {
+        double_array values(totalRows);
+        for (int i = 0; i < totalRows; i++)
+        {
+            values[i] = (mClassValues[i] < 0) ? Utils::missingValue() : mClassValues[i];
+        }
+        ColumnType type = fitType(mTypes[mClassIndex], values.data(), 1, totalRows);
+        mColumns[mClassIndex].resize(valueSize(type) * totalRows);
+        encode(type, values.data(), 1, totalRows, mColumns[mClassIndex].data());
+        mTypes[mClassIndex] = type;
+        mClassValues.clear();
+    }
+    if (classIndex >= 0)
+    {
+        mClassValues.resize(totalRows);
+        for (int i = 0; i < totalRows; i++)
+        {
+            double value = this->value(i, classIndex);
+            mClassValues[i] = Utils::isMissingValue(value) ? -1 : static_cast<int>(value);
+        }
+        char_array().swap(mColumns[classIndex]);
+    }
+    mClassIndex = classIndex;
+}
+
+ColumnStore::ColumnType ColumnStore::columnType(const int attIndex) const
+{
+    return mTypes[attIndex];
+}
+
+void ColumnStore::setColumnType(const int attIndex, const ColumnType type)
+{
+    if (type == mTypes[attIndex])
+    {
+        return;
+    }
+    materialize();
+    if (attIndex == mClassIndex)
+    {
+        // Applies once the attribute leaves the class column.
+        mTypes[attIndex] = type;
+        return;
+    }
+    int totalRows = (int)(mColumns[attIndex].size() / valueSize(mTypes[attIndex]));
+    double_array values(totalRows);
+    for (int i = 0; i < totalRows; i++)
+    {
+        values[i] = value(i, attIndex);
+    }
+    ColumnType newType = fitType(type, values.data(), 1, totalRows);
+    char_array column(valueSize(newType) * totalRows);
+    encode(newType, values.data(), 1, totalRows, column.data());
+    mColumns[attIndex].swap(column);
+    mTypes[attIndex] = newType;
+}
+
+double ColumnStore::value(const int row, const int attIndex) const
+{
+    if (attIndex == mClassIndex)
+    {
+        int classValue = classColumn()[row];
+        return (classValue < 0) ? Utils::missingValue() : classValue;
+    }
+    const char *data = rawColumn(attIndex);
+    switch (mTypes[attIndex])
+    {
+    case FLOAT_VALUES:
+        return reinterpret_cast<const float*>(data)[row];
+    case BYTE_CODES:
+    {
+        unsigned char code = reinterpret_cast<const unsigned char*>(data)[row];
+        return (code == MISSING_BYTE) ? Utils::missingValue() : code;
+    }
+    case SHORT_CODES:
+    {
+        unsigned short code = reinterpret_cast<const unsigned short*>(data)[row];
+        return (code == MISSING_SHORT) ? Utils::missingValue() : code;
+    }
+    default:
+        return reinterpret_cast<const double*>(data)[row];
+    }
+}
+
+void ColumnStore::setValue(const int row, const int attIndex, const double value)
+{
+    materialize();
+    if (attIndex == mClassIndex)
+    {
+        mClassValues[row] = Utils::isMissingValue(value) ? -1 : static_cast<int>(value);
+    }
+    else
+    {
+        storeValues(attIndex, row, &value, 1, 1);
+    }
+    markMissing(attIndex, row, &value, 1, 1);
+}
+
+bool ColumnStore::isMissing(const int row, const int attIndex) const
+{
+    return ((mMissingBits[attIndex][row / 64] >> (row % 64)) & 1) != 0;
+}
+
+int ColumnStore::numMissing(const int attIndex) const
+{
+    return mNumMissing[attIndex];
+}
+
+const std::uint64_t *ColumnStore::missingBits(const int attIndex) const
+{
+    return mMissingBits[attIndex].data();
+}
+
+double ColumnStore::weight(const int row) const
+{
+    return weightColumn()[row];
+}
+
+void ColumnStore::setWeight(const int row, const double weight)
+{
+    materialize();
+    mWeights[row] = weight;
+}
+
+const double *ColumnStore::column(const int attIndex) const
+{
+    return (mTypes[attIndex] == DOUBLE_VALUES) ? reinterpret_cast<const double*>(rawColumn(attIndex)) : nullptr;
+}
+
+const float *ColumnStore::floatColumn(const int attIndex) const
+{
+    return (mTypes[attIndex] == FLOAT_VALUES) ? reinterpret_cast<const float*>(rawColumn(attIndex)) : nullptr;
+}
+
+const unsigned char *ColumnStore::byteCodes(const int attIndex) const
+{
+    return (mTypes[attIndex] == BYTE_CODES) ? reinterpret_cast<const unsigned char*>(rawColumn(attIndex)) : nullptr;
+}
+
+const unsigned short *ColumnStore::shortCodes(const int attIndex) const
+{
+    return (mTypes[attIndex] == SHORT_CODES) ? reinterpret_cast<const unsigned short*>(rawColumn(attIndex)) : nullptr;
+}
+
+const char *ColumnStore::rawColumn(const int attIndex) const
+{
+    return (mFile != nullptr) ? mMappedColumns[attIndex] : mColumns[attIndex].data();
+}
+
+const int *ColumnStore::classColumn() const
+{
+    return (mFile != nullptr) ? mMappedClassValues : mClassValues.data();
+}
+
+const double *ColumnStore::weightColumn() const
+{
+    return (mFile != nullptr) ? mMappedWeights : mWeights.data();
+}
@@ -0,0 +1,391 @@
+#ifndef _COLUMNSTORE_
+#define _COLUMNSTORE_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include "Typedefs.h"
+
+class MappedFile;
+
+/**
+ * Class for storing the values of a set of instances column by column. Every
+ * attribute is held in one contiguous array, the weights in a weight column
+ * and the values of a nominal class attribute as class indices in a class
+ * column. Scans over one attribute therefore run through memory linearly
+ * instead of chasing a pointer to every instance's own value array.
+ *
+ * Each column is held in the narrowest type that fits its values: nominal
+ * attributes as one- or two-byte codes of their value indices, with the
+ * largest code standing for a missing value, and numeric attributes as
+ * doubles or, if so chosen, as floats. A column whose type cannot hold a
+ * value set later is widened to one that can.
+ *
+ * Every attribute, the class attribute included, also has a bitmap of the
+ * rows missing its value and a count of them, so that missing values are
+ * tested without decoding the value, and whole words of 64 rows or whole
+ * columns without missing values can be skipped at once.
+ *
+ * Rows are only ever appended; an instance stored here refers to its row.
+ *
+ * A store can also read its columns from a mapped file, so that data sets
+ * larger than the memory stay on disk and are paged in as they are scanned.
+ * Such a store is read-only: the first change copies it into memory.
+ */
+class ColumnStore
+{
+
+public:
+
+    /** The types a column can be held in. */
+    enum ColumnType {
+        DOUBLE_VALUES = 0,
+        FLOAT_VALUES,
+        BYTE_CODES,
+        SHORT_CODES
+    };
+
+    /** The code of a missing value in a column of BYTE_CODES. */
+    static const unsigned char MISSING_BYTE = 0xFF;
+
+    /** The code of a missing value in a column of SHORT_CODES. */
+    static const unsigned short MISSING_SHORT = 0xFFFF;
+
+protected:
+
+    /** The values per attribute. The column of the class attribute is unused. */
+    std::vector<char_array> mColumns;
+
+    /** The type of each column. */
+    std::vector<ColumnType> mTypes;
+
+    /** The class index per row (-1 if the class is missing). */
+    int_array mClassValues;
+
+    /** The weight per row. */
+    double_array mWeights;
+
+    /** The index of the attribute held in the class column, negative if none. */
+    int mClassIndex;
+
+    /** The file the columns are mapped from, null if they are held in memory. */
+    std::shared_ptr<MappedFile> mFile;
+
+    /** The values per attribute in the mapped file. */
+    std::vector<const char*> mMappedColumns;
+
+    /** The class indices in the mapped file. */
+    const int *mMappedClassValues;
+
+    /** The weights in the mapped file. */
+    const double *mMappedWeights;
+
+    /** The number of rows in the mapped file. */
+    int mMappedRows;
+
+    /** Per attribute, bit row % 64 of word row / 64 is set if the row misses the value. */
+    std::vector<std::vector<std::uint64_t>> mMissingBits;
+
+    /** The number of rows missing the value, per attribute. */
+    int_array mNumMissing;
+
+    /**
+     * Updates the missing-value bitmap of an attribute for the given rows.
+     *
+     * @param attIndex the attribute's index
+     * @param first the first row
+     * @param values the values of the rows
+     * @param stride the distance between two values
+     * @param count the number of rows
+     */
+    void markMissing(const int attIndex, const int first, const double *values, const size_t stride, const int count);
+
+    /**
+     * Returns the narrowest type, no narrower than the given one, that holds
+     * all of the given values.
+     *
+     * @param type the type the values are to be held in
+     * @param values the values
+     * @param stride the distance between two values
+     * @param count the number of values
+     * @return the type
+     */
+    static ColumnType fitType(const ColumnType type, const double *values, const size_t stride, const int count);
+
+    /**
+     * Stores values in a column, widening the column first if they do not
+     * fit its type.
+     *
+     * @param attIndex the attribute's index
+     * @param first the first row to store at; the column must hold at
+     *          least first + count rows
+     * @param values the values
+     * @param stride the distance between two values
+     * @param count the number of values
+     */
+    void storeValues(const int attIndex, const int first, const double *values, const size_t stride, const int count);
+
+public:
+
+    /**
+     * Creates an empty store.
+     *
+     * @param types the type of the column of each attribute; see typeFor()
+     * @param classIndex the index of the nominal class attribute, negative if
+     *          all attributes are to be stored as plain values
+     */
+    ColumnStore(const std::vector<ColumnType> &types, const int classIndex);
+
+    /**
+     * Creates a store reading its rows from a mapped file.
+     *
+     * @param types the type of the column of each attribute
+     * @param classIndex the index of the attribute held in the class column,
+     *          negative if none
+     * @param numRows the number of rows
+     * @param columns the values per attribute in the file; the entry of the
+     *          class attribute is unused
+     * @param classValues the class indices in the file, null if there is no class column
+     * @param weights the weights in the file
+     * @param file the file, kept mapped as long as the store exists
+     */
+    ColumnStore(const std::vector<ColumnType> &types, const int classIndex, const int numRows, const std::vector<const char*> &columns, const int *classValues, const double *weights, const std::shared_ptr<MappedFile> &file);
+
+    /**
+     * Returns the column type for the values of an attribute.
+     *
+     * @param numValues the number of values of a nominal attribute, negative
+     *          for any other attribute
+     * @param singlePrecision whether numeric values are to be held as floats
+     * @return the narrowest type holding every value of the attribute
+     */
+    static ColumnType typeFor(const int numValues, const bool singlePrecision);
+
+    /**
+     * Returns the number of bytes of a value in a column of the given type.
+     *
+     * @param type the column type
+     * @return the size of a value
+     */
+    static size_t valueSize(const ColumnType type);
+
+    /**
+     * Converts values into the layout of a column of the given type.
+     *
+     * @param type the column type
+     * @param values the values
+     * @param stride the distance between two values
+     * @param count the number of values
+     * @param out the place for count values of the column type
+     * @return false if a value does not fit the type
+     */
+    static bool encode(const ColumnType type, const double *values, const size_t stride, const int count, char *out);
+
+    /**
+     * Returns whether the rows are read from a mapped file.
+     *
+     * @return true if the store is mapped
+     */
+    bool isMapped() const;
+
+    /**
+     * Copies the columns of a mapped store into memory and releases the
+     * file. Does nothing if the store is held in memory already.
+     */
+    void materialize();
+
+    /**
+     * Reserves space for the given number of rows.
+     *
+     * @param capacity the number of rows to reserve
+     */
+    void reserve(const int capacity);
+
+    /**
+     * Appends a row to the store.
+     *
+     * @param values the attribute values of the row
+     * @param weight the weight of the row
+     * @return the index of the new row
+     */
+    int add(const double_array &values, const double weight);
+
+    /**
+     * Appends rows of equal weight to the store.
+     *
+     * @param values the attribute values of the rows, row after row
+     * @param count the number of rows
+     * @param weight the weight of every row
+     * @return the index of the first new row
+     */
+    int addRows(const double *values, const int count, const double weight);
+
+    /**
+     * Returns the number of rows.
+     *
+     * @return the number of rows
+     */
+    int numRows() const;
+
+    /**
+     * Returns the number of attributes.
+     *
+     * @return the number of attributes
+     */
+    int numAttributes() const;
+
+    /**
+     * Returns the index of the attribute held in the class column.
+     *
+     * @return the class index, negative if there is no class column
+     */
+    int classIndex() const;
+
+    /**
+     * Moves the given nominal attribute into the class column. The previous
+     * class attribute is moved back into its own column.
+     *
+     * @param classIndex the index of the new class attribute, negative if
+     *          there is to be no class column
+     */
+    void setClassIndex(const int classIndex);
+
+    /**
+     * Returns the type of the column of an attribute.
+     *
+     * @param attIndex the attribute's index
+     * @return the column type
+     */
+    ColumnType columnType(const int attIndex) const;
+
+    /**
+     * Converts the column of an attribute to another type. Values that do
+     * not fit the new type widen it further.
+     *
+     * @param attIndex the attribute's index
+     * @param type the new column type
+     */
+    void setColumnType(const int attIndex, const ColumnType type);
+
+    /**
+     * Returns a value in internal format.
+     *
+     * @param row the row
+     * @param attIndex the attribute's index
+     * @return the value (missing values are coded as NaN)
+     */
+    double value(const int row, const int attIndex) const;
+
+    /**
+     * Tests if a value is missing, without decoding it.
+     *
+     * @param row the row
+     * @param attIndex the attribute's index
+     * @return true if the value is missing
+     */
+    bool isMissing(const int row, const int attIndex) const;
+
+    /**
+     * Returns the number of rows missing the value of an attribute.
+     *
+     * @param attIndex the attribute's index
+     * @return the number of missing values
+     */
+    int numMissing(const int attIndex) const;
+
+    /**
+     * Returns the missing-value bitmap of an attribute: bit row % 64 of
+     * word row / 64 is set if the row misses the value. The bits past the
+     * last row are clear. The array is invalidated when rows are added.
+     *
+     * @param attIndex the attribute's index
+     * @return (numRows() + 63) / 64 words
+     */
+    const std::uint64_t *missingBits(const int attIndex) const;
+
+    /**
+     * Sets a value in internal format.
+     *
+     * @param row the row
+     * @param attIndex the attribute's index
+     * @param value the new value
+     */
+    void setValue(const int row, const int attIndex, const double value);
+
+    /**
+     * Returns the weight of a row.
+     *
+     * @param row the row
+     * @return the weight
+     */
+    double weight(const int row) const;
+
+    /**
+     * Sets the weight of a row.
+     *
+     * @param row the row
+     * @param weight the new weight
+     */
+    void setWeight(const int row, const double weight);
+
+    /**
+     * Returns the values of an attribute held as doubles. The array is
+     * invalidated when rows are added or the column changes its type.
+     *
+     * @param attIndex the attribute's index
+     * @return the column of the attribute, numRows() values; null if the
+     *         column is of another type
+     */
+    const double *column(const int attIndex) const;
+
+    /**
+     * Returns the values of an attribute held as floats.
+     *
+     * @param attIndex the attribute's index
+     * @return the column of the attribute, null if it is of another type
+     */
+    const float *floatColumn(const int attIndex) const;
+
+    /**
+     * Returns the codes of an attribute held in one byte per value.
+     *
+     * @param attIndex the attribute's index
+     * @return the column of the attribute, null if it is of another type
+     */
+    const unsigned char *byteCodes(const int attIndex) const;
+
+    /**
+     * Returns the codes of an attribute held in two bytes per value.
+     *
+     * @param attIndex the attribute's index
+     * @return the column of the attribute, null if it is of another type
+     */
+    const unsigned short *shortCodes(const int attIndex) const;
+
+    /**
+     * Returns the values of an attribute in their column type, as laid out
+     * in a file the store can be mapped from.
+     *
+     * @param attIndex the attribute's index
+     * @return numRows() values of size valueSize(columnType(attIndex))
+     */
+    const char *rawColumn(const int attIndex) const;
+
+    /**
+     * Returns the class indices of all rows (-1 for missing classes).
+     * The array is invalidated when rows are added.
+     *
+     * @return the class column, numRows() values
+     */
+    const int *classColumn() const;
+
+    /**
+     * Returns the weights of all rows. The array is invalidated when rows
+     * are added.
+     *
+     * @return the weight column, numRows() values
+     */
+    const double *weightColumn() const;
+};
+
+#endif    // _COLUMNSTORE_
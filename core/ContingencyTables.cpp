@@ -1,14 +1,24 @@
 #include "ContingencyTables.h"
 
 const double ContingencyTables::MAX_INT_FOR_CACHE_PLUS_ONE = 10000;
-double_array ContingencyTables::INT_N_LOG_N_CACHE = double_array(static_cast<int>(MAX_INT_FOR_CACHE_PLUS_ONE));
+const double_array ContingencyTables::INT_N_LOG_N_CACHE = ContingencyTables::intNLogNCache();
 
 
-ContingencyTables::ContingencyTables() {
+double_array ContingencyTables::intNLogNCache() {
+    double_array cache(static_cast<int>(MAX_INT_FOR_CACHE_PLUS_ONE));
     for (int i = 1; i < MAX_INT_FOR_CACHE_PLUS_ONE; i++) {
         double d = static_cast<double>(i);
-        INT_N_LOG_N_CACHE[i] = d * log(d);
+        cache[i] = d * log(d);
     }
+    return cache;
+}
+
+const double *ContingencyTables::intNLogNCacheData() {
+    return INT_N_LOG_N_CACHE.data();
+}
+
+int ContingencyTables::intNLogNCacheSize() {
+    return static_cast<int>(MAX_INT_FOR_CACHE_PLUS_ONE);
 }
 
 double ContingencyTables::lnFunc(const double num) {
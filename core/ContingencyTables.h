@@ -15,19 +15,32 @@ private:
 
     /** Cache of integer logs */
     static const double MAX_INT_FOR_CACHE_PLUS_ONE;
-    static double_array INT_N_LOG_N_CACHE;
+    static const double_array INT_N_LOG_N_CACHE;
 
     /**
-     * Initialize cache
+     * Computes the cache of integer logs.
      */
-    ContingencyTables();
+    static double_array intNLogNCache();
+
+public:
 
     /**
-     * Help method for computing entropy.
+     * Help method for computing entropy. Returns num * log(num), taken from
+     * the cache for small integers, which yields exactly the same value.
      */
-public:
     static double lnFunc(const double num);
 
+    /**
+     * Returns the cache of n * log(n) for the integers below
+     * intNLogNCacheSize(), for kernels that look the values up themselves.
+     */
+    static const double *intNLogNCacheData();
+
+    /**
+     * Returns the number of integers in the cache of n * log(n).
+     */
+    static int intNLogNCacheSize();
+
 };
 
 #endif    //#ifndef _CONTINGENCYTABLES_
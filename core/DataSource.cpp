@@ -4,11 +4,265 @@
 #include "Attribute.h"
 #include "Utils.h"
 #include "Consts.h"
+#include "MappedFile.h"
+#include "ThreadPool.h"
+#include "ColumnStore.h"
+#include "BinaryWriter.h"
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#include <share.h>
+#else
+#include <unistd.h>
+#endif
+#include <cstdio>
+#include <cstdlib>
 #include <sstream>
+#include <cctype>
+#include <cstring>
+#include <cstdint>
+#include <memory>
+#include <exception>
+#include <stdexcept>
+
+namespace
+{
+    /** The powers of ten that are exact doubles. */
+    const double POWERS_OF_TEN[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+
+    /** Whether removeTrailingPeriod() strips the given character. */
+    inline bool isTrimChar(const char c)
+    {
+        return c != '\0' && strchr(TRIMCHARS, c) != nullptr;
+    }
+
+    /** A token of an ARFF line. */
+    struct ArffToken
+    {
+        /** The start of the token, inside the quotes if it is quoted. */
+        const char *begin;
+
+        /** The end of the token. */
+        const char *end;
+
+        /** Whether the token is quoted. */
+        bool quoted;
+    };
+
+    /** Whether the given character separates ARFF tokens, as in Weka. */
+    inline bool isArffSeparator(const char c)
+    {
+        return (unsigned char)c <= ' ' || c == ',';
+    }
+
+    /**
+     * Reads the next token of an ARFF line. Whitespace and commas separate
+     * tokens, '{' and '}' are tokens of their own and '%' starts a comment.
+     *
+     * @param p the position to read from, advanced past the token
+     * @param end the end of the line
+     * @param token the token read
+     * @return false if the line has no more tokens
+     */
+    bool nextArffToken(const char *&p, const char *end, ArffToken &token)
+    {
+        while (p < end && isArffSeparator(*p))
+        {
+            p++;
+        }
+        if (p == end || *p == '%')
+        {
+            p = end;
+            return false;
+        }
+        token.quoted = (*p == '\'' || *p == '"');
+        if (token.quoted)
+        {
+            char quote = *p++;
+            token.begin = p;
+            while (p < end && *p != quote)
+            {
+                p += (*p == '\\' && p + 1 < end) ? 2 : 1;
+            }
+            if (p == end)
+            {
+                throw string("unterminated quoted value: ") + string(token.begin - 1, end);
+            }
+            token.end = p++;
+        }
+        else if (*p == '{' || *p == '}')
+        {
+            token.begin = p++;
+            token.end = p;
+        }
+        else
+        {
+            token.begin = p;
+            while (p < end && !isArffSeparator(*p) && *p != '%' && *p != '{' && *p != '}')
+            {
+                p++;
+            }
+            token.end = p;
+        }
+        return true;
+    }
+
+    /**
+     * Returns the text of an ARFF token, with the escapes of a quoted token
+     * replaced.
+     *
+     * @param token the token
+     * @param value the string the text is written to
+     */
+    void arffValue(const ArffToken &token, string &value)
+    {
+        value.assign(token.begin, token.end);
+        if (!token.quoted || value.find('\\') == string::npos)
+        {
+            return;
+        }
+        string unescaped;
+        for (size_t i = 0; i < value.size(); i++)
+        {
+            if (value[i] == '\\' && i + 1 < value.size())
+            {
+                char c = value[++i];
+                unescaped += (c == 'n') ? '\n' : (c == 't') ? '\t' : (c == 'r') ? '\r' : c;
+            }
+            else
+            {
+                unescaped += value[i];
+            }
+        }
+        value = unescaped;
+    }
+
+    /**
+     * Returns the modification time of a file in nanoseconds, so that a file
+     * rewritten within the same second as the last look at it still shows a
+     * different time.
+     *
+     * @param status the status of the file
+     * @return the modification time
+     */
+    long long modificationTime(const struct stat &status)
+    {
+#if defined(_WIN32)
+        return (long long)status.st_mtime * 1000000000LL;
+#elif defined(__APPLE__)
+        return (long long)status.st_mtimespec.tv_sec * 1000000000LL + status.st_mtimespec.tv_nsec;
+#else
+        return (long long)status.st_mtim.tv_sec * 1000000000LL + status.st_mtim.tv_nsec;
+#endif
+    }
+
+    /**
+     * Returns the permissions of a file, which a cache of the file is given
+     * as well.
+     *
+     * @param path the file
+     * @return the permission bits, those of a file readable by everyone if
+     *          the file cannot be examined
+     */
+    int permissions(const string &path)
+    {
+        struct stat status;
+        if (stat(path.c_str(), &status) != 0)
+        {
+            return 0644;
+        }
+        return (int)(status.st_mode & 0777);
+    }
+
+    /**
+     * Creates an empty file with a unique name next to the given one, for
+     * writing the file completely before it replaces the given one. Every
+     * writer gets a file of its own, so concurrent writers of the same file
+     * do not write into each other's temporary file.
+     *
+     * @param target the file to be replaced
+     * @param mode the permissions of the new file
+     * @return the name of the new file, empty if it could not be created
+     */
+    string createTemporaryFile(const string &target, const int mode)
+    {
+        std::vector<char> name(target.begin(), target.end());
+        const char suffix[] = ".XXXXXX";
+        name.insert(name.end(), suffix, suffix + sizeof(suffix));
+#ifdef _WIN32
+        int fd = -1;
+        if (_mktemp_s(name.data(), name.size()) != 0
+            || _sopen_s(&fd, name.data(), _O_CREAT | _O_EXCL | _O_WRONLY | _O_BINARY, _SH_DENYNO, _S_IREAD | _S_IWRITE) != 0)
+        {
+            return string();
+        }
+        _close(fd);
+#else
+        int fd = mkstemp(name.data());
+        if (fd < 0)
+        {
+            return string();
+        }
+        fchmod(fd, (mode_t)mode);
+        close(fd);
+#endif
+        return string(name.data());
+    }
+
+    /**
+     * Moves a completely written file over the given one.
+     *
+     * @param temporary the written file
+     * @param target the file to replace
+     * @return false if the file could not be moved; it is deleted then
+     */
+    bool replaceFile(const string &temporary, const string &target)
+    {
+        if (std::rename(temporary.c_str(), target.c_str()) == 0)
+        {
+            return true;
+        }
+        // Windows does not rename onto an existing file.
+        std::remove(target.c_str());
+        if (std::rename(temporary.c_str(), target.c_str()) == 0)
+        {
+            return true;
+        }
+        std::remove(temporary.c_str());
+        return false;
+    }
+
+    /** Whether a token is the given keyword, ignoring case. */
+    bool isKeyword(const ArffToken &token, const char *keyword)
+    {
+        size_t length = strlen(keyword);
+        if (token.quoted || (size_t)(token.end - token.begin) != length)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < length; i++)
+        {
+            if (tolower((unsigned char)token.begin[i]) != keyword[i])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+}
 
 DataSource::DataSource(const string &location)
 {
     mNumAttribs = 0;
+    mNumThreads = 0;
+    mUseCache = true;
+    mSinglePrecision = false;
+    mIsArff = false;
+    mDataOffset = 0;
 	string location_ = location;
     FILE *file = fopen(location.c_str(), "r");
     mStructure = nullptr;
@@ -33,6 +287,19 @@ DataSource::DataSource(const string &location)
         fname = fileStem + string(".names");
     }
     mFileStem = fileStem;
+
+    string extension = location_.substr(location_.rfind('.') + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    if (location_.rfind('.') != string::npos && extension == "arff")
+    {
+        // An ARFF file holds both the header and the data.
+        mIsArff = true;
+        mSourceFileName = location_;
+        mSourceFileData = location_;
+        mSourceFileCache = location_ + string(".c48cache");
+        return;
+    }
+
     mSourceFileName = path + "/" + fname;
     try
     {
@@ -44,22 +311,29 @@ DataSource::DataSource(const string &location)
     }
 
     mSourceFileData = path + "/" + fileStem + string(".data");
-    try
-    {
-        mDataReader.open(mSourceFileData, std::ios_base::in);
-    }
-    catch (std::exception ex)
-    {
-        throw string("File not found : ") + (path + "/" + fname);
-    }
+    mSourceFileCache = path + "/" + fileStem + string(".c48cache");
 }
 
 void DataSource::reset()
 {
-    mDataReader.close();
     mNamesReader.close();
 }
 
+void DataSource::setNumThreads(const int numThreads)
+{
+    mNumThreads = numThreads;
+}
+
+void DataSource::setUseCache(const bool useCache)
+{
+    mUseCache = useCache;
+}
+
+void DataSource::setSinglePrecision(const bool singlePrecision)
+{
+    mSinglePrecision = singlePrecision;
+}
+
 Instances *DataSource::getStructure()
 {
     if (mSourceFileName.empty())
@@ -69,7 +343,14 @@ Instances *DataSource::getStructure()
 
     if (mStructure == nullptr)
     {
-        readHeader(mNamesReader);
+        if (mIsArff)
+        {
+            readArffHeader();
+        }
+        else
+        {
+            readHeader(mNamesReader);
+        }
     }
 
     return mStructure;
@@ -226,6 +507,191 @@ void DataSource::readHeader(std::fstream &inNameStream)
         mIgnore[ignores[i]] = true;
     }
 }
+void DataSource::readArffHeader()
+{
+    MappedFile file(mSourceFileData);
+    const char *data = file.data();
+    const char *end = data + file.size();
+    string relationName = mFileStem;
+    std::vector<Attribute*> attribDefs;
+    ArffToken token;
+    string value;
+    bool foundData = false;
+
+    const char *line = data;
+    while (line < end && !foundData)
+    {
+        const char *lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+        if (lineEnd == nullptr)
+        {
+            lineEnd = end;
+        }
+        const char *start = line;
+        const char *p = line;
+        line = (lineEnd < end) ? lineEnd + 1 : end;
+        if (!nextArffToken(p, lineEnd, token))
+        {
+            continue;
+        }
+
+        if (isKeyword(token, "@relation"))
+        {
+            if (nextArffToken(p, lineEnd, token))
+            {
+                arffValue(token, relationName);
+            }
+        }
+        else if (isKeyword(token, "@attribute"))
+        {
+            string attribName;
+            if (!nextArffToken(p, lineEnd, token))
+            {
+                throw string("attribute name expected: ") + string(start, lineEnd);
+            }
+            arffValue(token, attribName);
+            if (!nextArffToken(p, lineEnd, token))
+            {
+                throw string("attribute type expected: ") + attribName;
+            }
+            if (!token.quoted && *token.begin == '{')
+            {
+                string_array attribVals;
+                while (nextArffToken(p, lineEnd, token) && (token.quoted || *token.begin != '}'))
+                {
+                    arffValue(token, value);
+                    attribVals.push_back(value);
+                }
+                attribDefs.push_back(new Attribute(attribName, attribVals));
+            }
+            else if (isKeyword(token, "numeric") || isKeyword(token, "real") || isKeyword(token, "integer"))
+            {
+                attribDefs.push_back(new Attribute(attribName));
+            }
+            else
+            {
+                throw string("unsupported attribute type: ") + string(token.begin, token.end) + string(" of attribute ") + attribName;
+            }
+        }
+        else if (isKeyword(token, "@data"))
+        {
+            foundData = true;
+            mDataOffset = line - data;
+        }
+        else
+        {
+            throw string("unexpected line in ARFF header: ") + string(token.begin, lineEnd);
+        }
+    }
+    if (!foundData)
+    {
+        throw "premature end of file";
+    }
+    if (attribDefs.empty())
+    {
+        throw "no attributes declared";
+    }
+
+    // ARFF files do not name the class; as in Weka, it is the last attribute.
+    mStructure = new Instances(relationName, attribDefs, 0);
+    mStructure->setClassIndex(mStructure->numAttributes() - 1);
+    mNumAttribs = mStructure->numAttributes();
+    mIgnore = bool_array(mNumAttribs);
+}
+
+bool DataSource::getArffInstance(const char *begin, const char *end, const bool_array &nominal, double *values, string &value) const
+{
+    int numAttributes = mStructure->numAttributes();
+    ArffToken token;
+    const char *p = begin;
+
+    if (!nextArffToken(p, end, token))
+    {
+        return false;
+    }
+
+    bool sparse = !token.quoted && *token.begin == '{';
+    int counter = 0;
+    if (sparse)
+    {
+        // Values not listed in a sparse row are 0, i.e. the first value of
+        // a nominal attribute.
+        for (int j = 0; j < numAttributes; j++)
+        {
+            values[j] = 0;
+        }
+        if (!nextArffToken(p, end, token))
+        {
+            throw string("'}' expected: ") + string(begin, end);
+        }
+    }
+
+    while (true)
+    {
+        if (sparse)
+        {
+            if (!token.quoted && *token.begin == '}')
+            {
+                break;
+            }
+            arffValue(token, value);
+            char *indexEnd;
+            long index = strtol(value.c_str(), &indexEnd, 10);
+            if (*indexEnd != '\0' || value.empty() || index < 0 || index >= numAttributes)
+            {
+                throw string("invalid index in sparse row: ") + value;
+            }
+            counter = (int)index;
+            if (!nextArffToken(p, end, token))
+            {
+                throw string("value expected in sparse row: ") + string(begin, end);
+            }
+        }
+        else if (counter >= numAttributes)
+        {
+            throw string("wrong number of values in line: ") + string(begin, end);
+        }
+
+        if (!token.quoted && token.end - token.begin == 1 && *token.begin == '?')
+        {
+            values[counter] = Utils::missingValue();
+        }
+        else if (nominal[counter])
+        {
+            arffValue(token, value);
+            int index = mStructure->attribute(counter).indexOfValue(value);
+            if (index == -1)
+            {
+                throw string("nominal value not declared in header :") + value + string(" column ") + std::to_string(counter);
+            }
+            values[counter] = index;
+        }
+        else
+        {
+            values[counter] = parseNumber(token.begin, token.end);
+        }
+        counter++;
+
+        if (!nextArffToken(p, end, token))
+        {
+            if (sparse)
+            {
+                throw string("'}' expected: ") + string(begin, end);
+            }
+            break;
+        }
+    }
+
+    if (!sparse && counter != numAttributes)
+    {
+        throw string("wrong number of values in line: ") + string(begin, end);
+    }
+    if (sparse && nextArffToken(p, end, token))
+    {
+        throw string("unexpected value after sparse row: ") + string(begin, end);
+    }
+    return true;
+}
+
 string DataSource::removeTrailingPeriod(string &val) const
 {
     val.erase(val.find_last_not_of(TRIMCHARS) + 1);
@@ -233,49 +699,165 @@ string DataSource::removeTrailingPeriod(string &val) const
     return val;
 }
 
-Instance *DataSource::getInstance(const string &inData) const
+double DataSource::parseNumber(const char *begin, const char *end)
 {
-    double_array instance = double_array(mStructure->numAttributes());
+    const char *p = begin;
+    bool negative = false;
+    if (p < end && (*p == '+' || *p == '-'))
+    {
+        negative = (*p == '-');
+        p++;
+    }
 
+    // Collect the digits as an integer while it stays below 2^53.
+    const uint64_t limit = ((uint64_t)1 << 53) / 10;
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int numDigits = 0;
+    bool exact = true;
+    for (; p < end && *p >= '0' && *p <= '9'; p++, numDigits++)
+    {
+        exact = exact && mantissa < limit;
+        mantissa = mantissa * 10 + (*p - '0');
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++, numDigits++)
+        {
+            exact = exact && mantissa < limit;
+            mantissa = mantissa * 10 + (*p - '0');
+            exponent--;
+        }
+    }
+    if (numDigits > 0 && p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char *q = p + 1;
+        bool negativeExponent = false;
+        if (q < end && (*q == '+' || *q == '-'))
+        {
+            negativeExponent = (*q == '-');
+            q++;
+        }
+        int value = 0;
+        const char *digits = q;
+        for (; q < end && *q >= '0' && *q <= '9' && value < 1000; q++)
+        {
+            value = value * 10 + (*q - '0');
+        }
+        if (q > digits)
+        {
+            exponent += negativeExponent ? -value : value;
+            p = q;
+        }
+    }
+
+    // A mantissa and a power of ten that are both exact give the correctly
+    // rounded result with one multiplication or division, as std::stod.
+    if (numDigits > 0 && p == end && exact && exponent >= -22 && exponent <= 22)
+    {
+        double value = (double)mantissa;
+        value = (exponent < 0) ? value / POWERS_OF_TEN[-exponent] : value * POWERS_OF_TEN[exponent];
+        return negative ? -value : value;
+    }
+    return std::stod(string(begin, end));
+}
+
+void DataSource::getInstance(const char *begin, const char *end, const bool_array &nominal, double *values, string &value) const
+{
+    int numAttributes = mStructure->numAttributes();
     int i = 0, counter = 0;
-    std::stringstream dataStream;
-    string value;
 
-    dataStream << inData;
-    while (std::getline(dataStream, value, ','))
+    for (int j = 0; j < numAttributes; j++)
+    {
+        values[j] = 0;
+    }
+
+    // Split at the commas; like std::getline, a comma ending the line is not
+    // followed by an empty value.
+    const char *field = begin;
+    while (field < end)
     {
+        const char *fieldEnd = static_cast<const char*>(memchr(field, ',', end - field));
+        if (fieldEnd == nullptr)
+        {
+            fieldEnd = end;
+        }
+        if (i >= mNumAttribs)
+        {
+            throw string("too many values in line: ") + string(begin, end);
+        }
         if (!mIgnore[i])
         {
-            value = removeTrailingPeriod(value);
-            if (value.compare("?") == 0)
+            const char *first = field;
+            const char *last = fieldEnd;
+            while (first < last && isTrimChar(*first))
             {
-                instance[counter++] = Utils::missingValue();
+                first++;
             }
-            else
+            while (last > first && isTrimChar(last[-1]))
             {
-                if (mStructure->attribute(counter).isNominal())
-                {
-                    int index = mStructure->attribute(counter).indexOfValue(value);
-                    if (index == -1)
-                    {
-                        throw string("nominal value not declared in header :") + value + string(" column ") + std::to_string(i);
-                    }
-                    instance[counter++] = index;
-                }
-                else if (mStructure->attribute(counter).isNumeric())
-                {
-                    instance[counter++] = std::stod(value);
+                last--;
+            }
 
-                }
-                else
+            if (last - first == 1 && *first == '?')
+            {
+                values[counter++] = Utils::missingValue();
+            }
+            else if (nominal[counter])
+            {
+                value.assign(first, last);
+                int index = mStructure->attribute(counter).indexOfValue(value);
+                if (index == -1)
                 {
-                    throw "Shouldn't get here";
+                    throw string("nominal value not declared in header :") + value + string(" column ") + std::to_string(i);
                 }
+                values[counter++] = index;
+            }
+            else
+            {
+                values[counter++] = parseNumber(first, last);
             }
         }
         i++;
+        field = fieldEnd + 1;
     }
-    return new Instance(1.0, instance);
+}
+
+int DataSource::getInstances(const char *begin, const char *end, const bool_array &nominal, double_array &values) const
+{
+    int numAttributes = mStructure->numAttributes();
+    int numRows = 0;
+    string value;
+
+    const char *line = begin;
+    while (line < end)
+    {
+        const char *lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+        if (lineEnd == nullptr)
+        {
+            lineEnd = end;
+        }
+        if (mIsArff)
+        {
+            values.resize(values.size() + numAttributes);
+            if (getArffInstance(line, lineEnd, nominal, values.data() + values.size() - numAttributes, value))
+            {
+                numRows++;
+            }
+            else
+            {
+                values.resize(values.size() - numAttributes);
+            }
+        }
+        else if (lineEnd > line && *line != '|')
+        {
+            values.resize(values.size() + numAttributes);
+            getInstance(line, lineEnd, nominal, values.data() + values.size() - numAttributes, value);
+            numRows++;
+        }
+        line = lineEnd + 1;
+    }
+    return numRows;
 }
 
 Instances *DataSource::getDataSet()
@@ -283,36 +865,491 @@ Instances *DataSource::getDataSet()
     Instances *result = nullptr;
     if (mStructure == nullptr)
         getStructure();
-    result = getInstance(mDataReader);
-    try
+    mStructure->setSinglePrecision(mSinglePrecision);
+    if (mUseCache)
     {
-        // close the stream
-        mDataReader.close();
-        // reset();
+        result = readCache();
+        if (result != nullptr)
+        {
+            return result;
+        }
     }
-    catch (std::exception ex)
+    MappedFile file(mSourceFileData);
+    result = getInstances(file);
+    if (mUseCache)
     {
-        std::cout << ex.what();
+        writeCache(*result);
     }
     return result;
 }
 
-Instances *DataSource::getInstance(std::fstream& inDataStream) const
+std::shared_ptr<ColumnStore> DataSource::getColumns()
 {
-    if (inDataStream.good() && inDataStream.eof())
+    if (mStructure == nullptr)
+        getStructure();
+    mStructure->setSinglePrecision(mSinglePrecision);
+    std::shared_ptr<ColumnStore> result = readColumns(true);
+    if (result != nullptr)
+    {
+        return result;
+    }
+    MappedFile file(mSourceFileData);
+    return spillColumns(file);
+}
+
+void DataSource::parseChunks(const MappedFile &file, const std::function<void(const double*, const int, const size_t)> &addRows) const
+{
+    if (mDataOffset > file.size())
     {
         throw "premature end of file";
     }
-    string line;
+    // The rows of an ARFF file start after its header.
+    const char *data = file.data() + mDataOffset;
+    const char *end = file.data() + file.size();
+    int numAttributes = mStructure->numAttributes();
+    bool_array nominal(numAttributes);
+    for (int i = 0; i < numAttributes; i++)
+    {
+        nominal[i] = mStructure->attribute(i).isNominal();
+        if (!nominal[i] && !mStructure->attribute(i).isNumeric())
+        {
+            throw "Shouldn't get here";
+        }
+    }
+
+    ThreadPool pool(mNumThreads);
+    int numChunks = 2 * pool.numThreads();
+    std::vector<const char*> bounds(numChunks + 1);
+    std::vector<double_array> values(numChunks);
+    int_array numRows(numChunks);
+    std::vector<std::exception_ptr> errors(numChunks);
+
+    // Parse a few chunks per thread at a time, so that the parsed values
+    // never take much more memory than the data set itself.
+    const char *position = data;
+    while (position < end)
+    {
+        bounds[0] = position;
+        for (int k = 1; k <= numChunks; k++)
+        {
+            const char *bound = bounds[k - 1];
+            if (end - bound > CHUNK_SIZE)
+            {
+                bound += CHUNK_SIZE;
+                const char *lineEnd = static_cast<const char*>(memchr(bound, '\n', end - bound));
+                bound = (lineEnd == nullptr) ? end : lineEnd + 1;
+            }
+            else
+            {
+                bound = end;
+            }
+            bounds[k] = bound;
+        }
+
+        pool.parallelFor(numChunks, [&](int k)
+        {
+            values[k].clear();
+            numRows[k] = 0;
+            try
+            {
+                numRows[k] = getInstances(bounds[k], bounds[k + 1], nominal, values[k]);
+            }
+            catch (...)
+            {
+                errors[k] = std::current_exception();
+            }
+        });
 
+        for (int k = 0; k < numChunks; k++)
+        {
+            // Report the error of the first line that cannot be parsed.
+            if (errors[k])
+            {
+                std::rethrow_exception(errors[k]);
+            }
+            addRows(values[k].data(), numRows[k], (size_t)(bounds[k + 1] - bounds[k]));
+        }
+        position = bounds[numChunks];
+    }
+}
+
+Instances *DataSource::getInstances(const MappedFile &file) const
+{
     Instances *result = new Instances(mStructure);
-    while (std::getline(inDataStream, line))
+    size_t dataSize = (file.size() > mDataOffset) ? file.size() - mDataOffset : 0;
+    bool reserved = false;
+    try
     {
-        if (line.empty() || line.find("|") == 0)
+        parseChunks(file, [&](const double *values, const int numRows, const size_t bytes)
         {
-            continue;
+            if (!reserved && numRows > 0)
+            {
+                // Reserve for the whole file from the density of the first chunk.
+                result->reserve((int)(numRows * ((double)dataSize / bytes) * 1.05));
+                reserved = true;
+            }
+            result->addRows(values, numRows, 1.0);
+        });
+    }
+    catch (...)
+    {
+        delete result;
+        throw;
+    }
+    return result;
+}
+
+int DataSource::countRows(const MappedFile &file) const
+{
+    if (mDataOffset > file.size())
+    {
+        throw "premature end of file";
+    }
+    const char *line = file.data() + mDataOffset;
+    const char *end = file.data() + file.size();
+    int numRows = 0;
+    while (line < end)
+    {
+        const char *lineEnd = static_cast<const char*>(memchr(line, '\n', end - line));
+        if (lineEnd == nullptr)
+        {
+            lineEnd = end;
+        }
+        if (mIsArff)
+        {
+            // A line without a token, i.e. blank or a comment, is no row.
+            const char *p = line;
+            while (p < lineEnd && isArffSeparator(*p))
+            {
+                p++;
+            }
+            if (p < lineEnd && *p != '%')
+            {
+                numRows++;
+            }
+        }
+        else if (lineEnd > line && *line != '|')
+        {
+            numRows++;
+        }
+        line = lineEnd + 1;
+    }
+    return numRows;
+}
+
+std::shared_ptr<ColumnStore> DataSource::spillColumns(const MappedFile &file) const
+{
+    int numRows = countRows(file);
+
+    CacheHeader header;
+    if (!getCacheHeader(header, numRows))
+    {
+        throw string("Cannot examine file: ") + mSourceFileData;
+    }
+    BinaryWriter writer;
+    mStructure->serializeHeader(writer);
+    header.headerSize = (long long)writer.buffer().size();
+    std::vector<size_t> offsets;
+    getCacheLayout(numRows, offsets);
+
+    int numAttributes = mStructure->numAttributes();
+    int classIndex = cacheClassIndex();
+    std::vector<ColumnStore::ColumnType> types = mStructure->columnTypes();
+    string temporary = createTemporaryFile(mSourceFileCache, permissions(mSourceFileData));
+    if (temporary.empty())
+    {
+        throw string("Cannot write file: ") + mSourceFileCache;
+    }
+    {
+        std::ofstream os(temporary, std::ios::binary);
+        if (!os)
+        {
+            std::remove(temporary.c_str());
+            throw string("Cannot write file: ") + temporary;
+        }
+        const char padding[8] = { 0 };
+        os.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+        os.write(writer.buffer().data(), writer.buffer().size());
+        os.write(padding, (8 - writer.buffer().size() % 8) % 8);
+
+        // Each chunk adds the next rows to every block of the file.
+        int written = 0;
+        double_array column;
+        int_array indices;
+        char_array block;
+        try
+        {
+            parseChunks(file, [&](const double *values, const int count, const size_t)
+            {
+                if (written + count > numRows)
+                {
+                    throw "The data file changed while it was read";
+                }
+                column.resize(count);
+                indices.resize(count);
+                for (int i = 0; i < numAttributes; i++)
+                {
+                    if (i == classIndex)
+                    {
+                        for (int row = 0; row < count; row++)
+                        {
+                            double value = values[(size_t)row * numAttributes + i];
+                            indices[row] = Utils::isMissingValue(value) ? -1 : static_cast<int>(value);
+                        }
+                        os.seekp(offsets[i] + sizeof(int) * written);
+                        os.write(reinterpret_cast<const char*>(indices.data()), sizeof(int) * count);
+                    }
+                    else
+                    {
+                        size_t valueSize = ColumnStore::valueSize(types[i]);
+                        block.resize(valueSize * count);
+                        if (!ColumnStore::encode(types[i], values + i, numAttributes, count, block.data()))
+                        {
+                            throw string("Value out of range of attribute ") + mStructure->attribute(i).name();
+                        }
+                        os.seekp(offsets[i] + valueSize * written);
+                        os.write(block.data(), block.size());
+                    }
+                }
+                column.assign(count, 1.0);
+                os.seekp(offsets[numAttributes] + sizeof(double) * written);
+                os.write(reinterpret_cast<const char*>(column.data()), sizeof(double) * count);
+                written += count;
+            });
+            if (written != numRows)
+            {
+                throw "The data file changed while it was read";
+            }
+        }
+        catch (...)
+        {
+            os.close();
+            std::remove(temporary.c_str());
+            throw;
+        }
+        if (!os)
+        {
+            os.close();
+            std::remove(temporary.c_str());
+            throw string("Cannot write file: ") + temporary;
+        }
+    }
+    if (!replaceFile(temporary, mSourceFileCache))
+    {
+        throw string("Cannot write file: ") + mSourceFileCache;
+    }
+
+    std::shared_ptr<ColumnStore> result = readColumns(true);
+    if (result == nullptr)
+    {
+        throw string("Cannot read file: ") + mSourceFileCache;
+    }
+    return result;
+}
+
+bool DataSource::getCacheHeader(CacheHeader &header, const int numRows) const
+{
+    struct stat names, data;
+    if (stat(mSourceFileName.c_str(), &names) != 0 || stat(mSourceFileData.c_str(), &data) != 0)
+    {
+        return false;
+    }
+
+    // Clear the padding as well, so that the header can be compared bytewise.
+    memset(&header, 0, sizeof(CacheHeader));
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.numAttributes = mStructure->numAttributes();
+    header.numRows = numRows;
+    header.namesSize = (long long)names.st_size;
+    header.namesTime = modificationTime(names);
+    header.dataSize = (long long)data.st_size;
+    header.dataTime = modificationTime(data);
+    header.numericSize = mSinglePrecision ? sizeof(float) : sizeof(double);
+    return true;
+}
+
+int DataSource::cacheClassIndex() const
+{
+    int classIndex = mStructure->classIndex();
+    return (classIndex >= 0 && mStructure->attribute(classIndex).isNominal()) ? classIndex : -1;
+}
+
+size_t DataSource::getCacheLayout(const int numRows, std::vector<size_t> &offsets) const
+{
+    BinaryWriter structure;
+    mStructure->serializeHeader(structure);
+    int numAttributes = mStructure->numAttributes();
+    int classIndex = cacheClassIndex();
+    std::vector<ColumnStore::ColumnType> types = mStructure->columnTypes();
+
+    offsets.resize(numAttributes + 1);
+    size_t position = sizeof(CacheHeader) + (structure.buffer().size() + 7) / 8 * 8;
+    for (int i = 0; i < numAttributes; i++)
+    {
+        offsets[i] = position;
+        size_t blockSize = (i == classIndex) ? sizeof(int) : ColumnStore::valueSize(types[i]);
+        position += (blockSize * numRows + 7) / 8 * 8;
+    }
+    offsets[numAttributes] = position;
+    return position + sizeof(double) * numRows;
+}
+
+std::shared_ptr<ColumnStore> DataSource::readColumns(const bool mapped) const
+{
+    std::shared_ptr<MappedFile> file;
+    try
+    {
+        file = std::make_shared<MappedFile>(mSourceFileCache);
+    }
+    catch (...)
+    {
+        return nullptr;
+    }
+
+    const char *data = file->data();
+    size_t size = file->size();
+    CacheHeader header, expected;
+    BinaryWriter structure;
+    mStructure->serializeHeader(structure);
+    int numAttributes = mStructure->numAttributes();
+    std::vector<size_t> offsets;
+
+    // The cache is only used if it was built from the current source files
+    // and holds exactly the header and the columns expected of it.
+    bool valid = size >= sizeof(CacheHeader);
+    if (valid)
+    {
+        memcpy(&header, data, sizeof(CacheHeader));
+        valid = header.numRows >= 0 && getCacheHeader(expected, header.numRows);
+    }
+    if (valid)
+    {
+        expected.headerSize = (long long)structure.buffer().size();
+        valid = memcmp(&header, &expected, sizeof(CacheHeader)) == 0;
+    }
+    if (valid)
+    {
+        valid = size == getCacheLayout(header.numRows, offsets)
+            && memcmp(data + sizeof(CacheHeader), structure.buffer().data(), structure.buffer().size()) == 0;
+    }
+    if (!valid)
+    {
+        return nullptr;
+    }
+
+    int classIndex = cacheClassIndex();
+    std::vector<const char*> columns(numAttributes, nullptr);
+    for (int i = 0; i < numAttributes; i++)
+    {
+        if (i != classIndex)
+        {
+            columns[i] = data + offsets[i];
         }
-        result->add(*getInstance(line));
     }
+    const int *classValues = (classIndex >= 0) ? reinterpret_cast<const int*>(data + offsets[classIndex]) : nullptr;
+    const double *weights = reinterpret_cast<const double*>(data + offsets[numAttributes]);
+    std::shared_ptr<ColumnStore> store = std::make_shared<ColumnStore>(mStructure->columnTypes(), classIndex, header.numRows, columns, classValues, weights, file);
+    if (!mapped)
+    {
+        store->materialize();
+    }
+    return store;
+}
+
+Instances *DataSource::readCache() const
+{
+    std::shared_ptr<ColumnStore> store = readColumns(false);
+    if (store == nullptr)
+    {
+        return nullptr;
+    }
+    Instances *result = new Instances(mStructure);
+    result->addRows(store);
     return result;
 }
+
+void DataSource::writeCache(Instances &data) const
+{
+    int numRows = data.numInstances();
+    int numAttributes = data.numAttributes();
+    CacheHeader header;
+    if (!getCacheHeader(header, numRows))
+    {
+        return;
+    }
+
+    // Only a set held in one column store in file order can be written
+    // column by column, which is how getInstances() builds it.
+    const ColumnStore *store = (numRows > 0) ? data.instance(0).store() : nullptr;
+    for (int i = 0; i < numRows; i++)
+    {
+        if (data.instance(i).store() != store || data.instance(i).row() != i)
+        {
+            return;
+        }
+    }
+    if (store != nullptr && (store->numRows() != numRows || store->classIndex() != cacheClassIndex()))
+    {
+        return;
+    }
+    // A column widened for values outside the header no longer fits the layout.
+    std::vector<ColumnStore::ColumnType> types = mStructure->columnTypes();
+    for (int i = 0; i < numAttributes && store != nullptr; i++)
+    {
+        if (i != store->classIndex() && store->columnType(i) != types[i])
+        {
+            return;
+        }
+    }
+
+    BinaryWriter writer;
+    mStructure->serializeHeader(writer);
+    header.headerSize = (long long)writer.buffer().size();
+
+    // Write to a temporary file first, so that no reader ever maps a
+    // partly written cache.
+    string temporary = createTemporaryFile(mSourceFileCache, permissions(mSourceFileData));
+    if (temporary.empty())
+    {
+        return;
+    }
+    {
+        std::ofstream os(temporary, std::ios::binary);
+        if (!os)
+        {
+            std::remove(temporary.c_str());
+            return;
+        }
+        const char padding[8] = { 0 };
+        os.write(reinterpret_cast<const char*>(&header), sizeof(CacheHeader));
+        os.write(writer.buffer().data(), writer.buffer().size());
+        os.write(padding, (8 - writer.buffer().size() % 8) % 8);
+
+        for (int i = 0; i < numAttributes && numRows > 0; i++)
+        {
+            if (i == store->classIndex())
+            {
+                os.write(reinterpret_cast<const char*>(store->classColumn()), sizeof(int) * numRows);
+                os.write(padding, (8 - sizeof(int) * numRows % 8) % 8);
+            }
+            else
+            {
+                size_t blockSize = ColumnStore::valueSize(types[i]) * numRows;
+                os.write(store->rawColumn(i), blockSize);
+                os.write(padding, (8 - blockSize % 8) % 8);
+            }
+        }
+        if (numRows > 0)
+        {
+            os.write(reinterpret_cast<const char*>(store->weightColumn()), sizeof(double) * numRows);
+        }
+        if (!os)
+        {
+            os.close();
+            std::remove(temporary.c_str());
+            return;
+        }
+    }
+    replaceFile(temporary, mSourceFileCache);
+}
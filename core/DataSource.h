@@ -7,14 +7,35 @@
 #include <vector>
 #include <algorithm>
 #include <iostream>
+#include <functional>
+#include <memory>
 #include "Typedefs.h"
 class Instance;
 class Instances;
+class MappedFile;
+class ColumnStore;
 
 
 /**
  * Helper class for loading data from files. Reads a file that is C45 format. Can take a filestem or filestem with .names or .data appended.
  * Assumes that path/&lt;filestem&gt;.names and path/&lt;filestem&gt;.data exist and contain the names and data respectively.
+ *
+ * A file ending in .arff is read as an ARFF file instead, with nominal and
+ * numeric attributes, dense and sparse rows, quoted values and '%'
+ * comments. Its last attribute is the class, as in Weka.
+ *
+ * The data file is mapped into memory and cut into chunks at line ends,
+ * which are parsed in parallel and appended to the data set in file order.
+ *
+ * The parsed data set is kept in a binary cache file next to the data file,
+ * path/&lt;filestem&gt;.c48cache, which later loads read instead of parsing
+ * the text again. The cache holds the header and the columns in the layout
+ * of a ColumnStore, and is rebuilt once the .names or .data file changes.
+ *
+ * Data sets larger than the memory can be read out of core: the data file
+ * is then streamed into the cache file a few chunks at a time, and its
+ * columns are returned mapped from there, without an instance per row, so
+ * that the system pages them in and out as the tree builder scans them.
  */
 class DataSource {
 
@@ -27,14 +48,19 @@ private:
     string mSourceFileName;
 
     /**
-     * Input stream for names file
+     * The cache filename.
      */
-    std::fstream mNamesReader;
+    string mSourceFileCache;
 
     /**
-     *    Input stream for data file
+     * Whether to read and write the cache file.
      */
-    std::fstream mDataReader;
+    bool mUseCache;
+
+    /**
+     * Input stream for names file
+     */
+    std::fstream mNamesReader;
 
     /**
      * Holds the filestem.
@@ -55,23 +81,208 @@ private:
     /** Holds the determined structure (header) of the data set. */
     Instances *mStructure;
 
+    /** Whether the source is an ARFF file. */
+    bool mIsArff;
+
+    /** The offset of the first row in the data file. */
+    size_t mDataOffset;
+
+    /** The number of threads to parse the data file with. */
+    int mNumThreads;
+
+    /** Whether to hold numeric values as floats. */
+    bool mSinglePrecision;
+
+    /** The number of bytes of the data file parsed by one task. */
+    static const int CHUNK_SIZE = 1 << 22;
+
     /**
-     * Reads an instance using the supplied file stream.
+     * The fixed-size start of a cache file. The header written by
+     * Instances::serializeHeader() follows, then one block per attribute and
+     * a block of weights, each starting at a multiple of 8 bytes. The block
+     * of a nominal class holds int class indices, all others hold the values
+     * in the column type Instances::columnTypes() gives the attribute.
+     */
+    struct CacheHeader
+    {
+        /** CACHE_MAGIC. */
+        int magic;
+
+        /** The version of the layout. */
+        int version;
+
+        /** The number of attributes. */
+        int numAttributes;
+
+        /** The number of rows. */
+        int numRows;
+
+        /** The size of the names file the cache was built from. */
+        long long namesSize;
+
+        /** The modification time of the names file the cache was built from, in nanoseconds. */
+        long long namesTime;
+
+        /** The size of the data file the cache was built from. */
+        long long dataSize;
+
+        /** The modification time of the data file the cache was built from, in nanoseconds. */
+        long long dataTime;
+
+        /** The number of bytes of the header written by Instances::serializeHeader(). */
+        long long headerSize;
+
+        /** The number of bytes of a numeric value, 4 if they are held as floats. */
+        long long numericSize;
+    };
+
+    /** Identifies a cache file; also tells apart files of the other byte order */
+    static const int CACHE_MAGIC = 0x44383443;
+
+    /** The version of the cache layout */
+    static const int CACHE_VERSION = 3;
+
+    /**
+     * Returns the attribute whose block in the cache file holds class
+     * indices, as in the column store of the data set.
      *
-     * @param inStream the file stream to use
-     * @return an Instance or null if there are no more instances to read
-     * @exception IOException if an error occurs
+     * @return the class index if the class attribute is nominal, -1 otherwise
      */
-    Instances *getInstance(std::fstream& inStream) const;
+    int cacheClassIndex() const;
 
     /**
-     * Reads an instance from the given line.
+     * Returns where the blocks of a cache file start.
      *
-     * @param inDat the file stream to use
-     * @return an Instance or null if there are no more instances to read
-     * @exception IOException if an error occurs
+     * @param numRows the number of rows
+     * @param offsets filled with the offset of the block of each attribute,
+     *          followed by the offset of the weights
+     * @return the size of the file
+     */
+    size_t getCacheLayout(const int numRows, std::vector<size_t> &offsets) const;
+
+    /**
+     * Returns the layout of a cache file for the current source files.
+     *
+     * @param header the start of the cache file to fill in
+     * @param numRows the number of rows
+     * @return false if the source files cannot be examined
+     */
+    bool getCacheHeader(CacheHeader &header, const int numRows) const;
+
+    /**
+     * Reads the columns of the data set from the cache file.
+     *
+     * @param mapped whether to leave the values in the mapped file instead
+     *          of copying them into memory
+     * @return the columns, null if there is no cache file or it is out of date
+     */
+    std::shared_ptr<ColumnStore> readColumns(const bool mapped) const;
+
+    /**
+     * Reads the data set from the cache file into memory.
+     *
+     * @return the data set, null if there is no cache file or it is out of date
+     */
+    Instances *readCache() const;
+
+    /**
+     * Writes the data set to the cache file. Failures are ignored; the data
+     * set is simply parsed again the next time.
+     *
+     * @param data the data set read from the data file
+     */
+    void writeCache(Instances &data) const;
+
+    /**
+     * Reads all instances of a mapped data file.
+     *
+     * @param file the data file
+     * @return the instances
+     * @exception IOException if parsing fails
      */
-    Instance *getInstance(const string &inData) const;
+    Instances *getInstances(const MappedFile &file) const;
+
+    /**
+     * Counts the rows of a mapped data file without parsing them, skipping
+     * the lines getInstances() skips.
+     *
+     * @param file the data file
+     * @return the number of rows
+     */
+    int countRows(const MappedFile &file) const;
+
+    /**
+     * Streams all instances of a mapped data file into the cache file and
+     * maps them from there. The lines are counted first, which only scans
+     * for line ends, so that the file is parsed once and each column is
+     * written to its place while only a few chunks are held in memory.
+     *
+     * @param file the data file
+     * @return the columns, mapped from the cache file
+     * @exception IOException if parsing fails or the cache cannot be written
+     */
+    std::shared_ptr<ColumnStore> spillColumns(const MappedFile &file) const;
+
+    /**
+     * Parses a mapped data file a few chunks per thread at a time and hands
+     * the rows of each chunk over in file order.
+     *
+     * @param file the data file
+     * @param addRows called with the values of the rows of a chunk, row
+     *          after row, their number, and the number of bytes of the file
+     *          they were parsed from
+     * @exception IOException if parsing fails
+     */
+    void parseChunks(const MappedFile &file, const std::function<void(const double*, const int, const size_t)> &addRows) const;
+
+    /**
+     * Parses the lines of a part of the data file.
+     *
+     * @param begin the start of the first line
+     * @param end the end of the last line
+     * @param nominal whether each attribute is nominal
+     * @param values the array the values of the rows are appended to, row after row
+     * @return the number of rows
+     * @exception IOException if a line cannot be parsed
+     */
+    int getInstances(const char *begin, const char *end, const bool_array &nominal, double_array &values) const;
+
+    /**
+     * Parses an instance from the given line.
+     *
+     * @param begin the start of the line
+     * @param end the end of the line, without the line break
+     * @param nominal whether each attribute is nominal
+     * @param values the array of numAttributes() values the instance is written to
+     * @param value space for a copy of a nominal value
+     * @exception IOException if the line cannot be parsed
+     */
+    void getInstance(const char *begin, const char *end, const bool_array &nominal, double *values, string &value) const;
+
+    /**
+     * Parses an instance from the given line of an ARFF file.
+     *
+     * @param begin the start of the line
+     * @param end the end of the line, without the line break
+     * @param nominal whether each attribute is nominal
+     * @param values the array of numAttributes() values the instance is written to
+     * @param value space for a copy of a nominal value
+     * @return false if the line holds no instance, e.g. a comment
+     * @exception IOException if the line cannot be parsed
+     */
+    bool getArffInstance(const char *begin, const char *end, const bool_array &nominal, double *values, string &value) const;
+
+    /**
+     * Parses a number the way std::stod does. Plain decimal numbers whose
+     * value is exactly representable before the final rounding are parsed
+     * directly; everything else is handed to std::stod.
+     *
+     * @param begin the start of the number
+     * @param end the end of the number
+     * @return the number
+     * @exception invalid_argument if there is no number
+     */
+    static double parseNumber(const char *begin, const char *end);
 
     /**
      * removes the trailing period
@@ -89,6 +300,13 @@ private:
      */
     void readHeader(std::fstream& inStream);
 
+    /**
+     * Reads the header of an ARFF file, up to and including its @data line.
+     *
+     * @exception IOException if an error occurs
+     */
+    void readArffHeader();
+
 public:
 
     /**
@@ -133,6 +351,42 @@ public:
      * @exception IOException if there is no source or parsing fails
      */
     Instances *getDataSet();
+
+    /**
+     * Returns the columns of the full data set out of core, mapped from the
+     * cache file, which is written first unless it is up to date; the cache
+     * is used here even if it is otherwise not. No instance is created, so
+     * the rows take no memory beyond the pages of the file in use. The
+     * header is the one getStructure() returns.
+     *
+     * @return the columns, read-only as long as they are to stay mapped
+     * @exception IOException if parsing fails or the cache cannot be written
+     */
+    std::shared_ptr<ColumnStore> getColumns();
+
+    /**
+     * Sets the number of threads to parse the data file with.
+     *
+     * @param numThreads the number of threads, values below 1 select the
+     *          number of hardware threads (the default)
+     */
+    void setNumThreads(const int numThreads);
+
+    /**
+     * Sets whether to read and write the cache file.
+     *
+     * @param useCache false to always parse the data file (default true)
+     */
+    void setUseCache(const bool useCache);
+
+    /**
+     * Sets whether the data set holds numeric values as floats instead of
+     * doubles, which halves their memory but rounds them to about seven
+     * significant digits. Training and test data should be read alike.
+     *
+     * @param singlePrecision true to hold numeric values as floats (default false)
+     */
+    void setSinglePrecision(const bool singlePrecision);
 };
 
 #endif    // _DATASOURCE_
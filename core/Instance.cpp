@@ -1,11 +1,12 @@
 #include "Instance.h"
 #include "Instances.h"
 #include "Utils.h"
+#include "ColumnStore.h"
 
 Instance::Instance(Instance *instance)
 {
-    mAttValues = instance->mAttValues;
-    mWeight = instance->mWeight;
+    mAttValues = instance->toDoubleArray();
+    mWeight = instance->weight();
     mDataset = instance->mDataset;
 }
 Instance::Instance(const double weight,const double_array &attValues)
@@ -28,6 +29,10 @@ Attribute &Instance::attribute(const int index) const
 
 int Instance::numAttributes() const
 {
+    if (mStore != nullptr)
+    {
+        return mStore->numAttributes();
+    }
     return (int)mAttValues.size();
 }
 int Instance::classIndex() const
@@ -37,6 +42,11 @@ int Instance::classIndex() const
 
 void Instance::setValue(const int attIndex, const double value)
 {
+    if (mStore != nullptr)
+    {
+        mStore->setValue(mRow, attIndex, value);
+        return;
+    }
     freshAttributeVector();
     mAttValues[attIndex] = value;
 }
@@ -47,6 +57,15 @@ void Instance::freshAttributeVector()
 }
 double_array Instance::toDoubleArray() const
 {
+    if (mStore != nullptr)
+    {
+        double_array newValues(mStore->numAttributes());
+        for (int i = 0; i < (int)newValues.size(); i++)
+        {
+            newValues[i] = mStore->value(mRow, i);
+        }
+        return newValues;
+    }
     double_array newValues(mAttValues.size());
     std::copy(std::begin(mAttValues), std::end(mAttValues), std::begin(newValues));
     return newValues;
@@ -93,6 +112,10 @@ void Instance::setValue(const int attIndex, const string &value)
 
 double Instance::value(const int attIndex) const
 {
+    if (mStore != nullptr)
+    {
+        return mStore->value(mRow, attIndex);
+    }
     return mAttValues[attIndex];
 }
 
@@ -108,11 +131,19 @@ double Instance::classValue() const
 
 double Instance::weight() const
 {
+    if (mStore != nullptr)
+    {
+        return mStore->weight(mRow);
+    }
     return mWeight;
 }
 
 bool Instance::isMissing(const int attIndex) const
 {
+    if (mStore != nullptr)
+    {
+        return mStore->isMissing(mRow, attIndex);
+    }
     if (Utils::isMissingValue(value(attIndex)))
     {
         return true;
@@ -132,6 +163,11 @@ int Instance::numClasses() const
 
 void Instance::setWeight(const double weight)
 {
+    if (mStore != nullptr)
+    {
+        mStore->setWeight(mRow, weight);
+        return;
+    }
     mWeight = weight;
 }
 
@@ -159,3 +195,27 @@ bool Instance::classIsMissing() const
     }
     return isMissing(classIndexValue);
 }
+
+ColumnStore *Instance::store() const
+{
+    return mStore.get();
+}
+
+int Instance::row() const
+{
+    return mRow;
+}
+
+void Instance::bindTo(const std::shared_ptr<ColumnStore> &store)
+{
+    mRow = store->add(mAttValues, mWeight);
+    mStore = store;
+    double_array().swap(mAttValues);
+}
+
+void Instance::referTo(const std::shared_ptr<ColumnStore> &store, const int row)
+{
+    mRow = row;
+    mStore = store;
+    mWeight = store->weight(row);
+}
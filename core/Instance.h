@@ -5,9 +5,11 @@
 #include <vector>
 #include <iostream>
 #include <stdexcept>
+#include <memory>
 #include "Attribute.h"
 
 class Instances;
+class ColumnStore;
 
 /**
  * Class for handling an instance. All values (numeric, date, nominal, string
@@ -17,6 +19,10 @@ class Instances;
  * attribute's definition. We have chosen this approach in favor of a more
  * elegant object-oriented approach because it is much faster.
  *
+ * Once an instance has been added to a set of instances its values and
+ * weight are held by the set's column store, and the instance just refers
+ * to its row there.
+ *
  */
 class Instance
 {
@@ -237,6 +243,21 @@ public:
    */
    Instance* copy();
 
+  /**
+   * Returns the column store holding the instance's values. Null if the
+   * instance holds its values itself.
+   *
+   * @return the column store
+   */
+   ColumnStore *store() const;
+
+  /**
+   * Returns the instance's row in its column store.
+   *
+   * @return the row, -1 if the instance holds its values itself
+   */
+   int row() const;
+
 protected:
 
 	/** The instance's attribute values. */
@@ -251,14 +272,38 @@ protected:
 	*/
     Instances *mDataset;
 
+	/** The column store holding the values, null if they are held in mAttValues. */
+    std::shared_ptr<ColumnStore> mStore;
+
+	/** The instance's row in the column store. */
+    int mRow = -1;
+
 private:
 
+  /**
+   * Moves the values and the weight of the instance into a new row of the
+   * given column store. Afterwards the instance refers to that row.
+   *
+   * @param store the column store
+   */
+   void bindTo(const std::shared_ptr<ColumnStore> &store);
+
+  /**
+   * Makes the instance refer to an existing row of a column store, whose
+   * values and weight it takes from then on.
+   *
+   * @param store the column store
+   * @param row the row
+   */
+   void referTo(const std::shared_ptr<ColumnStore> &store, const int row);
+
   /**
    * Clones the attribute vector of the instance and
    * overwrites it with the clone.
    */
    void freshAttributeVector();
 
+   friend class Instances;
 };
 
 #endif    // _INSTANCE_
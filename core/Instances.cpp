@@ -1,5 +1,8 @@
 #include "Instances.h"
 #include "Instance.h"
+#include "ColumnStore.h"
+#include "BinaryWriter.h"
+#include "BinaryReader.h"
 #include "Consts.h"
 #include "Utils.h"
 
@@ -29,6 +32,7 @@ Instances::Instances(const string &name, std::vector<Attribute*> &attInfo, const
 
     mRelationName = name;
     mClassIndex = -1;
+    mSinglePrecision = false;
     mAttributes = attInfo;
     mNamesToAttributeIndices = std::unordered_map<string, int>(static_cast<int>(numAttributes() / 0.75));
     for (int i = 0; i < numAttributes(); i++)
@@ -36,12 +40,15 @@ Instances::Instances(const string &name, std::vector<Attribute*> &attInfo, const
         attribute(i).setIndex(i);
         mNamesToAttributeIndices[(attribute(i)).name()] = i;
     }
-    mInstances = std::vector<Instance*>(capacity);
+    if (capacity > 0)
+    {
+        mInstances.reserve(capacity);
+    }
 }
 
 Instances::Instances(Instances *dataset) :Instances(dataset, 0)
 {
-    this->copyInstances(0, *dataset, dataset->numInstances());
+    dataset->copyInstances(0, *this, dataset->numInstances());
 }
 
 Instances::Instances(Instances *dataset, const int capacity)
@@ -49,6 +56,12 @@ Instances::Instances(Instances *dataset, const int capacity)
     initialize(*dataset, capacity);
 }
 
+Instances::Instances(Instances *dataset, const std::vector<Instance*> &instances)
+{
+    initialize(*dataset, 0);
+    mInstances = instances;
+}
+
 Attribute &Instances::attribute(const int index) const
 {
     return *mAttributes[index];
@@ -83,16 +96,122 @@ void Instances::setClassIndex(const int classIndex)
         throw  string("Invalid class index: ") + std::to_string(classIndex);
     }
     mClassIndex = classIndex;
+    if (mStore != nullptr)
+    {
+        mStore->setClassIndex(storeClassIndex());
+    }
 }
 
 bool Instances::add(Instance &instance)
 {
     Instance *newInstance = static_cast<Instance*>(&instance);
+    if (newInstance->store() == nullptr && newInstance->numAttributes() == numAttributes())
+    {
+        store();
+        newInstance->bindTo(mStore);
+    }
     newInstance->setDataset(const_cast<Instances*>(this));
     mInstances.push_back(&instance);
     return true;
 }
 
+void Instances::addRows(const double *values, const int count, const double weight)
+{
+    int first = store().addRows(values, count, weight);
+    addStoredRows(first, count);
+}
+
+void Instances::addRows(const std::shared_ptr<ColumnStore> &store)
+{
+    if (mStore != nullptr)
+    {
+        throw "The set already has a column store";
+    }
+    mStore = store;
+    mStore->setClassIndex(storeClassIndex());
+    mInstances.reserve(mInstances.size() + mStore->numRows());
+    addStoredRows(0, mStore->numRows());
+}
+
+ColumnStore &Instances::store()
+{
+    if (mStore == nullptr)
+    {
+        mStore = std::make_shared<ColumnStore>(columnTypes(), storeClassIndex());
+        mStore->reserve((int)mInstances.capacity());
+    }
+    return *mStore;
+}
+
+std::vector<ColumnStore::ColumnType> Instances::columnTypes() const
+{
+    std::vector<ColumnStore::ColumnType> types(numAttributes());
+    for (int i = 0; i < numAttributes(); i++)
+    {
+        int numValues = attribute(i).isNominal() ? attribute(i).numValues() : -1;
+        // Dates are kept in doubles, as floats would round them to minutes.
+        types[i] = ColumnStore::typeFor(numValues, mSinglePrecision && attribute(i).type() == ATTRIBUTE::NUMERIC);
+    }
+    return types;
+}
+
+void Instances::setSinglePrecision(const bool singlePrecision)
+{
+    mSinglePrecision = singlePrecision;
+    if (mStore != nullptr)
+    {
+        std::vector<ColumnStore::ColumnType> types = columnTypes();
+        for (int i = 0; i < numAttributes(); i++)
+        {
+            if (attribute(i).type() == ATTRIBUTE::NUMERIC)
+            {
+                mStore->setColumnType(i, types[i]);
+            }
+        }
+    }
+}
+
+bool Instances::singlePrecision() const
+{
+    return mSinglePrecision;
+}
+
+const ColumnStore *Instances::columnStore() const
+{
+    if (mStore == nullptr || mStore->numRows() < numInstances())
+    {
+        return nullptr;
+    }
+    for (int i = 0; i < numInstances(); i++)
+    {
+        if (mInstances[i]->store() != mStore.get() || mInstances[i]->row() != i)
+        {
+            return nullptr;
+        }
+    }
+    return mStore.get();
+}
+
+void Instances::addStoredRows(const int first, const int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        Instance *newInstance = new Instance(0, double_array());
+        newInstance->referTo(mStore, first + i);
+        newInstance->setDataset(this);
+        mInstances.push_back(newInstance);
+    }
+}
+
+void Instances::reserve(const int capacity)
+{
+    mInstances.reserve(capacity);
+    if (mStore != nullptr)
+    {
+        mStore->reserve(capacity);
+    }
+}
+
 void Instances::add(const int index, Instance &instance)
 {
     Instance *newInstance = static_cast<Instance*>(&instance);
@@ -105,13 +224,13 @@ int Instances::numInstances() const
     return (int)mInstances.size();
 }
 
-void Instances::copyInstances(const int from, const Instances &dest, const int num)
+void Instances::copyInstances(const int from, Instances &dest, const int num) const
 {
     for (int i = 0; i < num; i++)
     {
-        Instance *newInstance = new Instance(dest.instance(i).weight(), dest.instance(i).toDoubleArray());
-        newInstance->setDataset(const_cast<Instances*>(this));
-        mInstances.push_back(newInstance);
+        Instance &source = instance(from + i);
+        Instance *newInstance = new Instance(source.weight(), source.toDoubleArray());
+        dest.add(*newInstance);
     }
 }
 
@@ -131,9 +250,19 @@ void Instances::initialize(const Instances &dataset, int capacity)
     // they can't be modified.
     mClassIndex = dataset.mClassIndex;
     mRelationName = dataset.mRelationName;
+    mSinglePrecision = dataset.mSinglePrecision;
     mAttributes = dataset.mAttributes;
     mNamesToAttributeIndices = dataset.mNamesToAttributeIndices;
-    mInstances = std::vector<Instance*>(capacity);
+    mInstances.reserve(capacity);
+}
+
+int Instances::storeClassIndex() const
+{
+    if (mClassIndex >= 0 && attribute(mClassIndex).isNominal())
+    {
+        return mClassIndex;
+    }
+    return -1;
 }
 
 Attribute &Instances::classAttribute() const
@@ -229,8 +358,8 @@ Instances *Instances::trainCV(const int numFolds, const int numFold)
     }
     train = new Instances(this, numInstances() - numInstForFold);
     first = numFold * (numInstances() / numFolds) + offset;
-    copyInstances(0, train, first);
-    copyInstances(first + numInstForFold, train, numInstances() - first - numInstForFold);
+    copyInstances(0, *train, first);
+    copyInstances(first + numInstForFold, *train, numInstances() - first - numInstForFold);
 
     return train;
 }
@@ -260,7 +389,7 @@ Instances *Instances::testCV(const int numFolds, const int numFold)
     }
     test = new Instances(this, numInstForFold);
     first = numFold * (numInstances() / numFolds) + offset;
-    copyInstances(first, test, numInstForFold);
+    copyInstances(first, *test, numInstForFold);
     return test;
 }
 
@@ -271,7 +400,7 @@ void Instances::Sort(const int attIndex)
         // Use quicksort from Utils class for sorting
         double_array vals(numInstances());
         std::vector<Instance*> backup(vals.size());
-        for (int i = 0; i < vals.size(); i++)
+        for (int i = 0; i < (int)vals.size(); i++)
         {
             Instance &inst = instance(i);
             backup[i] = &inst;
@@ -287,7 +416,7 @@ void Instances::Sort(const int attIndex)
         }
 
         int_array sortOrder = Utils::sortWithNoMissingValues(vals);
-        for (int i = 0; i < vals.size(); i++)
+        for (int i = 0; i < (int)vals.size(); i++)
         {
             mInstances[i] = backup[sortOrder[i]];
         }
@@ -322,7 +451,7 @@ void Instances::sortBasedOnNominalAttribute(const int attIndex)
     // Indices to figure out where to add instances
     int_array indices(counts.size());
     int start = 0;
-    for (int i = 0; i < counts.size(); i++)
+    for (int i = 0; i < (int)counts.size(); i++)
     {
         indices[i] = start;
         start += counts[i];
@@ -341,6 +470,35 @@ void Instances::sortBasedOnNominalAttribute(const int attIndex)
     }
 }
 
+void Instances::stratify(const int numFolds)
+{
+    if (numFolds <= 1)
+    {
+        throw std::invalid_argument("Number of folds must be greater than 1");
+    }
+    if (mClassIndex < 0)
+    {
+        throw "Class index is negative (not set)!";
+    }
+    if (classAttribute().isNominal())
+    {
+        // group the instances by class, keeping their order within a class
+        sortBasedOnNominalAttribute(mClassIndex);
+
+        // deal them out so that every fold gets its share of each class
+        std::vector<Instance*> newInstances;
+        newInstances.reserve(mInstances.size());
+        for (int start = 0; start < numFolds; start++)
+        {
+            for (int j = start; j < numInstances(); j += numFolds)
+            {
+                newInstances.push_back(mInstances[j]);
+            }
+        }
+        mInstances = newInstances;
+    }
+}
+
 string Instances::getRelationName() const
 {
     return mRelationName;
@@ -360,3 +518,66 @@ double_array Instances::attributeToDoubleArray(const int index) const
     }
     return result;
 }
+
+void Instances::serializeHeader(BinaryWriter &writer) const
+{
+    writer.writeString(mRelationName);
+    writer.writeInt(numAttributes());
+    for (int i = 0; i < numAttributes(); i++)
+    {
+        Attribute &att = attribute(i);
+        if (!att.isNominal() && !att.isNumeric())
+        {
+            throw string("Cannot write attribute of this type: ") + att.name();
+        }
+        writer.writeString(att.name());
+        writer.writeBool(att.isNominal());
+        if (att.isNominal())
+        {
+            writer.writeInt(att.numValues());
+            for (int j = 0; j < att.numValues(); j++)
+            {
+                writer.writeString(att.value(j));
+            }
+        }
+    }
+    writer.writeInt(mClassIndex);
+}
+
+Instances *Instances::deserializeHeader(BinaryReader &reader)
+{
+    string name = reader.readString();
+    int numAtts = reader.readInt();
+    if (numAtts < 0)
+    {
+        throw string("Invalid number of attributes: ") + std::to_string(numAtts);
+    }
+
+    std::vector<Attribute*> attInfo;
+    for (int i = 0; i < numAtts; i++)
+    {
+        string attName = reader.readString();
+        if (reader.readBool())
+        {
+            int numValues = reader.readInt();
+            if (numValues < 0)
+            {
+                throw string("Invalid number of values for attribute ") + attName;
+            }
+            string_array values;
+            for (int j = 0; j < numValues; j++)
+            {
+                values.push_back(reader.readString());
+            }
+            attInfo.push_back(new Attribute(attName, values));
+        }
+        else
+        {
+            attInfo.push_back(new Attribute(attName));
+        }
+    }
+
+    Instances *result = new Instances(name, attInfo, 0);
+    result->setClassIndex(reader.readInt());
+    return result;
+}
@@ -9,10 +9,15 @@
 #include <random>
 #include <iostream>
 #include <fstream>
+#include <memory>
 
 #include "Attribute.h"
 #include "AttributeStats.h"
 #include "Instance.h"
+#include "ColumnStore.h"
+
+class BinaryWriter;
+class BinaryReader;
 
 /**
  * Class for handling an ordered set of weighted instances.
@@ -38,6 +43,15 @@ protected:
     /** The class attribute's index */
     int mClassIndex;
 
+    /**
+     * The column store holding the values of the instances added to this set.
+     * Created on the first add and shared with the instances stored in it.
+     */
+    std::shared_ptr<ColumnStore> mStore;
+
+    /** Whether the column store holds numeric values as floats. */
+    bool mSinglePrecision;
+
     /**
      * initializes with the header information of the given dataset and sets the
      * capacity of the set of instances.
@@ -47,6 +61,28 @@ protected:
      */
     void initialize(const Instances &dataset, int capacity);
 
+    /**
+     * Returns the attribute to be held in the class column of the column store.
+     *
+     * @return the class index if the class attribute is nominal, -1 otherwise
+     */
+    int storeClassIndex() const;
+
+    /**
+     * Returns the column store of the set, creating it if necessary.
+     *
+     * @return the column store
+     */
+    ColumnStore &store();
+
+    /**
+     * Adds an instance for each of the given rows of the column store.
+     *
+     * @param first the first row
+     * @param count the number of rows
+     */
+    void addStoredRows(const int first, const int count);
+
 public:
     /**
      * Creates an empty set of instances. Uses the given attribute information.
@@ -79,6 +115,18 @@ public:
      */
     Instances(Instances *dataset, const int capacity);
 
+    /**
+     * Constructor creating a set of the given instances, in the given order.
+     * Copies references to the header information from the given set of
+     * instances. The instances are shared, not copied, and keep their
+     * reference to the dataset they belong to.
+     *
+     * @param dataset the instances from which the header information is to be
+     *          taken
+     * @param instances the instances of the new dataset
+     */
+    Instances(Instances *dataset, const std::vector<Instance*> &instances);
+
     /**
      * Returns an attribute.
      *
@@ -131,6 +179,70 @@ public:
      */
     bool add(Instance &instance);
 
+    /**
+     * Adds rows of values of equal weight to the end of the set. The values
+     * are appended to the set's column store directly, and the new instances
+     * refer to their rows there.
+     *
+     * @param values the values of the rows in internal format, row after row
+     * @param count the number of rows
+     * @param weight the weight of every row
+     */
+    void addRows(const double *values, const int count, const double weight);
+
+    /**
+     * Adds an instance for every row of a column store to an empty set. The
+     * set takes the store as its own instead of copying it, so e.g. a store
+     * mapped from a file stays mapped.
+     *
+     * @param store the column store
+     * @throws Exception if the set already holds stored instances
+     */
+    void addRows(const std::shared_ptr<ColumnStore> &store);
+
+    /**
+     * Returns the types of the columns a column store holds the values of
+     * this set in: codes for nominal attributes and doubles or floats for
+     * numeric ones.
+     *
+     * @return the column type of each attribute
+     */
+    std::vector<ColumnStore::ColumnType> columnTypes() const;
+
+    /**
+     * Sets whether numeric values are held as floats, which halves their
+     * memory at the cost of precision. Values already held in the set's
+     * column store are converted. Sets created from this one's header
+     * inherit the choice.
+     *
+     * @param singlePrecision true to hold numeric values as floats
+     */
+    void setSinglePrecision(const bool singlePrecision);
+
+    /**
+     * Returns whether numeric values are held as floats.
+     *
+     * @return true if numeric values are held as floats
+     */
+    bool singlePrecision() const;
+
+    /**
+     * Returns the column store of the set if it holds every instance at the
+     * row of the instance's index, so that the columns can be scanned by
+     * index instead of instance by instance.
+     *
+     * @return the column store, null if the instances are held elsewhere or
+     *         in another order
+     */
+    const ColumnStore *columnStore() const;
+
+    /**
+     * Reserves space for instances that are about to be added.
+     *
+     * @param capacity the total number of instances to reserve space for
+     */
+    void reserve(const int capacity);
+
     /**
      * Adds one instance to the given index.
      *
@@ -158,7 +270,8 @@ public:
     int numInstances() const;
 
     /**
-     * Copies instances from one set to the end of another one.
+     * Copies instances from this set to the end of another one. The
+     * destination gets new instances with the same values and weights.
      *
      * @param from the position of the first instance to be copied
      * @param dest the destination for the instances
@@ -167,7 +280,7 @@ public:
      * @ requires 0 <= from && from <= numInstances() - num;
      * @ requires 0 <= num;
      */
-    void copyInstances(const int from, const Instances &dest, const int num);
+    void copyInstances(const int from, Instances &dest, const int num) const;
 
     /**
      * Returns the instance at the given position.
@@ -247,6 +360,16 @@ public:
      */
     void sortBasedOnNominalAttribute(const int attIndex);
 
+    /**
+     * Stratifies a set of instances according to its class values if the
+     * class attribute is nominal (so that afterwards a stratified
+     * cross-validation can be performed).
+     *
+     * @param numFolds the number of folds in the cross-validation
+     * @throws UnassignedClassException if the class is not set
+     */
+    void stratify(const int numFolds);
+
     /**
      * Removes all instances with a missing class value from the dataset.
      *
@@ -331,6 +454,25 @@ public:
      */
     double_array attributeToDoubleArray(const int index) const;
 
+    /**
+     * Writes the header information: the relation's name, the attributes
+     * with their nominal values, and the class index. No instances are
+     * written.
+     *
+     * @param writer the writer
+     * @throws Exception if an attribute is neither nominal nor numeric
+     */
+    void serializeHeader(BinaryWriter &writer) const;
+
+    /**
+     * Reads header information written by serializeHeader().
+     *
+     * @param reader the reader
+     * @return an empty set of instances with the header information
+     * @throws Exception if the data is invalid
+     */
+    static Instances *deserializeHeader(BinaryReader &reader);
+
 };
 
 #endif // _INSTANCES_HPP
@@ -0,0 +1,224 @@
+#include "InstancesView.h"
+#include "Instances.h"
+#include "Instance.h"
+#include "Utils.h"
+#include "ColumnStore.h"
+
+#include <algorithm>
+#include <limits>
+
+InstancesView::InstancesView(Instances &base) :
+    InstancesView(base, base.numInstances())
+{
+    int totalInst = base.numInstances();
+    for (int i = 0; i < totalInst; i++)
+    {
+        add(i, base.instance(i).weight());
+    }
+}
+
+InstancesView::InstancesView(Instances &base, const int capacity) :
+    mBase(&base),
+    mStore(base.columnStore())
+{
+    if (capacity > 0)
+    {
+        mIndices.reserve(capacity);
+        mWeights.reserve(capacity);
+    }
+}
+
+InstancesView::InstancesView(const InstancesView &parent, const int capacity) :
+    mBase(parent.mBase),
+    mStore(parent.mStore)
+{
+    if (capacity > 0)
+    {
+        mIndices.reserve(capacity);
+        mWeights.reserve(capacity);
+    }
+}
+
+void InstancesView::add(const int index, const double weight)
+{
+    mIndices.push_back(index);
+    mWeights.push_back(weight);
+}
+
+void InstancesView::addKnown(const int attIndex)
+{
+    int totalInst = mBase->numInstances();
+    if (mStore == nullptr)
+    {
+        for (int i = 0; i < totalInst; i++)
+        {
+            if (!mBase->instance(i).isMissing(attIndex))
+            {
+                add(i, mBase->instance(i).weight());
+            }
+        }
+        return;
+    }
+
+    const std::uint64_t *missing = mStore->missingBits(attIndex);
+    const double *weights = mStore->weightColumn();
+    for (int first = 0; first < totalInst; first += 64)
+    {
+        int count = std::min(64, totalInst - first);
+        std::uint64_t bits = missing[first / 64];
+        if (bits == 0)
+        {
+            for (int i = first; i < first + count; i++)
+            {
+                add(i, weights[i]);
+            }
+        }
+        else if (bits != ~(std::uint64_t)0)
+        {
+            for (int k = 0; k < count; k++)
+            {
+                if (((bits >> k) & 1) == 0)
+                {
+                    add(first + k, weights[first + k]);
+                }
+            }
+        }
+    }
+}
+
+Instances &InstancesView::dataset() const
+{
+    return *mBase;
+}
+
+const ColumnStore *InstancesView::store() const
+{
+    return mStore;
+}
+
+int InstancesView::numInstances() const
+{
+    return (int)mIndices.size();
+}
+
+int InstancesView::numAttributes() const
+{
+    return mBase->numAttributes();
+}
+
+int InstancesView::classIndex() const
+{
+    return mBase->classIndex();
+}
+
+int InstancesView::numClasses() const
+{
+    return mBase->numClasses();
+}
+
+Attribute &InstancesView::attribute(const int index) const
+{
+    return mBase->attribute(index);
+}
+
+Attribute &InstancesView::classAttribute() const
+{
+    return mBase->classAttribute();
+}
+
+Instance &InstancesView::instance(const int row) const
+{
+    return mBase->instance(mIndices[row]);
+}
+
+int InstancesView::index(const int row) const
+{
+    return mIndices[row];
+}
+
+int InstancesView::find(const int index) const
+{
+    auto it = std::lower_bound(mIndices.begin(), mIndices.end(), index);
+    if (it == mIndices.end() || *it != index)
+    {
+        return -1;
+    }
+    return static_cast<int>(it - mIndices.begin());
+}
+
+double InstancesView::weight(const int row) const
+{
+    return mWeights[row];
+}
+
+double InstancesView::value(const int row, const int attIndex) const
+{
+    if (mStore != nullptr)
+    {
+        return mStore->value(mIndices[row], attIndex);
+    }
+    return mBase->instance(mIndices[row]).value(attIndex);
+}
+
+bool InstancesView::isMissing(const int row, const int attIndex) const
+{
+    if (mStore != nullptr)
+    {
+        return mStore->isMissing(mIndices[row], attIndex);
+    }
+    return Utils::isMissingValue(value(row, attIndex));
+}
+
+bool InstancesView::hasMissingValues(const int attIndex) const
+{
+    return mStore == nullptr || mStore->numMissing(attIndex) > 0;
+}
+
+double InstancesView::classValue(const int row) const
+{
+    if (mStore != nullptr)
+    {
+        return mStore->value(mIndices[row], mBase->classIndex());
+    }
+    return mBase->instance(mIndices[row]).classValue();
+}
+
+double InstancesView::sumOfWeights() const
+{
+    double sum = 0;
+
+    for (int i = 0; i < numInstances(); i++)
+    {
+        sum += mWeights[i];
+    }
+    return sum;
+}
+
+int_array InstancesView::sortedOrder(const int attIndex) const
+{
+    // Same keys as Instances::Sort, so that the quicksort yields the same order.
+    double_array vals(numInstances());
+    for (int i = 0; i < (int)vals.size(); i++)
+    {
+        double val = value(i, attIndex);
+        if (Utils::isMissingValue(val))
+        {
+            vals[i] = std::numeric_limits<double>::max();
+        }
+        else
+        {
+            vals[i] = val;
+        }
+    }
+    return Utils::sortWithNoMissingValues(vals);
+}
+
+Instances *InstancesView::toInstances() const
+{
+    Instances *result = new Instances(mBase, numInstances());
+    for (int i = 0; i < numInstances(); i++)
+    {
+        result->add(*new Instance(mWeights[i], instance(i).toDoubleArray()));
+    }
+    return result;
+}
@@ -0,0 +1,241 @@
+#ifndef _INSTANCESVIEW_
+#define _INSTANCESVIEW_
+
+#include <string>
+#include "Typedefs.h"
+
+// Forward class declarations:
+class Instances;
+class Instance;
+class Attribute;
+class ColumnStore;
+
+/**
+ * Class for a weighted subset of a set of instances that does not copy the
+ * instances. A view refers to its base dataset and lists the indices of the
+ * instances it contains, together with a weight per row. The weight of a row
+ * may differ from the weight of the base instance, e.g. when an instance with
+ * a missing value has been split fractionally into several subsets. The base
+ * instances themselves are never modified.
+ *
+ * If the base dataset is held in a column store at the rows of its indices,
+ * the view reads the values and missing-value bitmaps from the store
+ * directly instead of going through the instances.
+ *
+ * The base dataset must outlive the view and must not be changed while the
+ * view is in use.
+ */
+class InstancesView
+{
+
+protected:
+
+    /** The dataset the view refers to. */
+    Instances *mBase;
+
+    /** The indices of the rows in the base dataset. */
+    int_array mIndices;
+
+    /** The weight of each row. */
+    double_array mWeights;
+
+    /** The column store holding the base dataset by index, null if there is none. */
+    const ColumnStore *mStore;
+
+public:
+
+    /**
+     * Creates a view containing all instances of the given dataset with
+     * their own weights.
+     *
+     * @param base the dataset to refer to
+     */
+    InstancesView(Instances &base);
+
+    /**
+     * Creates an empty view on the given dataset.
+     *
+     * @param base the dataset to refer to
+     * @param capacity the number of rows to reserve
+     */
+    InstancesView(Instances &base, const int capacity);
+
+    /**
+     * Creates an empty view on the dataset of another view.
+     *
+     * @param parent the view whose dataset to refer to
+     * @param capacity the number of rows to reserve
+     */
+    InstancesView(const InstancesView &parent, const int capacity);
+
+    /**
+     * Adds a row to the view.
+     *
+     * @param index the index of the instance in the base dataset
+     * @param weight the weight of the row
+     */
+    void add(const int index, const double weight);
+
+    /**
+     * Adds every instance of the base dataset whose value of the given
+     * attribute is known, with its own weight. With a column store the
+     * missing-value bitmap is scanned a word of 64 rows at a time.
+     *
+     * @param attIndex the attribute's index
+     */
+    void addKnown(const int attIndex);
+
+    /**
+     * Returns the dataset the view refers to.
+     *
+     * @return the base dataset
+     */
+    Instances &dataset() const;
+
+    /**
+     * Returns the column store holding the base dataset at the rows of its
+     * indices.
+     *
+     * @return the column store, null if the base dataset is not held so
+     */
+    const ColumnStore *store() const;
+
+    /**
+     * Returns the number of rows in the view.
+     *
+     * @return the number of rows
+     */
+    int numInstances() const;
+
+    /**
+     * Returns the number of attributes.
+     *
+     * @return the number of attributes
+     */
+    int numAttributes() const;
+
+    /**
+     * Returns the class attribute's index.
+     *
+     * @return the class index
+     */
+    int classIndex() const;
+
+    /**
+     * Returns the number of class labels.
+     *
+     * @return the number of class labels
+     */
+    int numClasses() const;
+
+    /**
+     * Returns an attribute.
+     *
+     * @param index the attribute's index
+     * @return the attribute at the given position
+     */
+    Attribute &attribute(const int index) const;
+
+    /**
+     * Returns the class attribute.
+     *
+     * @return the class attribute
+     */
+    Attribute &classAttribute() const;
+
+    /**
+     * Returns the base instance of a row. Note that its weight is the weight
+     * in the base dataset; use weight() for the weight of the row.
+     *
+     * @param row the row
+     * @return the instance at the given row
+     */
+    Instance &instance(const int row) const;
+
+    /**
+     * Returns the index of a row in the base dataset.
+     *
+     * @param row the row
+     * @return the index in the base dataset
+     */
+    int index(const int row) const;
+
+    /**
+     * Finds the row of an instance of the base dataset. The rows must be in
+     * ascending order of their indices, as the views made by splitting a
+     * view in that order are.
+     *
+     * @param index the index of the instance in the base dataset
+     * @return the row, -1 if the instance is not in the view
+     */
+    int find(const int index) const;
+
+    /**
+     * Returns the weight of a row.
+     *
+     * @param row the row
+     * @return the weight
+     */
+    double weight(const int row) const;
+
+    /**
+     * Returns a value of a row in internal format.
+     *
+     * @param row the row
+     * @param attIndex the attribute's index
+     * @return the value
+     */
+    double value(const int row, const int attIndex) const;
+
+    /**
+     * Tests if a value of a row is missing.
+     *
+     * @param row the row
+     * @param attIndex the attribute's index
+     * @return true if the value is missing
+     */
+    bool isMissing(const int row, const int attIndex) const;
+
+    /**
+     * Tests if any row may miss the value of an attribute. Rows are only
+     * known to be complete if the column store holds no missing value of
+     * the attribute at all.
+     *
+     * @param attIndex the attribute's index
+     * @return false if no row misses the value
+     */
+    bool hasMissingValues(const int attIndex) const;
+
+    /**
+     * Returns the class value of a row in internal format.
+     *
+     * @return the class value
+     */
+    double classValue(const int row) const;
+
+    /**
+     * Computes the sum of the weights of all rows.
+     *
+     * @return the sum of the weights
+     */
+    double sumOfWeights() const;
+
+    /**
+     * Returns the rows sorted by the values of an attribute, missing values
+     * last. The order is the one Instances::Sort produces for the same rows.
+     *
+     * @param attIndex the attribute's index
+     * @return the sorted rows
+     */
+    int_array sortedOrder(const int attIndex) const;
+
+    /**
+     * Copies the rows into a new set of instances, giving each copy the
+     * weight of its row.
+     *
+     * @return the new set of instances
+     */
+    Instances *toInstances() const;
+};
+
+#endif    // _INSTANCESVIEW_
@@ -0,0 +1,106 @@
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const string &path) :
+    mData(nullptr),
+    mSize(0),
+    mMapping(nullptr)
+{
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        throw string("Cannot open file: ") + path;
+    }
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(file, &size))
+    {
+        CloseHandle(file);
+        throw string("Cannot read the size of file: ") + path;
+    }
+    mSize = (size_t)size.QuadPart;
+    if (mSize > 0)
+    {
+        mMapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mMapping != nullptr)
+        {
+            mData = static_cast<const char*>(MapViewOfFile(mMapping, FILE_MAP_READ, 0, 0, 0));
+        }
+        if (mData == nullptr)
+        {
+            if (mMapping != nullptr)
+                CloseHandle(mMapping);
+            CloseHandle(file);
+            throw string("Cannot map file: ") + path;
+        }
+    }
+    // The mapping keeps the file open.
+    CloseHandle(file);
+}
+
+MappedFile::~MappedFile()
+{
+    if (mData != nullptr)
+        UnmapViewOfFile(mData);
+    if (mMapping != nullptr)
+        CloseHandle(mMapping);
+}
+
+#else
+
+MappedFile::MappedFile(const string &path) :
+    mData(nullptr),
+    mSize(0)
+{
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        throw string("Cannot open file: ") + path;
+    }
+    struct stat status;
+    if (fstat(file, &status) != 0)
+    {
+        close(file);
+        throw string("Cannot read the size of file: ") + path;
+    }
+    mSize = (size_t)status.st_size;
+    if (mSize > 0)
+    {
+        void *data = mmap(nullptr, mSize, PROT_READ, MAP_SHARED, file, 0);
+        if (data == MAP_FAILED)
+        {
+            close(file);
+            throw string("Cannot map file: ") + path;
+        }
+        mData = static_cast<const char*>(data);
+    }
+    // The mapping keeps the file open.
+    close(file);
+}
+
+MappedFile::~MappedFile()
+{
+    if (mData != nullptr)
+        munmap(const_cast<char*>(mData), mSize);
+}
+
+#endif
+
+const char *MappedFile::data() const
+{
+    return mData;
+}
+
+size_t MappedFile::size() const
+{
+    return mSize;
+}
@@ -0,0 +1,65 @@
+#ifndef _MAPPEDFILE_
+#define _MAPPEDFILE_
+
+#include <string>
+#include "Typedefs.h"
+
+/**
+ * Class for a file mapped read-only into memory. The pages are loaded on
+ * first access and shared by all processes mapping the same file, so large
+ * read-only data can be used in place instead of being read and copied.
+ *
+ * The file must not be modified while it is mapped.
+ */
+class MappedFile
+{
+
+protected:
+
+    /** The start of the mapping. */
+    const char *mData;
+
+    /** The size of the file. */
+    size_t mSize;
+
+#ifdef _WIN32
+    /** The handle of the file mapping object. */
+    void *mMapping;
+#endif
+
+public:
+
+    /**
+     * Maps a file.
+     *
+     * @param path the path of the file
+     * @throws Exception if the file cannot be opened or mapped
+     */
+    MappedFile(const string &path);
+
+    /**
+     * Unmaps the file.
+     */
+    ~MappedFile();
+
+    /**
+     * Returns the contents of the file.
+     *
+     * @return the start of the mapping
+     */
+    const char *data() const;
+
+    /**
+     * Returns the size of the file.
+     *
+     * @return the number of bytes
+     */
+    size_t size() const;
+
+private:
+
+    MappedFile(const MappedFile&);
+    MappedFile &operator=(const MappedFile&);
+};
+
+#endif    // _MAPPEDFILE_
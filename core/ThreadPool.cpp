@@ -0,0 +1,240 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+namespace
+{
+    /** The pool the calling thread is a worker of, if any. */
+    thread_local const ThreadPool *tPool = nullptr;
+
+    /** The deque of the calling thread in tPool. */
+    thread_local int tQueueIndex = -1;
+}
+
+ThreadPool::TaskGroup::TaskGroup() :
+    mPending(0)
+{
+}
+
+ThreadPool::ThreadPool(int numThreads) :
+    mQueued(0),
+    mStop(false)
+{
+    if (numThreads < 1)
+    {
+        numThreads = hardwareThreads();
+    }
+    for (int i = 0; i < numThreads; i++)
+    {
+        mQueues.push_back(std::unique_ptr<Queue>(new Queue()));
+    }
+    for (int i = 0; i < numThreads - 1; i++)
+    {
+        mWorkers.push_back(std::thread(&ThreadPool::workerLoop, this, i));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mWake.notify_all();
+    for (auto &worker : mWorkers)
+    {
+        worker.join();
+    }
+}
+
+int ThreadPool::numThreads() const
+{
+    return (int)mWorkers.size() + 1;
+}
+
+int ThreadPool::hardwareThreads()
+{
+    return std::max(1, (int)std::thread::hardware_concurrency());
+}
+
+int ThreadPool::queueIndex() const
+{
+    if (tPool == this)
+    {
+        return tQueueIndex;
+    }
+    return (int)mQueues.size() - 1;
+}
+
+ThreadPool::Task *ThreadPool::findTask(const int index)
+{
+    if (mQueued == 0)
+    {
+        return nullptr;
+    }
+    {
+        Queue &own = *mQueues[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            Task *task = own.tasks.back();
+            own.tasks.pop_back();
+            mQueued--;
+            return task;
+        }
+    }
+    int numQueues = (int)mQueues.size();
+    for (int i = 1; i < numQueues; i++)
+    {
+        Queue &victim = *mQueues[(index + i) % numQueues];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            Task *task = victim.tasks.front();
+            victim.tasks.pop_front();
+            mQueued--;
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+void ThreadPool::run(Task *task)
+{
+    TaskGroup &group = *task->group;
+    try
+    {
+        task->function();
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (!group.mError)
+        {
+            group.mError = std::current_exception();
+        }
+    }
+    delete task;
+    if (--group.mPending == 0)
+    {
+        // take the lock so a thread about to sleep in wait() cannot miss it
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+        }
+        mWake.notify_all();
+    }
+}
+
+void ThreadPool::workerLoop(const int index)
+{
+    tPool = this;
+    tQueueIndex = index;
+    while (true)
+    {
+        Task *task = findTask(index);
+        if (task != nullptr)
+        {
+            run(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWake.wait(lock, [this] { return mStop || mQueued > 0; });
+        if (mStop)
+        {
+            return;
+        }
+    }
+}
+
+void ThreadPool::spawn(TaskGroup &group, const std::function<void()> &task)
+{
+    group.mPending++;
+    Queue &own = *mQueues[queueIndex()];
+    {
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.tasks.push_back(new Task{ task, &group });
+        mQueued++;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+    }
+    mWake.notify_one();
+}
+
+void ThreadPool::wait(TaskGroup &group)
+{
+    int index = queueIndex();
+    while (group.mPending > 0)
+    {
+        Task *task = findTask(index);
+        if (task != nullptr)
+        {
+            run(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mMutex);
+        mWake.wait(lock, [this, &group] { return group.mPending == 0 || mQueued > 0; });
+    }
+    if (group.mError)
+    {
+        std::exception_ptr error = group.mError;
+        group.mError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+void ThreadPool::parallelFor(const int size, const std::function<void(int)> &body)
+{
+    if (mWorkers.empty() || size <= 1)
+    {
+        for (int i = 0; i < size; i++)
+        {
+            body(i);
+        }
+        return;
+    }
+
+    // Every helper task, and the caller, takes the next iteration until
+    // none are left; helpers that start late find nothing to do.
+    std::atomic<int> next(0);
+    std::function<void()> loop = [&next, size, &body]()
+    {
+        int i;
+        while ((i = next++) < size)
+        {
+            body(i);
+        }
+    };
+    TaskGroup helpers;
+    int numHelpers = std::min(size, numThreads()) - 1;
+    for (int i = 0; i < numHelpers; i++)
+    {
+        spawn(helpers, loop);
+    }
+
+    std::exception_ptr error;
+    try
+    {
+        loop();
+    }
+    catch (...)
+    {
+        error = std::current_exception();
+        next = size;
+    }
+    try
+    {
+        wait(helpers);
+    }
+    catch (...)
+    {
+        if (!error)
+        {
+            error = std::current_exception();
+        }
+    }
+    if (error)
+    {
+        std::rethrow_exception(error);
+    }
+}
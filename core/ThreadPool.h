@@ -0,0 +1,188 @@
+#ifndef _THREADPOOL_
+#define _THREADPOOL_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Class for running tasks on a fixed set of worker threads with work
+ * stealing. Every worker owns a deque of tasks: it pushes the tasks it
+ * spawns at the back and takes its own work from the back as well, while
+ * idle threads steal from the front of the other deques, i.e. the oldest
+ * and usually largest tasks. Threads outside the pool share one more deque.
+ *
+ * A thread waiting for a group of tasks runs other tasks in the meantime,
+ * so tasks may spawn and wait for tasks of their own (e.g. recursively
+ * building subtrees) without dead-locking the pool.
+ *
+ * Tasks may finish in any order. Callers that need a deterministic result
+ * have to store the result of each task and combine them in a fixed order.
+ */
+class ThreadPool
+{
+
+public:
+
+    /**
+     * Class for a group of tasks that can be waited for together.
+     */
+    class TaskGroup
+    {
+
+    public:
+
+        /**
+         * Creates an empty group.
+         */
+        TaskGroup();
+
+    private:
+
+        friend class ThreadPool;
+
+        /** The number of tasks of the group that have not finished yet. */
+        std::atomic<int> mPending;
+
+        /** The first exception thrown by a task of the group, if any. */
+        std::exception_ptr mError;
+    };
+
+protected:
+
+    /** A task waiting to be run. */
+    struct Task
+    {
+        /** The function to run. */
+        std::function<void()> function;
+
+        /** The group the task belongs to. */
+        TaskGroup *group;
+    };
+
+    /** A deque of tasks with its lock. */
+    struct Queue
+    {
+        /** Guards tasks. */
+        std::mutex mutex;
+
+        /** The tasks, the most recently spawned at the back. */
+        std::deque<Task*> tasks;
+    };
+
+    /** The worker threads. */
+    std::vector<std::thread> mWorkers;
+
+    /** One deque per worker, followed by the deque of all other threads. */
+    std::vector<std::unique_ptr<Queue>> mQueues;
+
+    /** The number of tasks in all deques. */
+    std::atomic<int> mQueued;
+
+    /** Guards mStop and the errors of the groups; used to sleep and wake. */
+    std::mutex mMutex;
+
+    /** Signalled when a task is spawned, a group finishes or the pool stops. */
+    std::condition_variable mWake;
+
+    /** Whether the workers are to exit. */
+    bool mStop;
+
+    /**
+     * Returns the deque of the calling thread.
+     *
+     * @return the index of the deque
+     */
+    int queueIndex() const;
+
+    /**
+     * Takes a task, first from the back of the given deque, then from the
+     * front of the others.
+     *
+     * @param index the deque of the calling thread
+     * @return the task, null if there is none
+     */
+    Task *findTask(const int index);
+
+    /**
+     * Runs a task and signs it off with its group.
+     *
+     * @param task the task to run
+     */
+    void run(Task *task);
+
+    /**
+     * The main loop of a worker thread.
+     *
+     * @param index the deque of the worker
+     */
+    void workerLoop(const int index);
+
+public:
+
+    /**
+     * Creates a pool running tasks on the given number of threads, the
+     * thread waiting for them included.
+     *
+     * @param numThreads the number of threads, values below 1 select the
+     *          number of hardware threads
+     */
+    ThreadPool(int numThreads);
+
+    /**
+     * Stops and joins the worker threads.
+     */
+    ~ThreadPool();
+
+    /**
+     * Returns the number of threads tasks are run on, the thread waiting
+     * for them included.
+     *
+     * @return the number of threads
+     */
+    int numThreads() const;
+
+    /**
+     * Adds a task to the given group and queues it on the calling thread.
+     *
+     * @param group the group of the task
+     * @param task the function to run
+     */
+    void spawn(TaskGroup &group, const std::function<void()> &task);
+
+    /**
+     * Returns once all tasks of the given group have finished, running
+     * queued tasks in the meantime. If a task of the group has thrown, the
+     * first exception is rethrown here.
+     *
+     * @param group the group to wait for
+     */
+    void wait(TaskGroup &group);
+
+    /**
+     * Runs body(0) ... body(size - 1) on the threads of the pool and returns
+     * once all iterations have finished. The iterations are handed out in
+     * ascending order; the calling thread takes part, so if the other threads
+     * are busy the loop simply runs on the caller. If an iteration throws,
+     * the first exception is rethrown here after the loop has finished.
+     *
+     * @param size the number of iterations
+     * @param body the body of the loop
+     */
+    void parallelFor(const int size, const std::function<void(int)> &body);
+
+    /**
+     * Returns the number of threads the hardware can run concurrently.
+     *
+     * @return the number of hardware threads, at least 1
+     */
+    static int hardwareThreads();
+};
+
+#endif    // _THREADPOOL_
@@ -1,6 +1,7 @@
 #ifndef __C48_TYPEDEFS_HPP__
 #define __C48_TYPEDEFS_HPP__
 
+#include <string>
 #include <vector>
 #include <unordered_map>
 
@@ -10,17 +10,21 @@
 #include "Estimator.h"
 #include "KernelEstimator.h"
 #include "ThresholdCurve.h"
+#include "FoldLearner.h"
+#include "core/InstancesView.h"
+#include "core/ThreadPool.h"
 #include <exception>
+#include <algorithm>
 
 const double Evaluation::MIN_SF_PROB = std::numeric_limits<double>::min();
 int Evaluation::kMarginResolution = 500;
 
-Evaluation::Evaluation(Instances data) :Evaluation(data, nullptr)
+Evaluation::Evaluation(Instances &data) :Evaluation(data, nullptr)
 {
 
 }
 
-Evaluation::Evaluation(Instances data, CostMatrix costMatrix)
+Evaluation::Evaluation(Instances &data, CostMatrix costMatrix)
 {
     mNumClasses = data.numClasses();
     mNumFolds = 1;
@@ -33,7 +37,7 @@ Evaluation::Evaluation(Instances data, CostMatrix costMatrix)
             mClassNames[i] = data.classAttribute().value(i);
         }
     }
-    mCostMatrix = &costMatrix;
+    mCostMatrix = new CostMatrix(costMatrix);
     if (mCostMatrix->size() != 0) {
         if (!mClassIsNominal) {
             throw "Class has to be nominal if cost matrix given!";
@@ -50,7 +54,10 @@ Evaluation::Evaluation(Instances data, CostMatrix costMatrix)
 
 Evaluation::~Evaluation()
 {
-    //dtor
+    delete mCostMatrix;
+    for (Prediction *prediction : mPredictions) {
+        delete prediction;
+    }
 }
 
 void Evaluation::setPriors(Instances &train)
@@ -87,6 +94,178 @@ void Evaluation::setPriors(Instances &train)
     }
 }
 
+void Evaluation::setPriors(const InstancesView &train)
+{
+    mNoPriors = false;
+
+    if (!mClassIsNominal) {
+
+        mNumTrainClassVals = 0;
+        mTrainClassVals.clear();
+        mTrainClassWeights.clear();
+        mPriorErrorEstimator = nullptr;
+        mErrorEstimator = nullptr;
+
+        for (int i = 0; i < train.numInstances(); i++) {
+            addNumericTrainClass(train.classValue(i), train.weight(i));
+        }
+    }
+    else {
+        for (int i = 0; i < mNumClasses; i++) {
+            mClassPriors[i] = 1;
+        }
+        mClassPriorsSum = mNumClasses;
+        for (int i = 0; i < train.numInstances(); i++) {
+            mClassPriors[(int)train.classValue(i)] += train.weight(i);
+            mClassPriorsSum += train.weight(i);
+        }
+    }
+}
+
+void Evaluation::crossValidateModel(FoldLearner &learner, Instances &data, const int numFolds, const int numThreads)
+{
+    if (!mClassIsNominal) {
+        throw "Cross-validation needs a nominal class!";
+    }
+
+    // The folds are rows of one stratified order of the instances, which
+    // are shared rather than copied.
+    std::vector<Instance*> instances;
+    instances.reserve(data.numInstances());
+    for (int i = 0; i < data.numInstances(); i++) {
+        instances.push_back(&data.instance(i));
+    }
+    Instances stratified(&data, instances);
+    stratified.stratify(numFolds);
+    int totalInst = stratified.numInstances();
+    if (numFolds > totalInst) {
+        throw "Can't have more folds than instances!";
+    }
+
+    // The folds are built on the rows with a class value.
+    InstancesView known(stratified, totalInst);
+    known.addKnown(stratified.classIndex());
+    learner.prepareFolds(known);
+
+    std::vector<Evaluation*> folds(numFolds, nullptr);
+    auto evaluateFold = [&](int fold) {
+
+        // The test rows of the fold are the ones Instances::testCV() takes.
+        int numInstForFold = totalInst / numFolds;
+        int offset = totalInst % numFolds;
+        if (fold < offset) {
+            numInstForFold++;
+            offset = fold;
+        }
+        int first = fold * (totalInst / numFolds) + offset;
+        int last = first + numInstForFold;
+
+        int_array rows(known.numInstances(), -1);
+        InstancesView train(stratified, known.numInstances());
+        for (int i = 0; i < known.numInstances(); i++) {
+            int index = known.index(i);
+            if (index < first || index >= last) {
+                rows[i] = train.numInstances();
+                train.add(index, known.weight(i));
+            }
+        }
+
+        Classifier *foldClassifier = learner.buildFold(train, rows);
+        Evaluation *evaluation = nullptr;
+        try {
+            evaluation = new Evaluation(stratified, *mCostMatrix);
+            evaluation->setPriors(train);
+            for (int i = first; i < last; i++) {
+                Instance &instance = stratified.instance(i);
+                evaluation->evaluateModelOnceAndRecordPrediction(foldClassifier->distributionForInstance(instance), instance);
+            }
+        }
+        catch (...) {
+            delete foldClassifier;
+            delete evaluation;
+            throw;
+        }
+        delete foldClassifier;
+        folds[fold] = evaluation;
+    };
+
+    int threads = (numThreads < 1) ? ThreadPool::hardwareThreads() : numThreads;
+    try {
+        if (threads > 1 && numFolds > 1) {
+            ThreadPool pool(std::min(threads, numFolds));
+            pool.parallelFor(numFolds, evaluateFold);
+        }
+        else {
+            for (int fold = 0; fold < numFolds; fold++) {
+                evaluateFold(fold);
+            }
+        }
+    }
+    catch (...) {
+        for (Evaluation *evaluation : folds) {
+            delete evaluation;
+        }
+        learner.finishFolds();
+        throw;
+    }
+    learner.finishFolds();
+
+    // Aggregate in the order of the folds; the priors end up as those of the
+    // last training set, as after setting them for each fold in turn.
+    for (Evaluation *evaluation : folds) {
+        aggregate(*evaluation);
+    }
+    mClassPriors = folds.back()->mClassPriors;
+    mClassPriorsSum = folds.back()->mClassPriorsSum;
+    mNoPriors = false;
+    mNumFolds = numFolds;
+    for (Evaluation *evaluation : folds) {
+        delete evaluation;
+    }
+}
+
+void Evaluation::aggregate(Evaluation &evaluation)
+{
+    mIncorrect += evaluation.mIncorrect;
+    mCorrect += evaluation.mCorrect;
+    mUnclassified += evaluation.mUnclassified;
+    mMissingClass += evaluation.mMissingClass;
+    mWithClass += evaluation.mWithClass;
+
+    if (mClassIsNominal) {
+        for (int i = 0; i < mNumClasses; i++) {
+            for (int j = 0; j < mNumClasses; j++) {
+                mConfusionMatrix[i][j] += evaluation.mConfusionMatrix[i][j];
+            }
+        }
+    }
+
+    mTotalCost += evaluation.mTotalCost;
+    mSumErr += evaluation.mSumErr;
+    mSumAbsErr += evaluation.mSumAbsErr;
+    mSumSqrErr += evaluation.mSumSqrErr;
+    mSumClass += evaluation.mSumClass;
+    mSumSqrClass += evaluation.mSumSqrClass;
+    mSumPredicted += evaluation.mSumPredicted;
+    mSumSqrPredicted += evaluation.mSumSqrPredicted;
+    mSumClassPredicted += evaluation.mSumClassPredicted;
+    mSumPriorAbsErr += evaluation.mSumPriorAbsErr;
+    mSumPriorSqrErr += evaluation.mSumPriorSqrErr;
+    mSumKBInfo += evaluation.mSumKBInfo;
+    for (size_t i = 0; i < mMarginCounts.size(); i++) {
+        mMarginCounts[i] += evaluation.mMarginCounts[i];
+    }
+    mComplexityStatisticsAvailable = mComplexityStatisticsAvailable && evaluation.mComplexityStatisticsAvailable;
+    mCoverageStatisticsAvailable = mCoverageStatisticsAvailable && evaluation.mCoverageStatisticsAvailable;
+    mSumPriorEntropy += evaluation.mSumPriorEntropy;
+    mSumSchemeEntropy += evaluation.mSumSchemeEntropy;
+    mTotalSizeOfRegions += evaluation.mTotalSizeOfRegions;
+    mTotalCoverage += evaluation.mTotalCoverage;
+
+    mPredictions.insert(mPredictions.end(), evaluation.mPredictions.begin(), evaluation.mPredictions.end());
+    evaluation.mPredictions.clear();
+}
+
 double Evaluation::evaluateModelOnceAndRecordPrediction(const double_array dist, Instance &instance)
 {
     double pred = 0;
@@ -12,7 +12,8 @@ class Prediction;
 class Instances;
 class Instance;
 class Classifier;
-class CostMatrix;
+class FoldLearner;
+class InstancesView;
 
 /**
  * Class for evaluating machine learning models.
@@ -28,7 +29,7 @@ public:
      *          prior class distribution information
      * @throws Exception if the class is not defined
      */
-    Evaluation(Instances data);
+    Evaluation(Instances &data);
 
     /**
      * Initializes all the counters for the evaluation and also takes a cost
@@ -40,7 +41,7 @@ public:
      * @throws Exception if cost matrix is not compatible with data, the class is
      *           not defined or the class is numeric
      */
-    Evaluation(Instances data, CostMatrix costMatrix);
+    Evaluation(Instances &data, CostMatrix costMatrix);
 
     /**
      * Destructor.
@@ -54,6 +55,40 @@ public:
      */
     void setPriors(Instances &train);
 
+    /**
+     * Sets the class priors from rows of a training set, all of which have a
+     * class value.
+     *
+     * @param train the training rows
+     */
+    void setPriors(const InstancesView &train);
+
+    /**
+     * Performs a stratified cross-validation on a dataset. The folds are
+     * rows of one stratified order of the instances rather than copies, which
+     * the learner prepares for once before building a classifier per fold.
+     * The folds are built and evaluated concurrently, each into an
+     * evaluation of its own, which are then aggregated in the order of the
+     * folds, so the results do not depend on the number of threads.
+     *
+     * @param learner the learner that builds the classifier of each fold
+     * @param data the data to cross-validate on
+     * @param numFolds the number of folds
+     * @param numThreads the number of folds evaluated at once, 0 for the
+     *          number of hardware threads
+     * @throws Exception if the class is not nominal or there are fewer
+     *           instances than folds
+     */
+    void crossValidateModel(FoldLearner &learner, Instances &data, const int numFolds, const int numThreads);
+
+    /**
+     * Adds the statistics of another evaluation of the same kind of data to
+     * those of this one, taking over its predictions.
+     *
+     * @param evaluation the evaluation to add, left without predictions
+     */
+    void aggregate(Evaluation &evaluation);
+
     /**
      * Evaluates the classifier on a single instance and records the prediction
      * (if the class is nominal).
@@ -498,7 +533,7 @@ protected:
     /** The sum of counts for priors.  */
     double mClassPriorsSum = 0;
 
-    /** The cost matrix (if given).  */
+    /** The cost matrix (if given), owned by the evaluation.  */
     CostMatrix *mCostMatrix;
 
     /** The total cost of predictions (includes instance weights).  */
@@ -681,6 +716,11 @@ protected:
      */
     string num2ShortID(int num, const char_array &IDChars, const int IDWidth) const;
 
+private:
+
+    Evaluation(const Evaluation&);
+    Evaluation &operator=(const Evaluation&);
+
 };
 
 #endif // EVALUATION_H_
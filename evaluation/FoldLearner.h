@@ -0,0 +1,48 @@
+#ifndef _FOLDLEARNER_
+#define _FOLDLEARNER_
+
+#include "core/Typedefs.h"
+
+// Forward class declarations:
+class Classifier;
+class InstancesView;
+
+/**
+ * Interface to a learner that builds classifiers on the training rows of
+ * the folds of a cross-validation, possibly sharing work between the folds.
+ */
+class FoldLearner {
+
+public:
+    /**
+     * Destructor
+     */
+    virtual ~FoldLearner() {}
+
+    /**
+     * Prepares for building the folds of a cross-validation, e.g. by
+     * computing what all folds share.
+     *
+     * @param data the rows of all folds, all of which have a class value
+     */
+    virtual void prepareFolds(const InstancesView &data) = 0;
+
+    /**
+     * Builds a classifier on the training rows of a fold. It is called
+     * concurrently for different folds.
+     *
+     * @param train the training rows of the fold, of the same dataset as the
+     *          rows given to prepareFolds()
+     * @param rows the row each row given to prepareFolds() has in train, -1
+     *          for the rows left out
+     * @return the built classifier, owned by the caller
+     */
+    virtual Classifier *buildFold(const InstancesView &train, const int_array &rows) const = 0;
+
+    /**
+     * Releases what prepareFolds() kept, once all folds have been built.
+     */
+    virtual void finishFolds() = 0;
+};
+
+#endif    // _FOLDLEARNER_
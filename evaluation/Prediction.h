@@ -21,6 +21,11 @@ public:
     static constexpr double MISSING_VALUE = std::numeric_limits<double>::quiet_NaN();
 #endif
 
+    /**
+     * Destructor.
+     */
+    virtual ~Prediction() {}
+
     /**
     * Gets the weight assigned to this prediction. This is typically the weight
     * of the test instance the prediction was made for.
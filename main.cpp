@@ -2,6 +2,7 @@
 #include "core/Instances.h"
 #include "core/Instance.h"
 #include "core/Utils.h"
+#include "core/ColumnStore.h"
 #include "c48/C48.h"
 #include "evaluation/Evaluation.h"
 #include "evaluation/CostMatrix.h"
@@ -9,12 +10,17 @@
 #include <ctime>
 #include <string.h>
 
-void classify(C48 &, char *, char *, bool isDumpTree = false);
+void classify(C48 &, char *, char *, bool isDumpTree = false, bool isOutOfCore = false, bool isSinglePrecision = false, C48 *reference = nullptr, int numFolds = 0);
+void evaluate(C48 &, Evaluation &, Instances &);
 
 int main( int argc, char *argv[]  )
 {
     char *trainFile = nullptr, *testFile = nullptr;
     bool isDumpTree = false;
+    bool isOutOfCore = false;
+    bool isSinglePrecision = false;
+    bool isComparedToExact = false;
+    int numFolds = 0;
     bool minArg = false;
     C48 *classifier = new C48();
     for (int i = 1; i < argc; i++) {
@@ -32,37 +38,70 @@ int main( int argc, char *argv[]  )
           else
             minArg = false;
         }
+        else if (strcmp(argv[i], "-x") == 0) {
+          if (i+1 < argc && argv[i+1][0] != '-')
+            numFolds = atoi(argv[++i]);
+          else
+            minArg = false;
+        }
         else if (strcmp(argv[i], "-D") == 0) {
             isDumpTree = true;
         }
+        else if (strcmp(argv[i], "-O") == 0) {
+            isOutOfCore = true;
+        }
+        else if (strcmp(argv[i], "-float") == 0) {
+            isSinglePrecision = true;
+        }
+        else if (strcmp(argv[i], "-compare") == 0) {
+            isComparedToExact = true;
+        }
     }
     // Assign Command line 
-    if (!classifier->setParameters(argc, argv) || !minArg)
+    if (!classifier->setParameters(argc, argv) || !minArg || numFolds == 1 || numFolds < 0
+        || (isOutOfCore && (numFolds > 0 || classifier->getReducedErrorPruning())))
     {
         std::cout << "C++ 4.8 Decision Tree Tool" << std::endl;
         std::cout << argv[0] << " <source> <flag> <options> " << std::endl;
         std::cout << "  SOURCE:" << std::endl;
-        std::cout << "\t-train <training data> - fileStem.names|fileStem.data" << std::endl;
-        std::cout << "\t-test <testing data> - fileStem.test (optional)" << std::endl;
+        std::cout << "\t-train <training data> - fileStem.names|fileStem.data|file.arff" << std::endl;
+        std::cout << "\t-test <testing data> - fileStem.test|file.arff (optional)" << std::endl;
+        std::cout << "\t-x <number of folds> - Cross-validate on the training data instead, if no testing data is given" << std::endl;
         std::cout << "  FLAG:" << std::endl;
 		std::cout << "\t-D - To dump tree structure for classification" << std::endl << std::endl;;
+        std::cout << "\t-O - Keep the training data on disk, mapped from its cache file, and grow the tree level by level with binned splits and without subtree raising (not with -x or -R)" << std::endl;
+        std::cout << "\t-float - Hold numeric values as floats instead of doubles" << std::endl;
         std::cout << "\t-U - To use unpruned tree" << std::endl;
         std::cout << "\t-R - To use reduced error pruning" << std::endl;
         std::cout << "\t-S - Don't perform subtree raising" << std::endl;
         std::cout << "\t-L - Do not clean up after the tree has been built" << std::endl;
         std::cout << "\t-A - Laplace smoothing for predicted probabilities" << std::endl;
+        std::cout << "\t-counts - Keep class counts per nominal value at every node, subtracting the smaller sons' from the parent's for the largest son" << std::endl;
         std::cout << "  OPTIONS:" << std::endl;
         std::cout << "\t-C <pruning confidence> - Set confidence threshold for pruning (default .25)" << std::endl;
         std::cout << "\t-M <minimum number of instances> - Set minimum number of instances per leaf (default 2)" << std::endl;
-        std::cout << "\t-N <number of folds> - Set number of folds for reduced error pruning. One fold is used as pruning set (default 3)" << std::endl;
+        std::cout << "\t-N <number of folds> - Set number of folds for reduced error pruning, at least 2. One fold is used as pruning set (default 3)" << std::endl;
+        std::cout << "\t-threads <number of threads> - Set number of threads to build the tree with, or to cross-validate the folds with, 0 for all cores (default 1)" << std::endl;
+        std::cout << "\t-B <number of bins> - Seek numeric split points between quantile bins only (default 0, exact splits)" << std::endl;
+        std::cout << "\t-compare - With -B, also build the tree with exact splits and report the accuracy of the binned one against it (not with -O)" << std::endl;
         std::cout << std::endl;
         exit(0);
     }
-    classify(*classifier, trainFile, testFile, isDumpTree);
+    // On request, approximate splits are compared with the exact tree of
+    // the same options, which needs the training data in memory.
+    C48 *reference = nullptr;
+    if (isComparedToExact && classifier->getNumBins() > 0 && !isOutOfCore)
+    {
+        reference = new C48();
+        reference->setParameters(argc, argv);
+        reference->setNumBins(0);
+        reference->setPresort(classifier->getPresort());
+    }
+    classify(*classifier, trainFile, testFile, isDumpTree, isOutOfCore, isSinglePrecision, reference, numFolds);
     return 0;
 }
 
-void classify(C48 &classifier, char *trainFile, char *testFile, bool isDumpTree)
+void classify(C48 &classifier, char *trainFile, char *testFile, bool isDumpTree, bool isOutOfCore, bool isSinglePrecision, C48 *reference, int numFolds)
 {
 	try
 	{
@@ -72,13 +111,25 @@ void classify(C48 &classifier, char *trainFile, char *testFile, bool isDumpTree)
 
 		// Set data source
 		DataSource trainSource(trainFilePpath);
+		trainSource.setSinglePrecision(isSinglePrecision);
 		Instances *instTrain = nullptr;
+		std::shared_ptr<ColumnStore> columns;
 		time(&startTime);
-		instTrain = trainSource.getDataSet(); // Read data from *.data file
+		if (isOutOfCore)
+		{
+			// Only the mapped columns are read; the rows get instances
+			// once the tree is built, for the evaluation.
+			columns = trainSource.getColumns();
+			instTrain = new Instances(trainSource.getStructure(), 0);
+		}
+		else
+		{
+			instTrain = trainSource.getDataSet(); // Read data from *.data file
+		}
 		time(&TimeElapsed);
 
 		int num = instTrain->numAttributes(); // Get total number of attributes
-		int totalInst = instTrain->numInstances();
+		int totalInst = isOutOfCore ? columns->numRows() : instTrain->numInstances();
 		std::cout << "Schema:       " << "C++ 4.8 Decision Tree Implementation" << std::endl;
 		std::cout << "Relation:     " << instTrain->getRelationName() << std::endl;
 		std::cout << "Instances:    " << totalInst << std::endl;
@@ -90,11 +141,30 @@ void classify(C48 &classifier, char *trainFile, char *testFile, bool isDumpTree)
 			<< difftime(TimeElapsed, startTime)
 			<< " seconds"
 			<< std::endl << std::endl;
-		std::cout << "Test mode : evaluate on training data" << std::endl;
+		bool crossValidate = (numFolds > 1 && testFile == nullptr);
+		if (crossValidate && numFolds > totalInst)
+		{
+			throw "Can't have more folds than instances!";
+		}
+		if (crossValidate)
+			std::cout << "Test mode : " << numFolds << "-fold cross-validation" << std::endl;
+		else
+			std::cout << "Test mode : evaluate on training data" << std::endl;
 		//C48 *classifier = new C48();
 		time(&startTime);
-		classifier.buildClassifier(*instTrain);
+		if (isOutOfCore)
+		{
+			classifier.buildClassifier(*columns, *instTrain);
+		}
+		else
+		{
+			classifier.buildClassifier(*instTrain);
+		}
 		time(&TimeElapsed);
+		if (isOutOfCore)
+		{
+			instTrain->addRows(columns);
+		}
 		std::cout << "=== Classifier model (full training set) ===" << std::endl << std::endl;
 		std::cout << classifier.toString(isDumpTree) << std::endl;
 		std::cout << "\nTime taken to build model : "
@@ -104,35 +174,61 @@ void classify(C48 &classifier, char *trainFile, char *testFile, bool isDumpTree)
 		CostMatrix *costMatrix = nullptr;
 		eval = new Evaluation(*instTrain, costMatrix);
 
+		Instances *instTest = nullptr;
 		if (testFile != nullptr)
 		{
 			string testFilePath(testFile);
 			DataSource testSource(testFilePath);
-			Instances *instTest = nullptr;
+			testSource.setSinglePrecision(isSinglePrecision);
 			instTest = testSource.getDataSet(); // Read data from *.test file
 
-			totalInst = instTest->numInstances();
-			for (int i = 0; i < totalInst; i++)
-			{
-				Instance &instance = instTest->instance(i);
-				eval->evaluateModelOnceAndRecordPrediction(classifier, instance);
-			}
+			evaluate(classifier, *eval, *instTest);
+		}
+		else if (crossValidate)
+		{
+			time(&startTime);
+			eval->crossValidateModel(classifier, *instTrain, numFolds, classifier.getNumThreads());
+			time(&TimeElapsed);
+			std::cout << "Time taken to cross-validate model : "
+				<< difftime(TimeElapsed, startTime)
+				<< " seconds\n\n";
 		}
 		else
 		{
-			totalInst = instTrain->numInstances();
-			for (int i = 0; i < totalInst; i++)
-			{
-				Instance &instance = instTrain->instance(i);
-				eval->evaluateModelOnceAndRecordPrediction(classifier, instance);
-			}
+			evaluate(classifier, *eval, *instTrain);
 		}
 
 
-		std::cout << " === Evaluation on training set ===" << std::endl;
+		if (crossValidate)
+			std::cout << " === Stratified cross-validation ===" << std::endl;
+		else
+			std::cout << " === Evaluation on training set ===" << std::endl;
 		std::cout << eval->toSummaryString(true);
 		std::cout << eval->toClassDetailsString() << std::endl;
 		std::cout << eval->toMatrixString() << std::endl;
+		if (reference != nullptr)
+		{
+			time(&startTime);
+			reference->buildClassifier(*instTrain);
+			time(&TimeElapsed);
+			// The exact tree is scored the way the binned one was, on the
+			// same folds when cross-validating; the sizes are of the trees
+			// built on all the training data.
+			Evaluation *referenceEval = new Evaluation(*instTrain, costMatrix);
+			if (instTest != nullptr)
+				evaluate(*reference, *referenceEval, *instTest);
+			else if (crossValidate)
+				referenceEval->crossValidateModel(*reference, *instTrain, numFolds, reference->getNumThreads());
+			else
+				evaluate(*reference, *referenceEval, *instTrain);
+
+			std::cout << "=== Binned splits (" << classifier.getNumBins() << " bins) against exact splits ===" << std::endl << std::endl;
+			std::cout << "Correctly Classified Instances, binned    " << Utils::doubleToString(eval->pctCorrect(), 12, 4) << " %" << std::endl;
+			std::cout << "Correctly Classified Instances, exact     " << Utils::doubleToString(referenceEval->pctCorrect(), 12, 4) << " %" << std::endl;
+			std::cout << "Accuracy delta                            " << Utils::doubleToString(eval->pctCorrect() - referenceEval->pctCorrect(), 12, 4) << " %" << std::endl;
+			std::cout << "Size of the tree, binned / exact          " << classifier.measureTreeSize() << " / " << reference->measureTreeSize() << std::endl;
+			std::cout << "Time taken to build exact model : " << difftime(TimeElapsed, startTime) << " seconds" << std::endl << std::endl;
+		}
 		std::cout << sizeof(classifier) << std::endl;
 		std::ofstream ss("./sample_serialization.model", std::ios::binary);
 		ss << classifier;
@@ -141,8 +237,37 @@ void classify(C48 &classifier, char *trainFile, char *testFile, bool isDumpTree)
 	{
 		;
 	}
-	catch (std::exception ex)
+	catch (const char *ex)
+	{
+		std::cout << ex << std::endl;
+	}
+	catch (const string &ex)
+	{
+		std::cout << ex << std::endl;
+	}
+	catch (const std::exception &ex)
 	{
 		std::cout << ex.what() << std::endl;
 	}
 }
+
+void evaluate(C48 &classifier, Evaluation &eval, Instances &data)
+{
+	int totalInst = data.numInstances();
+	if (classifier.implementsMoreEfficientBatchPrediction() && data.classAttribute().isNominal())
+	{
+		double_2D_array dists = classifier.distributionsForInstances(data);
+		for (int i = 0; i < totalInst; i++)
+		{
+			eval.evaluateModelOnceAndRecordPrediction(dists[i], data.instance(i));
+		}
+	}
+	else
+	{
+		for (int i = 0; i < totalInst; i++)
+		{
+			Instance &instance = data.instance(i);
+			eval.evaluateModelOnceAndRecordPrediction(classifier, instance);
+		}
+	}
+}